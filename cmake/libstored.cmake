@@ -214,9 +214,11 @@ Relationship: SPDXRef-compiler BUILD_DEPENDENCY_OF SPDXRef-libstored
 		${LIBSTORED_SOURCE_DIR}/include/libstored/util.h
 		${LIBSTORED_SOURCE_DIR}/include/libstored/version.h
 		${LIBSTORED_SOURCE_DIR}/include/libstored/zmq.h
+		${LIBSTORED_SOURCE_DIR}/src/allocator.cpp
 		${LIBSTORED_SOURCE_DIR}/src/compress.cpp
 		${LIBSTORED_SOURCE_DIR}/src/directory.cpp
 		${LIBSTORED_SOURCE_DIR}/src/debugger.cpp
+		${LIBSTORED_SOURCE_DIR}/src/fifo.cpp
 		${LIBSTORED_SOURCE_DIR}/src/pipes.cpp
 		${LIBSTORED_SOURCE_DIR}/src/poller.cpp
 		${LIBSTORED_SOURCE_DIR}/src/protocol.cpp
@@ -102,6 +102,8 @@ int main(int argc, char** argv)
 				ret = 1;
 				break;
 			}
+			// Send all messages of one loop iteration at once.
+			z->setBatching(true);
 			stored::ProtocolLayer* l = z;
 			if(verbose) {
 				l = new stored::BufferLayer();
@@ -124,6 +126,8 @@ int main(int argc, char** argv)
 				ret = 1;
 				break;
 			}
+			// Send all messages of one loop iteration at once.
+			z->setBatching(true);
 			stored::ProtocolLayer* l = z;
 			if(verbose) {
 				l = new stored::BufferLayer();
@@ -183,6 +187,10 @@ int main(int argc, char** argv)
 		// Go sync store1 on all connections.
 		synchronizer.process(store1);
 
+		for(std::list<stored::SyncZmqLayer*>::iterator it = connections.begin();
+		    it != connections.end(); ++it)
+			(*it)->flush();
+
 		// Wait for input...
 		int cnt = zmq_poll(&fds.front(), (int)fds.size(), -1);
 		switch(cnt) {
@@ -8,7 +8,9 @@
 
 #ifdef __cplusplus
 #  include <algorithm>
+#  include <cstdio>
 #  include <deque>
+#  include <limits>
 #  include <list>
 #  include <map>
 #  include <memory>
@@ -18,6 +20,7 @@
 
 #  if STORED_cplusplus >= 201103L
 #    include <array>
+#    include <atomic>
 #    include <functional>
 #    include <unordered_map>
 #    include <utility>
@@ -587,6 +590,411 @@ private:
 
 #  endif // STORED_cplusplus >= 201103L
 
+/*!
+ * \brief Memory pool with size-class free lists.
+ *
+ * This is the backend of stored::PoolAllocator. Objects are rounded up to
+ * a power of two, starting at #Alignment, up to #MaxClassSize. Every size
+ * class has a free list. Deallocated objects are pushed onto the free
+ * list, and are never returned to the heap. When a free list is empty, the
+ * object is carved from a slab, which is either the buffer passed to
+ * #setBuffer(), or a block of #SlabSize bytes from the heap. Objects
+ * larger than #MaxClassSize are allocated on the heap directly.
+ *
+ * So, once the application has reached its steady state, allocation and
+ * deallocation are O(1) and do not touch the heap. To enforce that, call
+ * #setInitComplete() after initialization; any allocation that needs more
+ * memory than the pool has triggers an assert afterwards. In strict mode,
+ * any allocation triggers an assert.
+ *
+ * There are two instances: one that is thread-safe, and one that is not.
+ * Get them using #instance().
+ */
+class MemoryPool {
+	STORED_CLASS_NOCOPY(MemoryPool)
+public:
+	enum {
+		/*! \brief Alignment and the smallest size class. */
+		Alignment = 16,
+		/*! \brief Number of size classes. */
+		Classes = 7,
+		/*! \brief Largest size class. */
+		MaxClassSize = Alignment << (Classes - 1),
+		/*! \brief Size of the slabs that are allocated from the heap. */
+		SlabSize = 4096
+	};
+
+	/*! \brief Allocation statistics. */
+	struct Stats {
+		/*! \brief Number of #allocate() calls. */
+		size_t allocations;
+		/*! \brief Number of #deallocate() calls. */
+		size_t deallocations;
+		/*! \brief Number of allocations from the heap, for slabs and large objects. */
+		size_t heap;
+	};
+
+	static MemoryPool& instance(bool threadSafe = false);
+
+	void* allocate(size_t size);
+	void deallocate(void* p, size_t size) noexcept;
+	void reserve(size_t size, size_t count = 1);
+	void setBuffer(void* buffer, size_t len);
+	void setInitComplete(bool complete = true, bool strict = false);
+	bool initComplete() const;
+	Stats stats() const;
+
+private:
+	explicit MemoryPool(bool threadSafe);
+	~MemoryPool() is_default
+
+	static size_t sizeClass(size_t size) noexcept;
+	void* carve(size_t size);
+	void release(size_t c, void* p) noexcept;
+	void releaseSlab() noexcept;
+	void lock() const noexcept;
+	void unlock() const noexcept;
+
+private:
+	/*! \brief Whether #lock() is required. */
+	bool const m_threadSafe;
+	/*! \brief When set, the heap must not be used anymore. */
+	bool m_initComplete;
+	/*! \brief When set, #allocate() must not be called anymore. */
+	bool m_strict;
+	/*! \brief Free lists per size class. */
+	void* m_free[Classes]; // NOLINT(hicpp-avoid-c-arrays)
+	/*! \brief Unused part of the current slab. */
+	char* m_slab;
+	/*! \brief Size of #m_slab. */
+	size_t m_slabLeft;
+	/*! \brief Statistics. */
+	Stats m_stats;
+#  if STORED_cplusplus >= 201103L
+	/*! \brief Spinlock, when #m_threadSafe is set. */
+	mutable std::atomic<bool> m_lock;
+#  endif
+};
+
+#  if STORED_cplusplus >= 201103L
+/*!
+ * \brief Allocator for stored::Config::Allocator, which uses a stored::MemoryPool.
+ *
+ * Use it in your \c stored_config.h like this:
+ *
+ * \code
+ * struct Config : public DefaultConfig {
+ *	template <typename T>
+ *	struct Allocator {
+ *		typedef PoolAllocator<T> type;
+ *	};
+ * };
+ * \endcode
+ *
+ * All instances of the same \p ThreadSafe share the same pool. Types that
+ * require a stricter alignment than stored::MemoryPool::Alignment are
+ * allocated by \c std::allocator instead.
+ *
+ * \tparam T the type to allocate
+ * \tparam ThreadSafe when \c true, use the thread-safe pool
+ */
+template <typename T, bool ThreadSafe>
+class PoolAllocator {
+public:
+	using value_type = T;
+
+	PoolAllocator() noexcept = default;
+
+	template <typename U>
+	// cppcheck-suppress noExplicitConstructor
+	PoolAllocator(PoolAllocator<U, ThreadSafe> const&) noexcept // NOLINT
+	{}
+
+	/*!
+	 * \brief Returns the pool that is used by this allocator.
+	 */
+	static MemoryPool& pool()
+	{
+		return MemoryPool::instance(ThreadSafe);
+	}
+
+	/*!
+	 * \brief Allocate \p n objects.
+	 */
+	__attribute__((warn_unused_result)) T* allocate(size_t n)
+	{
+		if(alignof(T) > MemoryPool::Alignment)
+			return std::allocator<T>().allocate(n);
+
+		if(n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+#    ifdef STORED_cpp_exceptions
+			throw std::bad_alloc();
+#    else
+			std::terminate();
+#    endif
+		}
+
+		return static_cast<T*>(pool().allocate(sizeof(T) * n));
+	}
+
+	/*!
+	 * \brief Deallocate \p n objects, previously returned by #allocate().
+	 */
+	void deallocate(T* p, size_t n) noexcept
+	{
+		if(alignof(T) > MemoryPool::Alignment)
+			std::allocator<T>().deallocate(p, n);
+		else
+			pool().deallocate(p, sizeof(T) * n);
+	}
+
+	template <typename U>
+	struct rebind {
+		using other = PoolAllocator<U, ThreadSafe>;
+	};
+};
+
+template <typename T, typename U, bool ThreadSafe>
+constexpr bool
+operator==(PoolAllocator<T, ThreadSafe> const&, PoolAllocator<U, ThreadSafe> const&) noexcept
+{
+	return true;
+}
+
+template <typename T, typename U, bool ThreadSafe>
+constexpr bool
+operator!=(PoolAllocator<T, ThreadSafe> const&, PoolAllocator<U, ThreadSafe> const&) noexcept
+{
+	return false;
+}
+#  endif // STORED_cplusplus >= 201103L
+
+template <size_t MaxSize>
+class ScratchPad;
+
+/*!
+ * \brief Heap allocation statistics per library component.
+ *
+ * Set stored::TrackingAllocator as stored::Config::Allocator, and set
+ * stored::Config::TrackAllocations to \c true. All allocations are then
+ * counted, and attributed to the component that does the allocation. The
+ * innermost #Scope determines this #Category. Frees are counted at the
+ * category where they happen, which is not necessarily the same as
+ * where the memory was allocated.
+ *
+ * Mark real-time sections of the application by a #RealTime instance.
+ * Allocations within such a section are counted, and optionally trapped
+ * by the handler passed to #setTrap().
+ *
+ * ScratchPads can be registered by #watch(). Their #stored::ScratchPad::max(),
+ * number of chunks and spills are included in the #report(). stored::Debugger registers its own
+ * ScratchPad. Registration may be done from any thread.
+ */
+class AllocationTracker {
+	STORED_CLASS_NOCOPY(AllocationTracker)
+public:
+	/*! \brief Library components. */
+	enum Category {
+		CategoryOther,
+		CategoryDebugger,
+		CategorySynchronizer,
+		CategoryProtocol,
+		CategoryPoller,
+		CategoryCount
+	};
+
+	/*! \brief Statistics of one #Category. */
+	struct Stats {
+		/*! \brief Number of allocations. */
+		size_t allocations;
+		/*! \brief Number of deallocations. */
+		size_t deallocations;
+		/*! \brief Total number of allocated bytes. */
+		size_t bytes;
+		/*! \brief Number of allocations within a #RealTime section. */
+		size_t realTime;
+	};
+
+	enum {
+		/*! \brief Maximum number of ScratchPads that can be #watch()ed. */
+		MaxWatches = 8
+	};
+
+	/*! \brief Callback for allocations within a #RealTime section. */
+	typedef void(TrapHandler)(Category category, size_t size);
+
+	/*!
+	 * \brief Attributes allocations within the lifetime of this object to the given category.
+	 */
+	class Scope {
+		STORED_CLASS_NOCOPY(Scope)
+	public:
+		explicit Scope(Category category) noexcept
+			: m_prev()
+		{
+			if(Config::TrackAllocations)
+				m_prev = enter(category);
+		}
+
+		~Scope() noexcept
+		{
+			if(Config::TrackAllocations)
+				enter(m_prev);
+		}
+
+	private:
+		/*! \brief The category to restore upon destruction. */
+		Category m_prev;
+	};
+
+	/*!
+	 * \brief Marks a real-time section, in which no allocations are expected.
+	 */
+	class RealTime {
+		STORED_CLASS_NOCOPY(RealTime)
+	public:
+		RealTime() noexcept
+		{
+			enterRealTime();
+		}
+
+		~RealTime() noexcept
+		{
+			leaveRealTime();
+		}
+	};
+
+	static Category category() noexcept;
+	static char const* name(Category category) noexcept;
+	static void allocated(size_t size);
+	static void deallocated(size_t size) noexcept;
+	static Stats stats(Category category) noexcept;
+	static Stats total() noexcept;
+	static size_t inUse() noexcept;
+	static size_t peak() noexcept;
+	static void reset() noexcept;
+
+	static bool realTime() noexcept;
+	static void setTrap(TrapHandler* handler = nullptr) noexcept;
+	static void abort(Category category, size_t size);
+
+	/*!
+	 * \brief Include the given ScratchPad in the #report().
+	 * \return \c false when there are already #MaxWatches ScratchPads registered
+	 */
+	template <size_t MaxSize>
+	static bool watch(char const* name, ScratchPad<MaxSize> const& spm) noexcept
+	{
+		return watch(name, &spm, &spmMax<MaxSize>, &spmChunks<MaxSize>, &spmSpills<MaxSize>);
+	}
+
+	static void unwatch(void const* spm) noexcept;
+	static void report(FILE* f = stdout);
+
+private:
+	/*! \brief Function to retrieve a property of a #watch()ed ScratchPad. */
+	typedef size_t(WatchFunc)(void const* spm);
+
+	template <size_t MaxSize>
+	static size_t spmMax(void const* spm)
+	{
+		return static_cast<ScratchPad<MaxSize> const*>(spm)->max();
+	}
+
+	template <size_t MaxSize>
+	static size_t spmChunks(void const* spm)
+	{
+		return static_cast<ScratchPad<MaxSize> const*>(spm)->chunks();
+	}
+
+	template <size_t MaxSize>
+	static size_t spmSpills(void const* spm)
+	{
+		return static_cast<ScratchPad<MaxSize> const*>(spm)->stats().spills;
+	}
+
+	static bool watch(
+		char const* name, void const* spm, WatchFunc* max, WatchFunc* chunks,
+		WatchFunc* spills) noexcept;
+	static Category enter(Category category) noexcept;
+	static void enterRealTime() noexcept;
+	static void leaveRealTime() noexcept;
+};
+
+#  if STORED_cplusplus >= 201103L
+/*!
+ * \brief Allocator that counts all allocations in stored::AllocationTracker.
+ *
+ * Use it in your \c stored_config.h like this:
+ *
+ * \code
+ * struct Config : public DefaultConfig {
+ *	static bool const TrackAllocations = true;
+ *
+ *	template <typename T>
+ *	struct Allocator {
+ *		typedef TrackingAllocator<T> type;
+ *	};
+ * };
+ * \endcode
+ *
+ * \tparam T the type to allocate
+ * \tparam Base the allocator that does the actual allocation, like
+ *         stored::PoolAllocator
+ */
+template <typename T, typename Base>
+class TrackingAllocator : public std::allocator_traits<Base>::template rebind_alloc<T> {
+public:
+	using base = typename std::allocator_traits<Base>::template rebind_alloc<T>;
+	using value_type = T;
+
+	TrackingAllocator() noexcept = default;
+
+	template <typename U, typename B>
+	// cppcheck-suppress noExplicitConstructor
+	TrackingAllocator(TrackingAllocator<U, B> const& a) noexcept // NOLINT
+		: base(a)
+	{}
+
+	/*!
+	 * \brief Allocate \p n objects.
+	 */
+	__attribute__((warn_unused_result)) T* allocate(size_t n)
+	{
+		AllocationTracker::allocated(sizeof(T) * n);
+		return std::allocator_traits<base>::allocate(*this, n);
+	}
+
+	/*!
+	 * \brief Deallocate \p n objects, previously returned by #allocate().
+	 */
+	void deallocate(T* p, size_t n) noexcept
+	{
+		AllocationTracker::deallocated(sizeof(T) * n);
+		std::allocator_traits<base>::deallocate(*this, p, n);
+	}
+
+	template <typename U>
+	struct rebind {
+		using other = TrackingAllocator<U, Base>;
+	};
+};
+
+template <typename T, typename U, typename B>
+constexpr bool
+operator==(TrackingAllocator<T, B> const&, TrackingAllocator<U, B> const&) noexcept
+{
+	return true;
+}
+
+template <typename T, typename U, typename B>
+constexpr bool
+operator!=(TrackingAllocator<T, B> const&, TrackingAllocator<U, B> const&) noexcept
+{
+	return false;
+}
+#  endif // STORED_cplusplus >= 201103L
+
 /*!
  * \brief libstored-allocator-aware \c std::deque.
  */
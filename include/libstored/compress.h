@@ -34,6 +34,24 @@ namespace stored {
  * where it compresses a full stream (not separate messages), which are
  * sent in chunks to the other side.
  *
+ * Short messages can be compressed better when the window of the encoder
+ * and decoder is primed with data that is likely to occur.  Use
+ * #setDictionary() to prime every message with a fixed dictionary, like
+ * common object names, and/or #setHistory() to prime it with the previous
+ * messages.  Both sides of the connection must use the same priming.
+ *
+ * Data that does not compress, like already compressed or random data, may
+ * even grow.  When #setAdaptive() is enabled, every message starts with a
+ * byte that indicates whether the rest is compressed or stored as-is. The
+ * smallest of both is sent.  When messages fail to compress consistently,
+ * compression is not even tried for a while, which saves CPU time.  Both
+ * sides of the connection must use the same setting.  See #stats() for the
+ * results.
+ *
+ * The benchmark \c tests/perf_compress measures the compression ratio,
+ * throughput and memory usage of typical traffic for several #Window and
+ * #Lookahead settings.
+ *
  * When heatshrink is not available, this layer is just a pass-through.
  */
 class CompressLayer : public ProtocolLayer {
@@ -53,6 +71,23 @@ public:
 		FlagEncoding = 1,
 		/*! \brief Flag for \c m_state to indicate an active decoder. */
 		FlagDecoding = 2,
+		/*! \brief Flag for \c m_state to indicate that the current message is not compressed. */
+		FlagSkipping = 4,
+
+		/*! \brief Adaptive mode header byte of a message that is stored as-is. */
+		HeaderStored = 0,
+		/*! \brief Adaptive mode header byte of a message that is compressed. */
+		HeaderCompressed = 1,
+
+		/*!
+		 * \brief Fixed-point scale of the estimated compression ratio.
+		 * \details A ratio of \c RatioScale means that messages do not shrink.
+		 */
+		RatioScale = 256,
+		/*! \brief Weight (as power of 2) of a new sample in the estimated compression ratio. */
+		RatioWeight = 3,
+		/*! \brief When compression is skipped, retry it once per this number of messages. */
+		ProbeInterval = 16,
 	};
 
 	explicit CompressLayer(ProtocolLayer* up = nullptr, ProtocolLayer* down = nullptr);
@@ -72,9 +107,60 @@ public:
 
 	bool idle() const;
 
+	void setDictionary(void const* dictionary, size_t len);
+	void setHistory(bool enable = true);
+	bool history() const;
+	bool primed() const;
+	void resetHistory();
+
+	void setAdaptive(bool enable = true);
+	bool adaptive() const;
+
+	void setTiming(bool enable = true);
+	bool timing() const;
+
+	/*!
+	 * \brief Compression statistics.
+	 * \see #stats()
+	 */
+	struct Stats {
+		/*! \brief Number of encoded messages. */
+		size_t messages;
+		/*! \brief Number of messages sent as-is, as compression did not reduce their size. */
+		size_t stored;
+		/*! \brief Number of messages sent as-is, without trying to compress them. */
+		size_t skipped;
+		/*! \brief Total number of bytes passed to #encode(). */
+		uint64_t encodeIn;
+		/*! \brief Total number of bytes passed to the layer below, including headers. */
+		uint64_t encodeOut;
+		/*! \brief Total number of bytes passed to #decode(). */
+		uint64_t decodeIn;
+		/*! \brief Total number of bytes passed to the layer above. */
+		uint64_t decodeOut;
+		/*!
+		 * \brief Time spent in compression, in ns.
+		 * \details Only measured when #setTiming() is enabled and a clock is available.
+		 */
+		uint64_t encodeTime_ns;
+		/*!
+		 * \brief Time spent in decompression, in ns.
+		 * \details Only measured when #setTiming() is enabled and a clock is available.
+		 */
+		uint64_t decodeTime_ns;
+	};
+
+	Stats const& stats() const;
+	void resetStats();
+	unsigned int ratio() const;
+
 protected:
 	void encoderPoll();
 	void decoderPoll();
+	void prime(bool encoding);
+	void encodeDown(void const* buffer, size_t len, bool last);
+	void decodeStored(void* buffer, size_t len);
+	uint64_t timestamp() const;
 
 private:
 	/*!
@@ -105,6 +191,74 @@ private:
 	 * \brief Current state of the encoder and decoder.
 	 */
 	uint8_t m_state;
+
+	/*!
+	 * \brief The dictionary, as set by #setDictionary().
+	 * \details Only the last <tt>1 << Window</tt> bytes are kept.
+	 */
+	uint8_t const* m_dictionary;
+
+	/*!
+	 * \brief Length of #m_dictionary.
+	 */
+	size_t m_dictionaryLen;
+
+	/*!
+	 * \brief Flag to indicate that the previous messages prime the window.
+	 */
+	bool m_history;
+
+	/*!
+	 * \brief Data to prime the encoder's window with at the start of a message.
+	 */
+	Vector<uint8_t>::type m_encodeWindow;
+
+	/*!
+	 * \brief Data to prime the decoder's window with at the start of a message.
+	 */
+	Vector<uint8_t>::type m_decodeWindow;
+
+	/*!
+	 * \brief Flag to indicate that #setAdaptive() is enabled.
+	 */
+	bool m_adaptive;
+
+	/*!
+	 * \brief The uncompressed data of the current message in adaptive mode.
+	 * \details The buffer is only allocated, not released.
+	 */
+	Vector<uint8_t>::type m_encodeBuffer;
+
+	/*!
+	 * \brief The compressed data of the current message in adaptive mode.
+	 * \details The buffer is only allocated, not released.
+	 */
+	Vector<uint8_t>::type m_encodeOutput;
+
+	/*!
+	 * \brief Estimated compression ratio, scaled by #RatioScale.
+	 */
+	unsigned int m_ratio;
+
+	/*!
+	 * \brief Number of messages since the last compression attempt.
+	 */
+	unsigned int m_sinceProbe;
+
+	/*!
+	 * \brief Flag to indicate that #setTiming() is enabled.
+	 */
+	bool m_timing;
+
+	/*!
+	 * \brief Start time of the current (resumed) compression step.
+	 */
+	uint64_t m_encodeStart;
+
+	/*!
+	 * \brief The statistics.
+	 */
+	Stats m_stats;
 };
 
 } // namespace stored
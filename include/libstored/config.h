@@ -11,6 +11,12 @@
 #	include <memory>
 
 namespace stored {
+template <typename T, bool ThreadSafe = false>
+class PoolAllocator;
+
+template <typename T, typename Base = std::allocator<T> /**/>
+class TrackingAllocator;
+
 /*!
  * \brief Default configuration.
  *
@@ -92,6 +98,13 @@ struct DefaultConfig {
 		false;
 #	endif
 
+	/*!
+	 * \brief When \c true, library components mark their allocations for stored::AllocationTracker.
+	 *
+	 * The actual counting is done by stored::TrackingAllocator, which should be set as #Allocator.
+	 */
+	static bool const TrackAllocations = false;
+
 	/*! \brief When \c true, stored::Debugger implements the read capability. */
 	static bool const DebuggerRead = true;
 	/*! \brief When \c true, stored::Debugger implements the write capability. */
@@ -190,6 +203,9 @@ struct DefaultConfig {
 	 *
 	 * C++11's <tt>template &lt;typename T&gt; using Allocator = std::allocator&lt;T&gt;;</tt>
 	 * would be nicer, but this construct works for all versions of C++.
+	 *
+	 * To avoid heap traffic after initialization, use stored::PoolAllocator.
+	 * To count allocations, use stored::TrackingAllocator.
 	 */
 	template <typename T>
 	struct Allocator {
@@ -205,6 +221,20 @@ struct DefaultConfig {
 #	else
 		false;
 #	endif
+
+	/*!
+	 * \brief Size of a cache line in bytes.
+	 *
+	 * Thread-safe FIFOs put the producer and consumer data on separate
+	 * cache lines to prevent false sharing.  Set to 0 to disable this
+	 * padding, which saves memory on targets without a data cache.
+	 */
+	static size_t const CacheLineSize =
+#	if defined(STORED_OS_BAREMETAL) || defined(STORED_OS_GENERIC)
+		0;
+#	else
+		64;
+#	endif
 };
 } // namespace stored
 #endif // __cplusplus
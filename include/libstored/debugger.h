@@ -148,6 +148,18 @@ public:
 		return std::min(more, real_max - size);
 	}
 
+	void prime(void const* dictionary, size_t len) noexcept
+	{
+		// Nothing to prime without compression.
+		STORED_UNUSED(dictionary)
+		STORED_UNUSED(len)
+	}
+
+	bool primed() const noexcept
+	{
+		return false;
+	}
+
 private:
 	String::type m_buffer;
 	bool m_block;
@@ -254,6 +266,32 @@ public:
 		return std::min(more, default_max - size);
 	}
 
+	/*!
+	 * \brief Prime the compression with the given dictionary and the previously flushed data.
+	 *
+	 * This (re)starts the history. The compressor must be idle.
+	 * \see stored::CompressLayer::setDictionary(), stored::CompressLayer::setHistory()
+	 */
+	void prime(void const* dictionary, size_t len)
+	{
+#	ifdef STORED_HAVE_HEATSHRINK
+		m_compress.setDictionary(dictionary, len);
+		m_compress.setHistory();
+#	else
+		STORED_UNUSED(dictionary)
+		STORED_UNUSED(len)
+#	endif
+	}
+
+	bool primed() const noexcept
+	{
+		return
+#	ifdef STORED_HAVE_HEATSHRINK
+			m_compress.primed() ||
+#	endif
+			false;
+	}
+
 private:
 	CompressLayer m_compress;
 	Stream<false> m_string;
@@ -847,9 +885,25 @@ public:
 	static char const CmdStream = 's';
 	static char const CmdTrace = 't';
 	static char const CmdFlush = 'f';
+	static char const CmdPublish = 'p';
+	static char const CmdPrime = 'z';
+	static char const CmdTraceCodec = 'c';
 	static char const Ack = '!';
 	static char const Nack = '?';
 
+	////////////////////////////
+	// Trace codec
+
+	static char const TraceFieldSkip = '_';
+	static char const TraceFieldRaw = '-';
+	static char const TraceFieldInt = 'i';
+	static char const TraceFieldFloat = 'f';
+	static char const TraceFieldDouble = 'd';
+	static char const TraceKey = 'K';
+	static char const TraceDelta = 'D';
+	/*! \brief Number of samples after which the codec state is reset by a #TraceKey sample. */
+	static unsigned int const TraceKeyInterval = 64;
+
 public:
 	virtual void capabilities(char*& caps, size_t& len, size_t reserve = 0);
 	virtual char const* identification();
@@ -866,9 +920,20 @@ public:
 	void trace();
 	bool tracing() const;
 
+	void setPublisher(ProtocolLayer* publisher = nullptr);
+	ProtocolLayer* publisher() const;
+	void publish(char s, bool end = false);
+
+	void setStreamDictionary(char const* dictionary = nullptr, size_t len = 0);
+
 	virtual void process(void const* frame, size_t len, ProtocolLayer& response);
 	virtual void decode(void* buffer, size_t len) override;
 
+#	if STORED_cplusplus >= 201103L
+	void setScratchPadPool(ScratchPadPool<>* pool = nullptr);
+	ScratchPadPool<>* scratchPadPool() const;
+#	endif
+
 protected:
 	ScratchPad<>& spm() const;
 
@@ -882,6 +947,10 @@ protected:
 	MacroMap& macros();
 	MacroMap const& macros() const;
 	virtual bool runMacro(char m, ProtocolLayer& response);
+	bool traceSample(Stream<>& str);
+	void traceField(char kind, size_t field, Stream<>& str);
+	void drain(Stream<>& str, ProtocolLayer& out);
+	void publishHeader(size_t index, bool last);
 
 	/*!
 	 * \brief Encode a given value to ASCII hex.
@@ -902,6 +971,10 @@ protected:
 private:
 	/*! \brief A scratch pad memory for any Debugger operation. */
 	mutable ScratchPad<> m_scratchpad;
+#	if STORED_cplusplus >= 201103L
+	/*! \brief The pool to lease a ScratchPad from while processing a request. */
+	ScratchPadPool<>* m_scratchpadPool;
+#	endif
 
 	/*! \brief The identification. */
 	char const* m_identification;
@@ -929,6 +1002,26 @@ private:
 	unsigned int m_traceDecimate;
 	/*! \brief Decimate counter of #trace(). */
 	unsigned int m_traceCount;
+	/*! \brief Field layout of the binary trace encoding. Empty for plain macro output. */
+	String::type m_traceLayout;
+	/*! \brief Codec state of #m_traceLayout; the previous value and delta per field. */
+	Vector<uint64_t>::type m_traceState;
+	/*! \brief Number of samples until the next #TraceKey sample. */
+	unsigned int m_traceKey;
+	/*! \brief Output of one field of the trace macro. */
+	String::type m_traceField;
+
+	/*! \brief The layer to push stream data to. See #setPublisher(). */
+	ProtocolLayer* m_publisher;
+	/*! \brief Pairs of stream name and tag of the streams to publish. */
+	String::type m_publish;
+	/*! \brief Sequence number of the next message of every pair in #m_publish. */
+	Vector<uint16_t>::type m_publishSeq;
+
+	/*! \brief The dictionary to prime compressed streams with. See #setStreamDictionary(). */
+	char const* m_streamDictionary;
+	/*! \brief Length of #m_streamDictionary. */
+	size_t m_streamDictionaryLen;
 };
 
 } // namespace stored
@@ -13,8 +13,10 @@
 #		include <libstored/protocol.h>
 #		include <libstored/util.h>
 
+#		include <algorithm>
 #		include <array>
 #		include <atomic>
+#		include <chrono>
 #		include <cstring>
 #		include <functional>
 #		include <iterator>
@@ -37,13 +39,13 @@ struct buffer_ops {
 	static void set(B& buffer, pointer p, typename B::value_type const* x, size_t len) noexcept
 	{
 		if(len)
-			memcpy(&buffer[p], x, len);
+			memcpy(&buffer[p], x, len * sizeof(typename B::value_type));
 	}
 
 	static void move(B& buffer, pointer dst, pointer src, size_t len) noexcept
 	{
 		if(len)
-			memmove(&buffer[dst], &buffer[src], len);
+			memmove(&buffer[dst], &buffer[src], len * sizeof(typename B::value_type));
 	}
 };
 
@@ -79,6 +81,21 @@ void buffer_move(B& buffer, pointer dst, pointer src, size_t len) noexcept
 {
 	buffer_ops<B, pointer>::move(buffer, dst, src, len);
 }
+
+/*!
+ * \brief Alignment of \p T, which is padded to Config::CacheLineSize if \p Pad is set.
+ *
+ * Over-aligned types are only properly allocated by \c new since C++17,
+ * so padding is only applied as of that version.
+ */
+template <typename T, bool Pad>
+struct cacheline_align {
+	enum : size_t {
+		value = Pad && STORED_cplusplus >= 201703L && Config::CacheLineSize > alignof(T)
+				? Config::CacheLineSize
+				: alignof(T)
+	};
+};
 } // namespace impl
 
 /*!
@@ -198,8 +215,8 @@ public:
 	{
 		stored_assert(dst + (pointer)len >= dst);
 		stored_assert(src + (pointer)len >= src);
-		stored_assert((size_t)dst + len < size());
-		stored_assert((size_t)src + len < size());
+		stored_assert((size_t)dst + len <= size());
+		stored_assert((size_t)src + len <= size());
 
 		impl::buffer_move(m_buffer, dst, src, len);
 	}
@@ -300,6 +317,13 @@ private:
  * communicate between threads, but also by an interrupt handler.
  *
  * If unbounded, it cannot be thread-safe.
+ *
+ * When thread-safe, the producer and consumer indices are kept on separate
+ * cache lines (see Config::CacheLineSize).  Both sides keep a cached copy of
+ * the other side's index, which is only refreshed when the FIFO seems to be
+ * full or empty.  Therefore, only call #empty(), #available(), #front(),
+ * #peek() and #pop_front() from the consumer, and #full(), #space() and the
+ * push and reserve functions from the producer.
  */
 template <typename T, size_t Capacity = 0, bool ThreadSafe = (Capacity > 0)>
 class Fifo {
@@ -329,24 +353,33 @@ public:
 
 	bool empty() const noexcept
 	{
-		return m_wp.load(std::memory_order_relaxed) == m_rp.load(std::memory_order_relaxed);
+		pointer rp = m_rp.load(std::memory_order_relaxed);
+
+		if(ThreadSafe && m_wp_cache.load(std::memory_order_relaxed) != rp)
+			return false;
+
+		return load_wp() == rp;
 	}
 
 	bool full() const noexcept
 	{
+		if(ThreadSafe
+		   && used(m_wp.load(std::memory_order_relaxed),
+			   m_rp_cache.load(std::memory_order_relaxed))
+			      < capacity() - 1U)
+			return false;
+
 		return space() == 0;
 	}
 
 	size_t available() const noexcept
 	{
-		pointer wp = m_wp.load(std::memory_order_relaxed);
-		pointer rp = m_rp.load(std::memory_order_relaxed);
-		return wp >= rp ? wp - rp : wp + m_buffer.size() - rp;
+		return used(load_wp(), m_rp.load(std::memory_order_relaxed));
 	}
 
 	size_t space() const noexcept
 	{
-		return capacity() - available() - 1;
+		return capacity() - used(m_wp.load(std::memory_order_relaxed), load_rp()) - 1U;
 	}
 
 	type const& front() const noexcept
@@ -378,7 +411,7 @@ public:
 		stored_assert(offset < available());
 		pointer rp = m_rp.load(
 			ThreadSafe ? std::memory_order_consume : std::memory_order_relaxed);
-		return m_buffer[(rp + offset) % m_buffer.size()];
+		return m_buffer[(pointer)((rp + offset) % m_buffer.size())];
 	}
 
 	type const& operator[](size_t offset) const noexcept
@@ -393,22 +426,79 @@ public:
 
 	void pop_front(size_t count = 1) noexcept
 	{
-		pointer wp = m_wp.load(std::memory_order_relaxed);
 		pointer rp = m_rp.load(std::memory_order_relaxed);
 		stored_assert(count <= available());
 
 		rp = (pointer)(rp + count);
-		if(wp < rp && rp >= m_buffer.size())
-			rp = (pointer)(rp - m_buffer.size());
 
-		if(!bounded() && wp == rp) {
+		if(bounded()) {
+			if(rp >= m_buffer.size())
+				rp = (pointer)(rp - m_buffer.size());
+		} else if(m_wp.load(std::memory_order_relaxed) == rp) {
 			// Reset to the start of the buffer, as it became empty.
 			stored_assert(!ThreadSafe);
 			m_wp.store(0, std::memory_order_relaxed);
-			m_rp.store(0, std::memory_order_relaxed);
-		} else {
-			m_rp.store(rp, std::memory_order_relaxed);
+			rp = 0;
 		}
+
+		m_rp.store(rp, ThreadSafe ? std::memory_order_release : std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief A contiguous range of elements in the FIFO.
+	 */
+	struct Span {
+		type* data;
+		size_t size;
+	};
+
+	/*!
+	 * \brief Get all available elements as (at most) two contiguous spans.
+	 *
+	 * As a bounded FIFO is a circular buffer, the available elements may
+	 * wrap around the end of the buffer.  The \c first span starts at
+	 * #front(); the \c second one, if not empty, continues at the start of
+	 * the buffer.  Process the elements in-place and call #pop_front()
+	 * with the number of processed elements afterwards.
+	 */
+	std::pair<Span, Span> spans() noexcept
+	{
+		pointer rp = m_rp.load(std::memory_order_relaxed);
+		pointer wp = load_wp();
+
+		if(wp == rp)
+			return std::make_pair(Span{nullptr, 0}, Span{nullptr, 0});
+		else if(wp > rp)
+			return std::make_pair(Span{&m_buffer[rp], (size_t)(wp - rp)}, Span{nullptr, 0});
+		else
+			return std::make_pair(
+				Span{&m_buffer[rp], m_buffer.size() - rp},
+				Span{wp > 0 ? &m_buffer[0] : nullptr, (size_t)wp});
+	}
+
+	/*!
+	 * \brief Pop at most \p count elements and write them to \p out.
+	 *
+	 * The elements are copied in at most two contiguous chunks, and the
+	 * consumer's index is only updated once.
+	 *
+	 * \return the number of popped elements
+	 */
+	template <typename OutIt>
+	size_t pop_front(OutIt out, size_t count)
+	{
+		std::pair<Span, Span> s = spans();
+		count = std::min(count, s.first.size + s.second.size);
+		if(!count)
+			return 0;
+
+		size_t first = std::min(count, s.first.size);
+		out = std::copy(s.first.data, s.first.data + first, out);
+		if(count > first)
+			std::copy(s.second.data, s.second.data + (count - first), out);
+
+		pop_front(count);
+		return count;
 	}
 
 	void push_back(T const& x)
@@ -470,26 +560,92 @@ public:
 	{
 		stored_assert(len == 0 || value);
 
+		if(!len)
+			return;
+
 		pointer wp;
 		pointer wp_next;
 		reserve_back(wp, wp_next, len);
 
-		size_t size = m_buffer.size();
+		// Copy in at most two contiguous chunks.
+		size_t first = bounded() ? std::min(len, m_buffer.size() - wp) : len;
+		m_buffer.set(wp, value, first);
+		if(len > first)
+			m_buffer.set(0, value + first, len - first);
 
-		while(len--) {
-			m_buffer[wp++] = *value++;
+		m_wp.store(
+			wp_next,
+			ThreadSafe ? std::memory_order_release : std::memory_order_relaxed);
+	}
 
-			if(bounded() && wp == size)
-				wp = 0;
+	/*!
+	 * \brief Reserve contiguous space at the back of the FIFO for in-place writing.
+	 *
+	 * At most \p count elements are reserved. As a bounded FIFO is a
+	 * circular buffer, less contiguous elements may be available; \p count
+	 * is updated to the number of elements that are actually reserved.
+	 *
+	 * Write the elements via the returned pointer, and call #commit() to
+	 * make them available to the consumer, or #abort() to drop them.
+	 * Do not do any other push in between.
+	 *
+	 * \return a pointer to the first reserved element, or \c nullptr when
+	 *         nothing could be reserved
+	 */
+	type* reserve(size_t& count)
+	{
+		pointer wp = m_wp.load(std::memory_order_relaxed);
+
+		if(bounded()) {
+			size_t contiguous = contiguous_space(
+				wp,
+				ThreadSafe ? m_rp_cache.load(std::memory_order_relaxed)
+					   : m_rp.load(std::memory_order_relaxed));
+
+			if(ThreadSafe && count > contiguous)
+				contiguous = contiguous_space(wp, load_rp());
+
+			if(count > contiguous)
+				count = contiguous;
+		} else if(count > 0) {
+			pointer wp_next;
+			reserve_back(wp, wp_next, count);
 		}
 
-		stored_assert(wp == wp_next);
+		m_reserved = count;
+		return count > 0 ? &m_buffer[wp] : nullptr;
+	}
+
+	/*!
+	 * \brief Push the first \p count elements of the previous #reserve() to the FIFO.
+	 */
+	void commit(size_t count)
+	{
+		stored_assert(count <= m_reserved);
+		m_reserved = 0;
+
+		if(!count)
+			return;
+
+		pointer wp = m_wp.load(std::memory_order_relaxed);
+		pointer wp_next = (pointer)(wp + count);
+
+		if(bounded() && wp_next >= m_buffer.size())
+			wp_next = (pointer)(wp_next - m_buffer.size());
 
 		m_wp.store(
 			wp_next,
 			ThreadSafe ? std::memory_order_release : std::memory_order_relaxed);
 	}
 
+	/*!
+	 * \brief Drop the previous #reserve().
+	 */
+	void abort() noexcept
+	{
+		m_reserved = 0;
+	}
+
 	typedef PopIterator<Fifo> iterator;
 	constexpr iterator begin() noexcept
 	{
@@ -508,11 +664,56 @@ public:
 			m_wp.store(0, std::memory_order_relaxed);
 			m_rp.store(0, std::memory_order_relaxed);
 		} else {
-			m_rp.store(m_wp.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			m_rp.store(
+				load_wp(),
+				ThreadSafe ? std::memory_order_release : std::memory_order_relaxed);
 		}
 	}
 
 protected:
+	/*!
+	 * \brief Number of elements in use between \p rp and \p wp.
+	 */
+	size_t used(pointer wp, pointer rp) const noexcept
+	{
+		return wp >= rp ? (size_t)(wp - rp) : (size_t)(wp + m_buffer.size() - rp);
+	}
+
+	/*!
+	 * \brief Number of contiguous free elements from \p wp in a bounded FIFO.
+	 */
+	size_t contiguous_space(pointer wp, pointer rp) const noexcept
+	{
+		return wp >= rp ? m_buffer.size() - wp - (rp == 0 ? 1U : 0U)
+				: (size_t)(rp - wp - 1U);
+	}
+
+	/*!
+	 * \brief Load the producer's index at the consumer side, and refresh its cached copy.
+	 */
+	pointer load_wp() const noexcept
+	{
+		if(!ThreadSafe)
+			return m_wp.load(std::memory_order_relaxed);
+
+		pointer wp = m_wp.load(std::memory_order_acquire);
+		m_wp_cache.store(wp, std::memory_order_relaxed);
+		return wp;
+	}
+
+	/*!
+	 * \brief Load the consumer's index at the producer side, and refresh its cached copy.
+	 */
+	pointer load_rp() const noexcept
+	{
+		if(!ThreadSafe)
+			return m_rp.load(std::memory_order_relaxed);
+
+		pointer rp = m_rp.load(std::memory_order_acquire);
+		m_rp_cache.store(rp, std::memory_order_relaxed);
+		return rp;
+	}
+
 	enum {
 		UnboundedMoveThreshold = 64,
 	};
@@ -550,9 +751,18 @@ protected:
 	}
 
 private:
+	typedef impl::cacheline_align<std::atomic<pointer>, ThreadSafe> align;
+
 	Buffer_type m_buffer;
-	std::atomic<pointer> m_wp{0};
-	std::atomic<pointer> m_rp{0};
+
+	// Owned by the producer.
+	alignas(align::value) std::atomic<pointer> m_wp{0};
+	mutable std::atomic<pointer> m_rp_cache{0};
+	size_t m_reserved{0};
+
+	// Owned by the consumer.
+	alignas(align::value) std::atomic<pointer> m_rp{0};
+	mutable std::atomic<pointer> m_wp_cache{0};
 };
 
 /*!
@@ -646,6 +856,10 @@ static constexpr size_t defaultMessages(size_t capacity)
  * be configured to be thread-safe, which is also async-signal safe.
  * Therefore, it can be used to pass messages between threads, but also
  * from/to an interrupt handler.
+ *
+ * When thread-safe, the producer keeps a cached copy of the consumer's
+ * buffer index, like #stored::Fifo does.  The consumer never reads the
+ * producer's buffer index, as the message queue passes the data location.
  */
 template <
 	size_t Capacity = 0, size_t Messages = impl::defaultMessages(Capacity),
@@ -699,7 +913,7 @@ public:
 		if(m_msg.full())
 			return 0;
 
-		size_t rp = m_rp.load(std::memory_order_relaxed);
+		size_t rp = m_rp.load(std::memory_order_acquire);
 		size_t wp = m_wp.load(std::memory_order_relaxed);
 		size_t partial = m_wp_partial - wp;
 		size_t sz = size();
@@ -726,7 +940,8 @@ public:
 	void pop_front() noexcept
 	{
 		Msg const& msg = m_msg.front();
-		m_rp.store((buffer_pointer)(msg.first + msg.second), std::memory_order_relaxed);
+		// Release the message data to the producer.
+		m_rp.store((buffer_pointer)(msg.first + msg.second), std::memory_order_release);
 		m_msg.pop_front();
 	}
 
@@ -790,13 +1005,97 @@ public:
 		if(!message.size())
 			return true;
 
-		buffer_pointer rp = m_rp.load(std::memory_order_relaxed);
+		if(!reserve_partial(message.size()))
+			return false;
+
+		// Write message content.
+		m_buffer.set(m_wp_partial, message.data(), message.size());
+		m_wp_partial = (buffer_pointer)(m_wp_partial + message.size());
+		return true;
+	}
+
+	/*!
+	 * \brief Reserve buffer space at the back of the FIFO for in-place writing.
+	 *
+	 * The reserved space directly follows previously appended (partial)
+	 * data.  Write the message via the returned #stored::Message, and
+	 * call #commit() to append it, or #abort() to drop it.  Do not do
+	 * any other push or append in between.
+	 *
+	 * \return the writable buffer of \p length bytes, which has a \c
+	 *         nullptr data() when it does not fit
+	 */
+	type reserve(size_t length)
+	{
+		m_reserved = 0;
+
+		if(!length || !reserve_partial(length))
+			return type{nullptr, 0};
+
+		m_reserved = length;
+		return type{&m_buffer[m_wp_partial], length};
+	}
+
+	/*!
+	 * \brief Append the first \p length bytes of the previous #reserve().
+	 *
+	 * When \p last is \c true, the appended data is pushed as one
+	 * message, like #push_back().
+	 *
+	 * \return \c false when \p last is set, but the message could not be
+	 *         pushed as the FIFO is full. The data is still appended, so
+	 *         retry with #push_back() or drop it with #reset_back().
+	 */
+	bool commit(size_t length, bool last = true)
+	{
+		stored_assert(length <= m_reserved);
+		m_reserved = 0;
+		m_wp_partial = (buffer_pointer)(m_wp_partial + length);
+		return !last || push_back();
+	}
+
+	/*!
+	 * \brief Drop the previous #reserve().
+	 */
+	void abort() noexcept
+	{
+		m_reserved = 0;
+	}
+
+protected:
+	/*!
+	 * \brief Make sure that \p length bytes can be written at \c m_wp_partial.
+	 *
+	 * When thread-safe, the consumer's index is only reloaded when the
+	 * message does not fit using the cached copy, like #stored::Fifo does.
+	 *
+	 * \return \c false if it does not fit (now)
+	 */
+	bool reserve_partial(size_t length)
+	{
+		// The cached read pointer is stale, but the consumer only frees
+		// space, so it never overestimates what fits.  Skip it when
+		// not thread-safe, as the empty-buffer reset below needs an
+		// up-to-date pointer to prevent an unbounded FIFO from growing.
+		if(ThreadSafe && reserve_partial(length, m_rp_cache, false))
+			return true;
+
+		m_rp_cache = m_rp.load(std::memory_order_acquire);
+		return reserve_partial(length, m_rp_cache, true);
+	}
+
+	/*!
+	 * \brief Try to reserve \p length bytes, given the read pointer \p rp.
+	 * \param fresh \c true when \p rp was just loaded from \c m_rp
+	 */
+	bool reserve_partial(size_t length, buffer_pointer rp, bool fresh)
+	{
 		buffer_pointer wp = m_wp.load(std::memory_order_relaxed);
 		buffer_pointer wp_partial = m_wp_partial;
 		stored_assert(wp_partial >= wp);
 		size_t partial = (size_t)(wp_partial - wp);
 
-		if(unlikely(Capacity > 0 && message.size() + partial > Capacity)) {
+		if(unlikely(Capacity > 0 && length + partial > Capacity)) {
 			// Will never fit.
 #		ifdef STORED_cpp_exceptions
 			throw std::bad_alloc();
@@ -805,7 +1104,7 @@ public:
 #		endif
 		}
 
-		if(wp == rp && partial == 0) {
+		if(fresh && wp == rp && partial == 0) {
 			// Note: Because of race conditions in a threaded
 			// environment, it might be the case that empty() is
 			// not yet true, as pop_front() first updates rp and
@@ -814,26 +1113,25 @@ public:
 			// When empty, the other side ignores the wp/rp, so we
 			// can safely tinker with it.
 			wp = m_wp_partial = wp_partial = 0;
-			rp = 0;
+			rp = m_rp_cache = 0;
 			m_wp.store(wp, std::memory_order_relaxed);
 			m_rp.store(rp, std::memory_order_relaxed);
 		}
 
 		if(Capacity == 0) {
 			// Make buffer larger.
-			m_buffer.resize((size_t)wp_partial + message.size());
+			m_buffer.resize((size_t)wp_partial + length);
 		} else if(wp >= rp) {
 			// [rp,wp_partial[ is in use.
-			if((size_t)wp_partial + message.size() < m_buffer.size()) {
+			if((size_t)wp_partial + length < m_buffer.size()) {
 				// Ok, fits in the remaining buffer.
-			} else if(
-				(size_t)wp_partial + message.size() <= m_buffer.size() && rp > 0) {
+			} else if((size_t)wp_partial + length <= m_buffer.size() && rp > 0) {
 				// Ok, fits in the remaining buffer.
-			} else if((size_t)rp > partial + message.size()) {
+			} else if((size_t)rp > partial + length) {
 				// The message fits at the start of the buffer.
 				m_buffer.move(0, wp, partial);
 				wp = 0;
-				m_wp_partial = wp_partial = (buffer_pointer)partial;
+				m_wp_partial = (buffer_pointer)partial;
 				m_wp.store(wp, std::memory_order_relaxed);
 			} else {
 				// Does not fit.
@@ -841,7 +1139,7 @@ public:
 			}
 		} else {
 			// [0,wp_partial[ and [rp,size()[ is in use.
-			if((size_t)(rp - wp_partial) > message.size()) {
+			if((size_t)(rp - wp_partial) > length) {
 				// Fits here.
 			} else {
 				// Does not fit.
@@ -849,12 +1147,10 @@ public:
 			}
 		}
 
-		// Write message content.
-		m_buffer.set(wp_partial, message.data(), message.size());
-		m_wp_partial = (buffer_pointer)(m_wp_partial + message.size());
 		return true;
 	}
 
+public:
 	template <typename It>
 	size_t push_back(It start, It end)
 	{
@@ -894,20 +1190,190 @@ public:
 	void clear()
 	{
 		m_rp.store(
-			m_wp_partial = m_wp.load(std::memory_order_relaxed),
+			m_rp_cache = m_wp_partial = m_wp.load(std::memory_order_relaxed),
 			std::memory_order_relaxed);
 		m_msg.clear();
 	}
 
 private:
+	typedef impl::cacheline_align<std::atomic<buffer_pointer>, ThreadSafe> align;
+
 	Buffer_type m_buffer;
-	std::atomic<buffer_pointer> m_rp{0};
-	std::atomic<buffer_pointer> m_wp{0};
+
+	// Owned by the producer.
+	alignas(align::value) std::atomic<buffer_pointer> m_wp{0};
 	buffer_pointer m_wp_partial{0};
+	buffer_pointer m_rp_cache{0};
+	size_t m_reserved{0};
+
+	// Owned by the consumer.
+	alignas(align::value) std::atomic<buffer_pointer> m_rp{0};
 
 	Fifo<Msg, Messages> m_msg;
 };
 
+#		if defined(STORED_OS_POSIX) || defined(DOXYGEN)
+/*!
+ * \brief Pollable wake-up event between the producer and consumer of a FIFO.
+ *
+ * The FIFOs themselves never block.  Use a FifoEvent to let one side sleep
+ * until the other side changed the FIFO.  For example:
+ *
+ * \code
+ * stored::Fifo<int, 16> fifo;
+ * stored::FifoEvent data;
+ * data.open();
+ *
+ * // Producer
+ * fifo.push_back(42);
+ * data.notify();
+ *
+ * // Consumer
+ * data.wait([&]() { return !fifo.empty(); });
+ * int x = fifo.front();
+ * fifo.pop_front();
+ * \endcode
+ *
+ * #notify() only does a system call when the other side is actually
+ * waiting.  Instead of #wait(), #fd() can be registered in a
+ * stored::Poller (as stored::PollableFd with \c PollIn).  In that case,
+ * #arm() the event, and check the FIFO again, before polling.
+ *
+ * On Linux, an \c eventfd is used. Other POSIX systems use a pipe.
+ */
+class FifoEvent {
+	STORED_CLASS_NOCOPY(FifoEvent)
+public:
+	FifoEvent() noexcept = default;
+	~FifoEvent();
+
+	/*!
+	 * \brief Create the file descriptor(s).
+	 *
+	 * Call this before the FIFO is used concurrently.
+	 *
+	 * \return 0 on success, otherwise an \c errno
+	 */
+	int open() noexcept;
+	void close() noexcept;
+
+	bool isOpen() const noexcept
+	{
+		return m_fd[0] >= 0;
+	}
+
+	/*!
+	 * \brief The pollable file descriptor, which is readable when notified.
+	 */
+	int fd() const noexcept
+	{
+		return m_fd[0];
+	}
+
+	/*!
+	 * \brief Wake up the other side, if it is waiting.
+	 *
+	 * Call this after modifying the FIFO.
+	 */
+	void notify() noexcept
+	{
+		if(!isOpen())
+			return;
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(m_armed.load(std::memory_order_relaxed)
+		   && m_armed.exchange(false, std::memory_order_relaxed))
+			signal();
+	}
+
+	/*!
+	 * \brief Prepare for waiting.
+	 *
+	 * After arming, the next #notify() makes #fd() readable.  Always
+	 * recheck the FIFO after arming, as it may have changed in the mean
+	 * time.
+	 */
+	void arm() noexcept
+	{
+		if(m_pending)
+			drain();
+
+		m_pending = true;
+		m_armed.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	/*!
+	 * \brief Stop waiting.
+	 */
+	void disarm() noexcept
+	{
+		m_armed.store(false, std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Wait until \p ready returns \c true.
+	 *
+	 * \p ready is evaluated after every #notify() of the other side.
+	 *
+	 * \param ready a function that checks the FIFO's state
+	 * \param timeout_us the timeout in microseconds, or -1 to wait forever
+	 * \return 0 when \p ready returned \c true, \c EAGAIN on timeout,
+	 *         otherwise an \c errno
+	 */
+	template <typename F>
+	int wait(F&& ready, long timeout_us = -1)
+	{
+		if(ready())
+			return 0;
+
+		if(!isOpen())
+			return timeout_us ? EINVAL : EAGAIN;
+
+		auto deadline = std::chrono::steady_clock::now()
+				+ std::chrono::microseconds(timeout_us > 0 ? timeout_us : 0);
+
+		while(true) {
+			arm();
+
+			if(ready()) {
+				disarm();
+				return 0;
+			}
+
+			long remaining = timeout_us;
+			if(timeout_us == 0) {
+				// Leave armed, such that a poller on fd() gets notified.
+				return EAGAIN;
+			} else if(timeout_us > 0) {
+				remaining = (long)std::chrono::duration_cast<std::chrono::microseconds>(
+						    deadline - std::chrono::steady_clock::now())
+						    .count();
+				if(remaining <= 0)
+					return EAGAIN;
+			}
+
+			int res = block(remaining);
+			if(res)
+				return res;
+		}
+	}
+
+protected:
+	int block(long timeout_us) noexcept;
+	void signal() noexcept;
+	void drain() noexcept;
+
+private:
+	/*! \brief The read and write end. With \c eventfd, both are the same. */
+	int m_fd[2] = {-1, -1};
+	/*! \brief Set by the waiting side, consumed by #notify(). */
+	std::atomic<bool> m_armed{false};
+	/*! \brief Only used by the waiting side, set when #fd() may be readable. */
+	bool m_pending = false;
+};
+#		endif // STORED_OS_POSIX
+
 #		ifdef STORED_COMPILER_GCC
 // We seem to trigger https://gcc.gnu.org/bugzilla/show_bug.cgi?id=105469
 #			pragma GCC push_options
@@ -918,8 +1384,8 @@ private:
  * \brief A ProtocolLayer that buffers downstream messages.
  *
  * To get the messages from the fifo, call #recv(). If there are any, the
- * are passed upstream.  Blocking on a #recv() is not supported; always use
- * 0 as timeout (no waiting).
+ * are passed upstream.  Blocking on a #recv() is only supported after
+ * #enableWait(); otherwise, always use 0 as timeout (no waiting).
  *
  * This fifo is thread-safe by default. Only encode() messages from one
  * context, and only recv() (and therefore decode()) from another context.
@@ -943,24 +1409,38 @@ public:
 	/*!
 	 * \brief Pass at most one message in the FIFO to #decode().
 	 *
-	 * \p timeout_us is here for compatibility with the ProtocolLayer
-	 * interface, but must be 0. Actual blocking is not supported.
+	 * Unless #enableWait() was called, \p timeout_us must be 0, as
+	 * blocking is not supported then.
 	 *
 	 * The return value is either 0 on success or \c EAGAIN in case the
 	 * FIFO is empty.  This value is not saved in #lastError(), as that
 	 * field is only used by #encode() and is not thread-safe.
+	 *
+	 * When #fd() is polled, call #recv() until it returns \c EAGAIN before
+	 * polling again.
 	 */
 	virtual int recv(long timeout_us = 0) override
 	{
-		STORED_UNUSED(timeout_us)
-		stored_assert(timeout_us == 0);
-
-		if(m_fifo.empty())
-			return EAGAIN;
+		if(m_fifo.empty()) {
+#		ifdef STORED_OS_POSIX
+			if(m_dataEvent.isOpen()) {
+				int res = m_dataEvent.wait(
+					[this]() { return !m_fifo.empty(); }, timeout_us);
+				if(res)
+					return res;
+			} else
+#		endif
+			{
+				STORED_UNUSED(timeout_us)
+				stored_assert(timeout_us == 0);
+				return EAGAIN;
+			}
+		}
 
 		auto m = m_fifo.front();
 		decode(m.data(), m.size());
 		m_fifo.pop_front();
+		popped();
 
 		return 0;
 	}
@@ -970,10 +1450,79 @@ public:
 	 */
 	virtual void recvAll()
 	{
-		for(auto m : m_fifo)
-			decode(m.data(), m.size());
+		do {
+			bool consumed = false;
+
+			for(auto m : m_fifo) {
+				decode(m.data(), m.size());
+				consumed = true;
+			}
+
+			if(consumed)
+				popped();
+		}
+#		ifdef STORED_OS_POSIX
+		// Make sure that the event is armed for the next poll.
+		while(m_dataEvent.isOpen()
+		      && m_dataEvent.wait([this]() { return !m_fifo.empty(); }, 0) == 0);
+#		else
+		while(false);
+#		endif
 	}
 
+#		if defined(STORED_OS_POSIX) || defined(DOXYGEN)
+	/*!
+	 * \brief Enable blocking #recv(), #waitSpace() and the pollable #fd().
+	 *
+	 * Call this before the FIFO is used concurrently.
+	 *
+	 * \return 0 on success, otherwise an \c errno
+	 */
+	int enableWait() noexcept
+	{
+		int res = m_dataEvent.open();
+		if(!res)
+			res = m_spaceEvent.open();
+
+		if(res) {
+			m_dataEvent.close();
+			m_spaceEvent.close();
+			return res;
+		}
+
+		// Make the first message notify a poller.
+		m_dataEvent.arm();
+		return 0;
+	}
+
+	/*!
+	 * \brief File descriptor that is readable when there is data to #recv().
+	 *
+	 * Register it in a stored::Poller as stored::PollableFd with \c PollIn.
+	 * Only valid after #enableWait().
+	 */
+	int fd() const noexcept
+	{
+		return m_dataEvent.fd();
+	}
+
+	/*!
+	 * \brief Wait until the receiving side has popped a message from the FIFO.
+	 *
+	 * Use this from the encoding side, like in the #overflow() handler.
+	 * Only supported after #enableWait().
+	 *
+	 * \return 0 on success, \c EAGAIN on timeout, otherwise an \c errno
+	 */
+	int waitSpace(long timeout_us = -1)
+	{
+		size_t popped = m_popped.load(std::memory_order_relaxed);
+		return m_spaceEvent.wait(
+			[&]() { return m_popped.load(std::memory_order_relaxed) != popped; },
+			timeout_us);
+	}
+#		endif // STORED_OS_POSIX
+
 	/*!
 	 * \copydoc stored::PolledLayer::encode(void const*, size_t, bool)
 	 *
@@ -993,9 +1542,67 @@ public:
 				res = m_fifo.append_back((char const*)buffer, len);
 		} while(!res && overflow());
 
+		if(res && last)
+			pushed();
+
 		base::encode(buffer, len, last);
 	}
 
+	/*!
+	 * \brief Reserve \p len bytes in the FIFO to encode a message in-place.
+	 *
+	 * This avoids copying the message into the FIFO by #encode().  When
+	 * the FIFO is full, #overflow() is invoked, like #encode() does.
+	 *
+	 * \return the buffer to write to, or \c nullptr when there is no space
+	 * \see #commit()
+	 */
+	char* reserve(size_t len)
+	{
+		Message m{nullptr, 0};
+
+		do {
+			m = m_fifo.reserve(len);
+		} while(!m.data() && len && overflow());
+
+		return m_reserved = m.data();
+	}
+
+	/*!
+	 * \brief Encode the first \p len bytes of the previous #reserve().
+	 *
+	 * The data is passed down the stack, like #encode(). When the message
+	 * cannot be pushed, #overflow() is invoked. If that does not resolve
+	 * the situation, the message is dropped.
+	 */
+	void commit(size_t len, bool last = true)
+	{
+		stored_assert(!len || m_reserved);
+
+		// Pass down before committing, as the consumer may decode
+		// (and thereby modify) the message in-place.
+		base::encode(m_reserved, len, last);
+		m_reserved = nullptr;
+
+		bool res = m_fifo.commit(len, last);
+		while(!res && overflow())
+			res = m_fifo.push_back();
+
+		if(!res)
+			m_fifo.reset_back();
+		else if(last)
+			pushed();
+	}
+
+	/*!
+	 * \brief Drop the previous #reserve().
+	 */
+	void abort() noexcept
+	{
+		m_fifo.abort();
+		m_reserved = nullptr;
+	}
+
 	/*!
 	 * \brief Invoke overflow handler.
 	 *
@@ -1075,9 +1682,39 @@ public:
 		return m_fifo.space();
 	}
 
+protected:
+	/*!
+	 * \brief Notify the receiving side about a new message.
+	 */
+	void pushed() noexcept
+	{
+#		ifdef STORED_OS_POSIX
+		m_dataEvent.notify();
+#		endif
+	}
+
+	/*!
+	 * \brief Notify the encoding side about freed space.
+	 */
+	void popped() noexcept
+	{
+#		ifdef STORED_OS_POSIX
+		if(m_spaceEvent.isOpen()) {
+			m_popped.fetch_add(1, std::memory_order_relaxed);
+			m_spaceEvent.notify();
+		}
+#		endif
+	}
+
 private:
 	Fifo_type m_fifo;
+	char* m_reserved = nullptr;
 	Callable<OverflowCallback>::type m_overflowCallback;
+#		ifdef STORED_OS_POSIX
+	FifoEvent m_dataEvent;
+	FifoEvent m_spaceEvent;
+	std::atomic<size_t> m_popped{0};
+#		endif
 };
 
 /*!
@@ -1158,6 +1795,18 @@ public:
 		return m_b2a;
 	}
 
+#		if defined(STORED_OS_POSIX) || defined(DOXYGEN)
+	/*!
+	 * \brief Call FifoLoopback1::enableWait() on both FIFOs.
+	 * \return 0 on success, otherwise an \c errno
+	 */
+	int enableWait() noexcept
+	{
+		int res = m_a2b.enableWait();
+		return res ? res : m_b2a.enableWait();
+	}
+#		endif
+
 private:
 	ProtocolLayer m_a;
 	ProtocolLayer m_b;
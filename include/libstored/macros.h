@@ -343,6 +343,38 @@ typedef SSIZE_T ssize_t;
 #      endif
 #    endif
 #  endif
+
+#  ifndef STORED_CLASS_NOCOPY
+/*!
+ * \def STORED_CLASS_NOCOPY
+ * \brief Emits the copy/move constructor/assignment such that copy is not allowed.
+ *
+ * Move is allowed anyway.
+ *
+ * Put this macro inside the private section of your class.
+ *
+ * \param Class the class this macro is embedded in
+ */
+#    if STORED_cplusplus >= 201103L
+#      define STORED_CLASS_NOCOPY(Class)                      \
+      public:                                                 \
+	      /*! \brief Deleted copy constructor. */         \
+	      Class(Class const&) = delete;                   \
+	      /*! \brief Default move constructor. */         \
+	      Class(Class&&) noexcept = default; /* NOLINT */ \
+	      /*! \brief Deleted assignment operator. */      \
+	      void operator=(Class const&) = delete;          \
+	      /*! \brief Default move assignment operator. */ \
+	      Class& operator=(Class&&) noexcept = default; /* NOLINT */
+#    else
+#      define STORED_CLASS_NOCOPY(Class)                 \
+      private:                                           \
+	      /*! \brief Deleted copy constructor. */    \
+	      Class(Class const&);                       \
+	      /*! \brief Deleted assignment operator. */ \
+	      void operator=(Class const&);
+#    endif
+#  endif
 #endif
 
 #ifndef STORED_thread_local
@@ -9,6 +9,7 @@
 #if defined(__cplusplus) && STORED_cplusplus >= 201402L && defined(STORED_DRAFT_API)
 #	define STORED_HAVE_PIPES
 
+#	include <libstored/fifo.h>
 #	include <libstored/signal.h>
 #	include <libstored/types.h>
 #	include <libstored/util.h>
@@ -28,6 +29,10 @@
 
 #	include <cassert>
 
+#	if !defined(STORED_OS_BAREMETAL) && !defined(STORED_OS_GENERIC)
+#		include <thread>
+#	endif
+
 #	if defined(STORED_COMPILER_CLANG) \
 		&& (__clang_major__ < 9 || (__clang_major__ == 9 && __clang_minor__ < 1))
 // Somehow, the friend operator>> functions for Exit, Cap, and Ref are not friends by
@@ -51,6 +56,12 @@ class SpecificCappedPipe;
 template <typename S>
 class SpecificOpenPipe;
 
+template <typename S>
+class FusedPipe;
+
+template <typename F>
+class VirtualPipe;
+
 /*!
  * \brief Marker for the end of a pipe, which can be connected to another one.
  */
@@ -61,6 +72,11 @@ class Exit {};
  */
 class Cap {};
 
+/*!
+ * \brief Marker for the end of a pipe, that results in a #stored::pipes::FusedPipe.
+ */
+class Fused {};
+
 class Group;
 // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
 extern Group gc;
@@ -93,6 +109,12 @@ namespace impl {
 template <typename T>
 inline17 constexpr bool always_false = false; // NOLINT(misc-definitions-in-headers)
 
+/*!
+ * \brief Number of values that are processed at once, when a batch needs an
+ *	intermediate buffer.
+ */
+inline17 constexpr size_t batch_chunk = 64; // NOLINT(misc-definitions-in-headers)
+
 /*!
  * \brief \c std::declval() without a \c std::remove_reference on the return type.
  */
@@ -142,8 +164,37 @@ protected:
 	{
 		return false;
 	}
+
+	template <typename S_>
+	static constexpr bool has_inject_batch_() noexcept
+	{
+		return false;
+	}
+};
+
+template <typename... T>
+struct make_void {
+	using type = void;
 };
 
+/*!
+ * \brief \c std::void_t for C++14.
+ */
+template <typename... T>
+using void_t = typename make_void<T...>::type;
+
+/*!
+ * \brief Check if the given (non-segment) type has an \c inject_batch() member.
+ *
+ * Used by #stored::pipes::Constrained and #stored::pipes::Convert to forward
+ * batches to their \c Constraints and \c Converter.
+ */
+template <typename T, typename = void>
+struct has_inject_batch : std::false_type {};
+
+template <typename T>
+struct has_inject_batch<T, void_t<decltype(&T::inject_batch)>> : std::true_type {};
+
 } // namespace impl
 
 template <typename S>
@@ -214,6 +265,7 @@ public:
 	STORED_PIPE_TRAITS_HAS_F(S, entry_cast)
 	STORED_PIPE_TRAITS_HAS_F(S, exit_cast)
 	STORED_PIPE_TRAITS_HAS_F(S, trigger)
+	STORED_PIPE_TRAITS_HAS_F(S, inject_batch)
 
 	using type_in = decltype(type_in_helper(&S::inject));
 	static_assert(
@@ -246,6 +298,12 @@ struct segment_traits<Ref> : impl::segment_traits_base {
 	using type_out = void;
 };
 
+template <>
+struct segment_traits<Fused> : impl::segment_traits_base {
+	using type_in = void;
+	using type_out = void;
+};
+
 template <typename S>
 struct segment_traits<Segment<S>> : segment_traits<S> {};
 
@@ -316,6 +374,18 @@ public:
 		return trigger_<S>(triggered);
 	}
 
+	/*!
+	 * \brief Inject \p count values at once.
+	 *
+	 * When \c S does not provide \c inject_batch(), \c inject() is called
+	 * for every value.  \p in and \p out may point to the same array.
+	 */
+	void inject_batch(
+		std::decay_t<type_in> const* in, std::decay_t<type_out>* out, size_t count)
+	{
+		inject_batch_<S>(in, out, count);
+	}
+
 private:
 	template <typename S_>
 	decltype(auto) inject_(decltype(
@@ -404,6 +474,21 @@ private:
 		return static_cast<std::decay_t<type_out>>(x);
 	}
 
+	template <typename S_, std::enable_if_t<traits::template has_inject_batch_<S_>(), int> = 0>
+	void inject_batch_(
+		std::decay_t<type_in> const* in, std::decay_t<type_out>* out, size_t count)
+	{
+		S_::inject_batch(in, out, count);
+	}
+
+	template <typename S_, std::enable_if_t<!traits::template has_inject_batch_<S_>(), int> = 0>
+	void inject_batch_(
+		std::decay_t<type_in> const* in, std::decay_t<type_out>* out, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+			out[i] = inject(in[i]);
+	}
+
 	template <typename S_>
 	decltype(auto)
 	trigger_(decltype(std::enable_if_t<traits::template has_trigger_<S_>(), bool*>{}) triggered)
@@ -539,6 +624,28 @@ public:
 			std::decay_t<typename segment_traits<Last>::type_out>,
 			typename segment_traits<Last>::type_out>;
 
+private:
+	using exit_cast_init = decltype(std::declval<Init const&>().exit_cast(
+		std::declval<type_in>()));
+	using exit_cast_last = decltype(std::declval<Last const&>().exit_cast(
+		std::declval<exit_cast_init>()));
+	using entry_cast_last = decltype(std::declval<Last const&>().entry_cast(
+		std::declval<type_out>()));
+	using entry_cast_init = decltype(std::declval<Init const&>().entry_cast(
+		std::declval<entry_cast_last>()));
+
+public:
+	// Like type_out, only return a reference when all intermediate values
+	// are references. Otherwise, it may refer to a temporary.
+	using exit_cast_type = std::conditional_t<
+		std::is_reference<type_in>::value && std::is_reference<exit_cast_init>::value
+			&& std::is_reference<exit_cast_last>::value,
+		exit_cast_last, std::decay_t<exit_cast_last>>;
+	using entry_cast_type = std::conditional_t<
+		std::is_reference<type_out>::value && std::is_reference<entry_cast_last>::value
+			&& std::is_reference<entry_cast_init>::value,
+		entry_cast_init, std::decay_t<entry_cast_init>>;
+
 protected:
 	template <typename... S_, typename SN_>
 	constexpr explicit Segments(Segments<S_...>&& init, SN_&& last)
@@ -561,14 +668,14 @@ public:
 
 	static constexpr bool has_extract = Init::has_extract || Last::has_extract;
 
-	decltype(auto) exit_cast(type_in x) const
+	exit_cast_type exit_cast(type_in x) const
 	{
 		return Last::exit_cast(Init::exit_cast(x));
 	}
 
 	static constexpr bool has_exit_cast = Init::has_exit_cast || Last::has_exit_cast;
 
-	decltype(auto) entry_cast(type_out x) const
+	entry_cast_type entry_cast(type_out x) const
 	{
 		return Init::entry_cast(Last::entry_cast(x));
 	}
@@ -582,6 +689,22 @@ public:
 
 	static constexpr bool has_trigger = Init::has_trigger || Last::has_trigger;
 
+	/*!
+	 * \brief Inject \p count values at once.
+	 *
+	 * The batch is passed through the segments one segment at a time.
+	 * Therefore, the side effects of different segments are not
+	 * interleaved per value, as they would be by calling inject() for
+	 * every value.
+	 */
+	void inject_batch(
+		std::decay_t<type_in> const* in, std::decay_t<type_out>* out, size_t count)
+	{
+		inject_batch_helper<Init>(in, out, count);
+	}
+
+	static constexpr bool has_inject_batch = Init::has_inject_batch || Last::has_inject_batch;
+
 	template <
 		typename S_,
 		std::enable_if_t<
@@ -598,6 +721,41 @@ public:
 	friend class Segments;
 
 private:
+	template <
+		typename Init_,
+		std::enable_if_t<
+			std::is_same<
+				std::decay_t<typename Init_::type_out>,
+				std::decay_t<type_out>>::value,
+			int> = 0>
+	void inject_batch_helper(
+		std::decay_t<type_in> const* in, std::decay_t<type_out>* out, size_t count)
+	{
+		// Use the output as intermediate buffer.
+		Init_::inject_batch(in, out, count);
+		Last::inject_batch(out, out, count);
+	}
+
+	template <
+		typename Init_,
+		std::enable_if_t<
+			!std::is_same<
+				std::decay_t<typename Init_::type_out>,
+				std::decay_t<type_out>>::value,
+			int> = 0>
+	void inject_batch_helper(
+		std::decay_t<type_in> const* in, std::decay_t<type_out>* out, size_t count)
+	{
+		// Types differ, process in chunks via a buffer on the stack.
+		std::array<std::decay_t<typename Init_::type_out>, impl::batch_chunk> buffer{};
+
+		for(size_t i = 0; i < count; i += impl::batch_chunk) {
+			size_t n = std::min<size_t>(count - i, impl::batch_chunk);
+			Init_::inject_batch(in + i, buffer.data(), n);
+			Last::inject_batch(buffer.data(), out + i, n);
+		}
+	}
+
 	template <typename Last_, std::enable_if_t<Last_::has_extract, int> = 0>
 	decltype(auto) extract_helper()
 	{
@@ -737,6 +895,14 @@ public:
 		justInject(x);
 	}
 
+	/*!
+	 * \brief Inject \p count values at once.
+	 */
+	void inject(type_in const* x, size_t count)
+	{
+		justInjectBatch(x, count);
+	}
+
 	virtual void trigger(bool* triggered = nullptr) = 0;
 
 	void operator()(type_in const& x)
@@ -756,6 +922,12 @@ public:
 
 private:
 	virtual void justInject(type_in const& x) = 0;
+
+	virtual void justInjectBatch(type_in const* x, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+			justInject(x[i]);
+	}
 };
 
 template <typename T>
@@ -779,6 +951,9 @@ protected:
 	template <typename S>
 	friend class SpecificCappedPipe;
 
+	template <typename F>
+	friend class VirtualPipe;
+
 public:
 	ExitValue(ExitValue const&) = delete;
 	void operator=(ExitValue const&) = delete;
@@ -985,8 +1160,19 @@ protected:
 public:
 	virtual ~Pipe() override = default;
 
+	using PipeEntry<In>::inject;
+
 	virtual type_out_wrapper inject(type_in const& x) = 0;
 
+	/*!
+	 * \brief Inject \p count values at once, and write the results to \p out.
+	 *
+	 * Segments that provide \c inject_batch() process the whole batch in a
+	 * tight loop; others are called for every value.  \p in and \p out may
+	 * point to the same array, if the types are the same.
+	 */
+	virtual void inject(type_in const* in, std::decay_t<type_out>* out, size_t count) = 0;
+
 	type_out_wrapper operator()(type_in const& x)
 	{
 		return inject(x);
@@ -1007,6 +1193,16 @@ private:
 	{
 		inject(x);
 	}
+
+	void justInjectBatch(type_in const* x, size_t count) final
+	{
+		std::array<std::decay_t<type_out>, impl::batch_chunk> buffer{};
+
+		for(size_t i = 0; i < count; i += impl::batch_chunk) {
+			size_t n = std::min<size_t>(count - i, impl::batch_chunk);
+			inject(x + i, buffer.data(), n);
+		}
+	}
 };
 
 /*!
@@ -1047,11 +1243,18 @@ protected:
 public:
 	virtual ~SpecificCappedPipe() override = default;
 
+	using Pipe_type::inject;
+
 	virtual type_out_wrapper inject(type_in const& x) override
 	{
 		return type_out_wrapper{segments_type::inject(x)};
 	}
 
+	virtual void inject(type_in const* in, type_out* out, size_t count) override
+	{
+		segments_type::inject_batch(in, out, count);
+	}
+
 	virtual type_out_wrapper extract() override
 	{
 		return type_out_wrapper{segments_type::extract()};
@@ -1129,6 +1332,8 @@ protected:
 public:
 	virtual ~SpecificOpenPipe() override = default;
 
+	using base::inject;
+
 	virtual type_out_wrapper inject(type_in const& x) override
 	{
 		type_out_wrapper y = base::inject(x);
@@ -1136,6 +1341,14 @@ public:
 		return y;
 	}
 
+	virtual void inject(type_in const* in, type_out* out, size_t count) override
+	{
+		base::inject(in, out, count);
+
+		if(m_forward)
+			m_forward->inject(out, count);
+	}
+
 	virtual void connect(PipeEntry<type_out>& p) final
 	{
 		m_forward = &p;
@@ -1191,6 +1404,183 @@ constexpr auto operator>>(Segments<S_...>&& s, Exit&& e)
 	return SpecificOpenPipe<Segments<S_...>>{std::move(s)};
 }
 
+/*!
+ * \brief A pipe without virtual interface.
+ *
+ * All segments are statically dispatched, such that the compiler can inline
+ * the whole pipe. Use it for pipes in a hot path, of which the topology is
+ * known at compile time.  It cannot be connected to other pipes and it is not
+ * a #stored::pipes::PipeBase.  Wrap it in a #stored::pipes::VirtualPipe when
+ * the virtual #stored::pipes::Pipe interface is required anyway.
+ *
+ * Do not instantiate manually, use ... >> Fused{}.
+ */
+template <typename S>
+class STORED_EMPTY_BASES FusedPipe : private S {
+	STORED_CLASS_DEFAULT_COPY_MOVE(FusedPipe)
+public:
+	using segments_type = S;
+	using type_in = std::decay_t<typename segment_traits<segments_type>::type_in>;
+	using type_out = std::decay_t<typename segment_traits<segments_type>::type_out>;
+
+#	ifndef CLANG_BUG_FRIEND_OPERATOR
+protected:
+#	endif
+
+	template <
+		typename S_,
+		std::enable_if_t<std::is_constructible<segments_type, S_>::value, int> = 0>
+	// NOLINTNEXTLINE(bugprone-forwarding-reference-overload)
+	constexpr explicit FusedPipe(S_&& s)
+		: segments_type{std::forward<S_>(s)}
+	{}
+
+	template <typename... S_>
+	friend class Segments;
+
+public:
+	~FusedPipe() = default;
+
+	decltype(auto) inject(type_in const& x)
+	{
+		return segments_type::inject(x);
+	}
+
+	/*!
+	 * \brief Inject \p count values at once, and write the results to \p out.
+	 * \see #stored::pipes::Pipe::inject(type_in const*, std::decay_t<type_out>*, size_t)
+	 */
+	void inject(type_in const* in, type_out* out, size_t count)
+	{
+		segments_type::inject_batch(in, out, count);
+	}
+
+	decltype(auto) operator()(type_in const& x)
+	{
+		return inject(x);
+	}
+
+	friend decltype(auto) operator>>(type_in const& x, FusedPipe& p)
+	{
+		return p.inject(x);
+	}
+
+	friend decltype(auto) operator<<(FusedPipe& p, type_in const& x)
+	{
+		return p.inject(x);
+	}
+
+	decltype(auto) extract()
+	{
+		return segments_type::extract();
+	}
+
+	friend auto& operator>>(FusedPipe& p, type_out& x)
+	{
+		return x = p.extract();
+	}
+
+	friend auto& operator<<(type_out& x, FusedPipe& p)
+	{
+		return x = p.extract();
+	}
+
+	type_in entry_cast(type_out const& x) const
+	{
+		return segments_type::entry_cast(x);
+	}
+
+	type_out exit_cast(type_in const& x) const
+	{
+		return segments_type::exit_cast(x);
+	}
+
+	decltype(auto) trigger(bool* triggered = nullptr)
+	{
+		return segments_type::trigger(triggered);
+	}
+
+	template <typename... S_>
+	friend constexpr auto operator>>(Segments<S_...>&& s, Fused&& e);
+};
+
+template <typename... S_>
+constexpr auto operator>>(Segments<S_...>&& s, Fused&& e)
+{
+	STORED_UNUSED(e)
+	return FusedPipe<Segments<S_...>>{std::move(s)};
+}
+
+/*!
+ * \brief #stored::pipes::Pipe interface on top of a #stored::pipes::FusedPipe.
+ *
+ * The VirtualPipe refers to the given pipe, which must outlive it.  Use it to
+ * connect a fused pipe to another (open) pipe, or to pass it to code that
+ * only knows the virtual interface.  Calls to the fused pipe itself remain
+ * statically dispatched.
+ *
+ * \code
+ * auto f = Entry<int>{} >> Buffer<int>{} >> Fused{};
+ * VirtualPipe<decltype(f)> v{f};
+ * auto p = Entry<int>{} >> Exit{};
+ * p >> v;
+ * \endcode
+ */
+template <typename F>
+class VirtualPipe final : public Pipe<typename F::type_in, typename F::type_out> {
+	STORED_CLASS_DEFAULT_COPY_MOVE(VirtualPipe)
+public:
+	using fused_type = F;
+	using type_in = typename fused_type::type_in;
+	using type_out = typename fused_type::type_out;
+	using type_out_wrapper = ExitValue<type_out>;
+	using Pipe_type = Pipe<type_in, type_out>;
+
+	explicit VirtualPipe(fused_type& f) noexcept
+		: m_f{&f}
+	{}
+
+	virtual ~VirtualPipe() override = default;
+
+	fused_type& fused() const noexcept
+	{
+		return *m_f;
+	}
+
+	using Pipe_type::inject;
+
+	virtual type_out_wrapper inject(type_in const& x) override
+	{
+		return type_out_wrapper{m_f->inject(x)};
+	}
+
+	virtual void inject(type_in const* in, type_out* out, size_t count) override
+	{
+		m_f->inject(in, out, count);
+	}
+
+	virtual type_out_wrapper extract() override
+	{
+		return type_out_wrapper{m_f->extract()};
+	}
+
+	using Pipe_type::operator();
+	using Pipe_type::operator>>;
+
+	virtual void trigger(bool* triggered = nullptr) override
+	{
+		m_f->trigger(triggered);
+	}
+
+	virtual void trigger(bool* triggered, type_out& out) override
+	{
+		out = m_f->trigger(triggered);
+	}
+
+private:
+	fused_type* m_f;
+};
+
 
 
 //////////////////////////////////
@@ -1207,6 +1597,12 @@ public:
 	{
 		return x;
 	}
+
+	void inject_batch(T const* in, T* out, size_t count)
+	{
+		if(in != out)
+			std::copy(in, in + count, out);
+	}
 };
 
 template <typename T>
@@ -1230,6 +1626,13 @@ auto& operator>>(Entry<T>&& entry, Ref&& ref)
 	return std::move(entry) >> Identity<T>{} >> std::move(ref);
 }
 
+template <typename T>
+auto operator>>(Entry<T>&& entry, Fused&& fused)
+{
+	// NOLINTNEXTLINE(hicpp-move-const-arg,performance-move-const-arg)
+	return std::move(entry) >> Identity<T>{} >> std::move(fused);
+}
+
 namespace impl {
 
 template <
@@ -1247,6 +1650,12 @@ public:
 		return exit_cast(x);
 	}
 
+	void inject_batch(In const* in, Out* out, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+			out[i] = saturated_cast<Out>(in[i]);
+	}
+
 	Out exit_cast(In x) const
 	{
 		return saturated_cast<Out>(x);
@@ -1267,6 +1676,12 @@ public:
 		return exit_cast(x);
 	}
 
+	void inject_batch(In const* in, Out* out, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+			out[i] = static_cast<Out>(in[i]);
+	}
+
 	Out exit_cast(In const& x) const
 	{
 		return static_cast<Out>(x);
@@ -2094,6 +2509,18 @@ public:
 		return std::max(m_low, std::min(m_high, x));
 	}
 
+	/*!
+	 * \brief Apply the bounds to \p count values at once.
+	 */
+	void inject_batch(type const* in, type* out, size_t count) const
+	{
+		type low = m_low;
+		type high = m_high;
+
+		for(size_t i = 0; i < count; i++)
+			out[i] = std::max(low, std::min(high, in[i]));
+	}
+
 private:
 	type m_low;
 	type m_high;
@@ -2133,6 +2560,10 @@ struct constraints_type<T (C::*)(T) const noexcept> {
  * and its result is passed further on through the pipe.  The \c
  * Constraints::operator() is assumed to be stateless.
  *
+ * When \c Constraints has an <tt>inject_batch(type const*, type*, size_t)
+ * const</tt>, it is used for batches.  Otherwise, \c operator() is called for
+ * every value.
+ *
  * \see #stored::pipes::Bounded
  */
 template <typename Constraints>
@@ -2161,11 +2592,34 @@ public:
 		return exit_cast(std::move(x));
 	}
 
+	void inject_batch(type const* in, type* out, size_t count)
+	{
+		inject_batch_<Constraints>(in, out, count);
+	}
+
 	type exit_cast(type x) const
 	{
 		return m_constraints(std::move(x));
 	}
 
+private:
+	template <
+		typename Constraints_,
+		std::enable_if_t<impl::has_inject_batch<Constraints_>::value, int> = 0>
+	void inject_batch_(type const* in, type* out, size_t count) const
+	{
+		m_constraints.inject_batch(in, out, count);
+	}
+
+	template <
+		typename Constraints_,
+		std::enable_if_t<!impl::has_inject_batch<Constraints_>::value, int> = 0>
+	void inject_batch_(type const* in, type* out, size_t count) const
+	{
+		for(size_t i = 0; i < count; i++)
+			out[i] = m_constraints(in[i]);
+	}
+
 private:
 	Constraints m_constraints;
 };
@@ -2201,6 +2655,18 @@ public:
 		constexpr type f = (type)r.den / (type)r.num;
 		return value * f;
 	}
+
+	/*!
+	 * \brief Batch version of exit_cast().
+	 */
+	void inject_batch(type const* in, type* out, size_t count) const noexcept
+	{
+		constexpr ratio r{};
+		constexpr type f = (type)r.num / (type)r.den;
+
+		for(size_t i = 0; i < count; i++)
+			out[i] = in[i] * f;
+	}
 };
 
 /*!
@@ -2211,12 +2677,17 @@ public:
  * entry_cast() of the \c Converter instance is used.  Both methods of the
  * Converter are assumed to be stateless.
  *
+ * Batches are passed to the \c inject_batch() of the \c Converter, if it has
+ * one.  Otherwise, \c exit_cast() is called for every value.
+ *
  * \see #stored::pipes::Scale
  */
 template <typename Converter>
 class Convert {
 public:
 	using type = typename impl::constraints_type<decltype(&Converter::exit_cast)>::type;
+	using exit_type = std::decay_t<decltype(std::declval<Converter const&>().exit_cast(
+		std::declval<type const&>()))>;
 
 	template <
 		typename Converter_,
@@ -2248,6 +2719,29 @@ public:
 		return m_converter.entry_cast(x);
 	}
 
+	void inject_batch(type const* in, exit_type* out, size_t count)
+	{
+		inject_batch_<Converter>(in, out, count);
+	}
+
+private:
+	template <
+		typename Converter_,
+		std::enable_if_t<impl::has_inject_batch<Converter_>::value, int> = 0>
+	void inject_batch_(type const* in, exit_type* out, size_t count) const
+	{
+		m_converter.inject_batch(in, out, count);
+	}
+
+	template <
+		typename Converter_,
+		std::enable_if_t<!impl::has_inject_batch<Converter_>::value, int> = 0>
+	void inject_batch_(type const* in, exit_type* out, size_t count) const
+	{
+		for(size_t i = 0; i < count; i++)
+			out[i] = m_converter.exit_cast(in[i]);
+	}
+
 private:
 	Converter m_converter;
 };
@@ -2757,6 +3251,362 @@ template <typename T, typename Key, typename Token>
 Signal(stored::Signal<Key, Token, T>&, Key) -> Signal<T, Key, Token>;
 #	endif // C++17
 
+/*!
+ * \brief Bounded queue that decouples a pipe into a producer and consumer context.
+ *
+ * The #stored::pipes::Async segment pushes values into a lock-free
+ * single-producer single-consumer stored::Fifo.  The consumer calls #recv()
+ * or #recvAll(), which injects the queued values into the downstream pipe.
+ * This way, expensive work like logging or formatting does not run in the
+ * (real-time) context of the producer.
+ *
+ * For example:
+ *
+ * \code
+ * auto log = Entry<int>{} >> Log<int>{"value"} >> Cap{};
+ * AsyncQueue<int, 64> queue{log};
+ * auto p = Entry<int>{} >> Async{queue} >> Buffer<int>{} >> Cap{};
+ *
+ * // Producer
+ * 1 >> p;
+ *
+ * // Consumer, another thread
+ * queue.recv(-1);
+ * \endcode
+ *
+ * When the FIFO is full, the overflow policy determines whether new values
+ * are dropped (#OverflowDrop) or the producer waits for space
+ * (#OverflowBlock).
+ *
+ * On POSIX, after #enableWait(), #recv() can block, and #fd() can be
+ * registered in a stored::Poller (as stored::PollableFd with \c PollIn).  In
+ * that case, call #recvAll() when the poller reports the \c fd to be
+ * readable.
+ */
+template <typename T, size_t Capacity>
+class AsyncQueue {
+	STORED_CLASS_NOCOPY(AsyncQueue)
+public:
+	static_assert(Capacity > 0, "Only bounded queues are supported");
+
+	using type = T;
+	using Fifo_type = Fifo<type, Capacity, true>;
+
+	enum Overflow {
+		/*! \brief Drop values that do not fit in the FIFO. */
+		OverflowDrop,
+		/*!
+		 * \brief Let the producer wait until the consumer made space.
+		 * \details Without threads, values are dropped instead.
+		 */
+		OverflowBlock,
+	};
+
+	explicit AsyncQueue(PipeEntry<type>& p, Overflow overflow = OverflowDrop)
+		: m_p{&p}
+		, m_overflow{overflow}
+	{}
+
+	~AsyncQueue() = default;
+
+	/*!
+	 * \brief Push a value into the FIFO.
+	 *
+	 * Call this from the producer only.
+	 *
+	 * \return \c true when pushed, \c false when dropped
+	 */
+	bool push(type const& x)
+	{
+		while(m_fifo.full())
+			if(!overflow()) {
+				m_dropped.fetch_add(1U, std::memory_order_relaxed);
+				return false;
+			}
+
+		m_fifo.push_back(x);
+		pushed();
+		return true;
+	}
+
+	/*!
+	 * \brief Push \p count values into the FIFO.
+	 *
+	 * Call this from the producer only.
+	 *
+	 * \return the number of pushed values, the rest is dropped
+	 */
+	size_t push(type const* x, size_t count)
+	{
+		size_t done = 0;
+
+		while(done < count) {
+			size_t n = std::min(count - done, m_fifo.space());
+
+			if(n) {
+				m_fifo.push_back(x + done, n);
+				done += n;
+				pushed();
+			} else if(!overflow()) {
+				m_dropped.fetch_add(count - done, std::memory_order_relaxed);
+				break;
+			}
+		}
+
+		return done;
+	}
+
+	/*!
+	 * \brief Inject all queued values into the downstream pipe.
+	 *
+	 * Call this from the consumer only.  The values are injected as a
+	 * batch, see stored::pipes::PipeEntry::inject(type_in const*, size_t).
+	 *
+	 * \return the number of injected values
+	 */
+	size_t recvAll()
+	{
+		size_t count = 0;
+
+		do {
+			auto s = m_fifo.spans();
+			size_t n = s.first.size + s.second.size;
+
+			if(s.first.size)
+				m_p->inject(s.first.data, s.first.size);
+			if(s.second.size)
+				m_p->inject(s.second.data, s.second.size);
+
+			if(n) {
+				m_fifo.pop_front(n);
+				popped();
+				count += n;
+			}
+		}
+#	ifdef STORED_OS_POSIX
+		// Make sure that the event is armed for the next poll.
+		while(m_dataEvent.isOpen()
+		      && m_dataEvent.wait([this]() { return !m_fifo.empty(); }, 0) == 0);
+#	else
+		while(false);
+#	endif
+
+		return count;
+	}
+
+	/*!
+	 * \brief Inject all queued values into the downstream pipe, if any.
+	 *
+	 * Unless #enableWait() was called, \p timeout_us must be 0, as
+	 * blocking is not supported then.
+	 *
+	 * \return 0 on success, \c EAGAIN when there was nothing to inject
+	 *         within the given timeout, otherwise an \c errno
+	 */
+	int recv(long timeout_us = 0)
+	{
+		if(m_fifo.empty()) {
+#	ifdef STORED_OS_POSIX
+			if(m_dataEvent.isOpen()) {
+				int res = m_dataEvent.wait(
+					[this]() { return !m_fifo.empty(); }, timeout_us);
+				if(res)
+					return res;
+			} else
+#	endif
+			{
+				STORED_UNUSED(timeout_us)
+				stored_assert(timeout_us == 0);
+				return EAGAIN;
+			}
+		}
+
+		recvAll();
+		return 0;
+	}
+
+#	if defined(STORED_OS_POSIX) || defined(DOXYGEN)
+	/*!
+	 * \brief Enable blocking #recv(), #OverflowBlock without spinning, and the pollable #fd().
+	 *
+	 * Call this before the queue is used concurrently.
+	 *
+	 * \return 0 on success, otherwise an \c errno
+	 */
+	int enableWait() noexcept
+	{
+		int res = m_dataEvent.open();
+		if(!res)
+			res = m_spaceEvent.open();
+
+		if(res) {
+			m_dataEvent.close();
+			m_spaceEvent.close();
+			return res;
+		}
+
+		// Make the first value notify a poller.
+		m_dataEvent.arm();
+		return 0;
+	}
+
+	/*!
+	 * \brief File descriptor that is readable when there is data to #recv().
+	 *
+	 * Only valid after #enableWait().
+	 */
+	int fd() const noexcept
+	{
+		return m_dataEvent.fd();
+	}
+#	endif // STORED_OS_POSIX
+
+	Overflow overflowPolicy() const noexcept
+	{
+		return m_overflow;
+	}
+
+	/*!
+	 * \brief Change the overflow policy.
+	 *
+	 * Only call this from the producer.
+	 */
+	void setOverflowPolicy(Overflow overflow) noexcept
+	{
+		m_overflow = overflow;
+	}
+
+	/*!
+	 * \brief Number of values that were dropped because of overflow.
+	 */
+	size_t dropped() const noexcept
+	{
+		return m_dropped.load(std::memory_order_relaxed);
+	}
+
+	bool empty() const noexcept
+	{
+		return m_fifo.empty();
+	}
+
+	size_t available() const noexcept
+	{
+		return m_fifo.available();
+	}
+
+	bool full() const noexcept
+	{
+		return m_fifo.full();
+	}
+
+	size_t space() const noexcept
+	{
+		return m_fifo.space();
+	}
+
+protected:
+	/*!
+	 * \brief Handle a full FIFO at the producer side.
+	 *
+	 * Without #enableWait(), #OverflowBlock yields the processor while
+	 * waiting.  Without threads, like on bare metal, the consumer cannot
+	 * make space while the producer waits, so the value is dropped then.
+	 *
+	 * \return \c true when the push is to be retried, \c false to drop
+	 */
+	bool overflow()
+	{
+		switch(m_overflow) {
+		case OverflowBlock:
+#	ifdef STORED_OS_POSIX
+			if(m_spaceEvent.isOpen()) {
+				m_spaceEvent.wait([this]() { return !m_fifo.full(); });
+				return true;
+			}
+#	endif
+#	if !defined(STORED_OS_BAREMETAL) && !defined(STORED_OS_GENERIC)
+			std::this_thread::yield();
+			return true;
+#	else
+			return false;
+#	endif
+		case OverflowDrop:
+		default:
+			return false;
+		}
+	}
+
+	/*!
+	 * \brief Notify the consumer about new data.
+	 */
+	void pushed() noexcept
+	{
+#	ifdef STORED_OS_POSIX
+		m_dataEvent.notify();
+#	endif
+	}
+
+	/*!
+	 * \brief Notify the producer about freed space.
+	 */
+	void popped() noexcept
+	{
+#	ifdef STORED_OS_POSIX
+		m_spaceEvent.notify();
+#	endif
+	}
+
+private:
+	Fifo_type m_fifo;
+	PipeEntry<type>* m_p = nullptr;
+	Overflow m_overflow = OverflowDrop;
+	std::atomic<size_t> m_dropped{0};
+#	ifdef STORED_OS_POSIX
+	FifoEvent m_dataEvent;
+	FifoEvent m_spaceEvent;
+#	endif
+};
+
+/*!
+ * \brief Pass injected values to a #stored::pipes::AsyncQueue.
+ *
+ * The values are also passed further on through the pipe, in the context of
+ * the producer.  The downstream pipe of the queue processes them in the
+ * context of the consumer.
+ */
+template <typename T, size_t Capacity>
+class Async {
+public:
+	using type = T;
+	using AsyncQueue_type = AsyncQueue<type, Capacity>;
+
+	explicit Async(AsyncQueue_type& queue)
+		: m_queue{&queue}
+	{}
+
+	type const& inject(type const& x)
+	{
+		m_queue->push(x);
+		return x;
+	}
+
+	void inject_batch(type const* in, type* out, size_t count)
+	{
+		m_queue->push(in, count);
+
+		if(in != out)
+			std::copy(in, in + count, out);
+	}
+
+private:
+	AsyncQueue_type* m_queue{};
+};
+
+#	if STORED_cplusplus >= 201703L
+template <typename T, size_t Capacity>
+Async(AsyncQueue<T, Capacity>&) -> Async<T, Capacity>;
+#	endif // C++17
+
 } // namespace pipes
 } // namespace stored
 
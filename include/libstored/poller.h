@@ -20,7 +20,9 @@
 #  include <vector>
 
 #  if STORED_cplusplus >= 201103L
+#    include <atomic>
 #    include <initializer_list>
+#    include <type_traits>
 #    include <utility>
 #  endif
 
@@ -42,7 +44,8 @@
 #  if !defined(STORED_POLL_ZTH_WFMO) && !defined(STORED_POLL_WFMO)        \
 	  && !defined(STORED_POLL_ZTH_ZMQ) && !defined(STORED_POLL_ZMQ)   \
 	  && !defined(STORED_POLL_ZTH_POLL) && !defined(STORED_POLL_POLL) \
-	  && !defined(STORED_POLL_ZTH_LOOP) && !defined(STORED_POLL_LOOP)
+	  && !defined(STORED_POLL_ZTH_LOOP) && !defined(STORED_POLL_LOOP) \
+	  && !defined(STORED_POLL_EPOLL) && !defined(STORED_POLL_IO_URING)
 // Do auto-detect
 
 #    ifdef STORED_OS_WINDOWS
@@ -81,9 +84,26 @@
 #  if defined(STORED_POLL_POLL) || defined(STORED_POLL_ZTH_POLL)
 #    include <poll.h>
 #  endif
+#  ifdef STORED_OS_LINUX
+#    include <sys/epoll.h>
+#  endif
+#  if defined(STORED_POLL_EPOLL) && (!defined(STORED_OS_LINUX) || defined(STORED_HAVE_ZTH))
+#    error STORED_POLL_EPOLL is only supported on Linux without Zth.
+#  endif
+#  if defined(STORED_POLL_IO_URING) && (!defined(STORED_OS_LINUX) || defined(STORED_HAVE_ZTH))
+#    error STORED_POLL_IO_URING is only supported on Linux without Zth.
+#  endif
 #  ifdef STORED_HAVE_ZMQ
 #    include <zmq.h>
 #  endif
+#  if STORED_cplusplus >= 201103L && defined(STORED_OS_POSIX) && !defined(STORED_HAVE_ZTH)
+#    include <libstored/fifo.h>
+#    include <algorithm>
+#    include <condition_variable>
+#    include <limits>
+#    include <mutex>
+#    include <thread>
+#  endif
 
 #  if !defined(STORED_HAVE_ZTH) && STORED_VERSION_NUM < 20000 && !defined(DOXYGEN)
 #    define STORED_POLL_OLD
@@ -376,6 +396,85 @@ pollable(PolledFileLayer& l, Pollable::Events const& events, void* user = nullpt
 	return PollableFileLayer(l, events, user);
 }
 
+/*!
+ * \brief A timer, which is ready (\c PollIn) when it expired.
+ *
+ * The timer is either one-shot or periodic.  When the poller returns the
+ * timer, call #expirations() to acknowledge it.  Expirations that were
+ * missed, because the application was too late, are coalesced into one
+ * event; #expirations() returns how many there were.
+ *
+ * Periodic timers can be aligned to a multiple of their interval.  Then,
+ * all aligned timers with the same (or a multiple of the) interval expire
+ * at the same moment, and the application only wakes up once for all of
+ * them.
+ *
+ * On Linux, a \c timerfd is used, which can be polled by all pollers.
+ * Otherwise, the deadline is checked by poll_once(), so only the
+ * stored::LoopPoller supports it.
+ *
+ * \code
+ * stored::PollableTimer timer;
+ * timer.start(100000); // 100 ms, periodic
+ * stored::Poller poller = {timer};
+ *
+ * while(true)
+ *     for(auto* p : poller.poll())
+ *         if(p == &timer && timer.expirations())
+ *             synchronizer.process();
+ * \endcode
+ */
+class PollableTimer final : public TypedPollable {
+	STORED_POLLABLE_TYPE(PollableTimer)
+	STORED_CLASS_NOCOPY(PollableTimer)
+public:
+	explicit PollableTimer(void* user = nullptr) noexcept;
+	virtual ~PollableTimer() override;
+
+	/*!
+	 * \brief (Re)start the timer.
+	 *
+	 * \param interval_us the time until the (first) expiration
+	 * \param periodic when \c false, the timer expires only once
+	 * \param aligned align the expirations to a multiple of \p interval_us
+	 * \return 0 on success, otherwise an errno
+	 */
+	int start(long interval_us, bool periodic = true, bool aligned = false) noexcept;
+
+	/*!
+	 * \brief Stop the timer.
+	 */
+	void stop() noexcept;
+
+	bool running() const noexcept
+	{
+		return m_deadline_us != 0;
+	}
+
+	/*!
+	 * \brief Check if the deadline has passed, without acknowledging it.
+	 */
+	bool expired() const noexcept;
+
+	/*!
+	 * \brief Acknowledge and return the number of expirations since the previous call.
+	 */
+	unsigned long expirations() noexcept;
+
+	/*!
+	 * \brief The pollable \c timerfd, or -1 when not supported.
+	 */
+	int fd() const noexcept
+	{
+		return m_fd;
+	}
+
+private:
+	int m_fd;
+	uint64_t m_deadline_us;
+	uint64_t m_interval_us;
+};
+
 #  if defined(STORED_OS_WINDOWS) || defined(DOXYGEN)
 /*!
  * \brief Poll a Windows SOCKET.
@@ -491,6 +590,23 @@ protected:
 		STORED_UNUSED(p)
 		STORED_UNUSED(item)
 	}
+
+	/*!
+	 * \brief Notify that \p item is (now) at \p index in the item list.
+	 *
+	 * This is called after an item was added, and when it was moved
+	 * because another item was removed.
+	 *
+	 * \return 0 on success, otherwise an errno, which aborts the addition
+	 */
+	virtual int reindex(Pollable const& p, PollItem& item, size_t index) noexcept
+	{
+		STORED_UNUSED(p)
+		STORED_UNUSED(item)
+		STORED_UNUSED(index)
+		return 0;
+	}
+
 	virtual int doPoll(int timeout_ms, PollItemList& items) noexcept = 0;
 };
 #  endif // !STORED_HAVE_ZTH
@@ -671,6 +787,213 @@ typedef PollPoller PollerServer;
 
 
 
+//////////////////////////////////////////////
+// Polling using epoll()
+//
+// stored::PollerBase
+//	^
+//	|
+// stored::EpollPoller
+// = stored::PollerImpl
+//	^
+//	|
+// stored::Poller
+
+#  if (defined(STORED_OS_LINUX) && !defined(STORED_HAVE_ZTH)) || defined(DOXYGEN)
+struct EpollPollerItem {
+	int fd;
+	unsigned int events;
+	bool registered;
+};
+
+/*!
+ * \brief Poller using Linux' \c epoll.
+ *
+ * Pollables are registered once in the kernel when they are added, and
+ * a poll only visits the pollables that are ready.  So, the overhead of
+ * a poll does not depend on the number of (idle) pollables.
+ *
+ * Only stored::PollableFd and stored::PollableFileLayer are supported.  A
+ * file descriptor can only be added once to the same poller.
+ *
+ * The \c revents of pollables that are not ready are not updated by a poll.
+ *
+ * Select this poller for stored::Poller by defining \c STORED_POLL_EPOLL,
+ * or use it explicitly as \c stored::CustomPoller<stored::EpollPoller>.
+ */
+class EpollPoller : public PollerBase<EpollPollerItem> {
+	STORED_CLASS_NOCOPY(EpollPoller)
+	STORED_CLASS_NEW_DELETE(EpollPoller)
+public:
+	virtual ~EpollPoller() override;
+
+	/*!
+	 * \brief Use edge-triggered notification for pollables that are added from now on.
+	 *
+	 * When edge-triggered, a pollable is only returned once when it
+	 * becomes ready.  The application must then read or write until the
+	 * file descriptor returns \c EAGAIN, before it is returned again.
+	 * By default, notifications are level-triggered, like other pollers.
+	 */
+	void setEdgeTriggered(bool enable = true) noexcept
+	{
+		m_edgeTriggered = enable;
+	}
+
+	bool edgeTriggered() const noexcept
+	{
+		return m_edgeTriggered;
+	}
+
+protected:
+	EpollPoller()
+		: m_fd(-1)
+		, m_edgeTriggered()
+	{}
+
+	virtual int init(Pollable const& p, EpollPollerItem& item) noexcept final;
+	virtual void deinit(Pollable const& p, EpollPollerItem& item) noexcept final;
+	virtual int reindex(Pollable const& p, EpollPollerItem& item, size_t index) noexcept final;
+	virtual int doPoll(int timeout_ms, PollItemList& items) noexcept final;
+
+private:
+	int m_fd;
+	bool m_edgeTriggered;
+	Vector<struct epoll_event>::type m_events;
+};
+
+#    ifdef STORED_POLL_EPOLL
+typedef EpollPoller PollerImpl;
+#    endif
+#  endif // STORED_OS_LINUX && !STORED_HAVE_ZTH
+
+
+
+//////////////////////////////////////////////
+// Polling using io_uring
+//
+// stored::PollerBase
+//	^
+//	|
+// stored::IoUringPoller
+// = stored::PollerImpl
+//	^
+//	|
+// stored::Poller
+
+#  if (defined(STORED_OS_LINUX) && !defined(STORED_HAVE_ZTH)) || defined(DOXYGEN)
+struct IoUringPollerItem {
+	int fd;
+	/*! \brief The \c poll() events to wait for. */
+	unsigned int events;
+	/*! \brief The \c user_data of the current poll request, 0 when none. */
+	uint64_t user_data;
+	/*! \brief Set when the poll request is in the kernel. */
+	bool armed;
+	bool multishot;
+};
+
+namespace impl {
+struct IoUring;
+} // namespace impl
+
+/*!
+ * \brief Poller using Linux' io_uring.
+ *
+ * Every pollable has a poll request in the kernel.  Completions of
+ * these requests are collected, and new requests are submitted, in
+ * the same system call that waits for the next completion.  Like
+ * stored::EpollPoller, a poll only visits the pollables that are ready.
+ *
+ * By default, a request is resubmitted after its completion has been
+ * processed, which gives the level-triggered behavior of other pollers.
+ * With #setMultishot(), a request keeps delivering completions, which
+ * saves the resubmissions, but it only reports new events, similar to
+ * stored::EpollPoller::setEdgeTriggered().
+ *
+ * When io_uring is not available, for example when the kernel is too old
+ * or io_uring is disabled, \c poll() is used instead.  Check #fallback() to
+ * see which one is active.
+ *
+ * Only stored::PollableFd, stored::PollableFileLayer and
+ * stored::PollableTimer are supported.  The \c revents of pollables that
+ * are not ready are not updated by a poll.
+ *
+ * Select this poller for stored::Poller by defining \c STORED_POLL_IO_URING,
+ * or use it explicitly as \c stored::CustomPoller<stored::IoUringPoller>.
+ */
+class IoUringPoller : public PollerBase<IoUringPollerItem> {
+	STORED_CLASS_NOCOPY(IoUringPoller)
+	STORED_CLASS_NEW_DELETE(IoUringPoller)
+public:
+	virtual ~IoUringPoller() override;
+
+	/*!
+	 * \brief Use multishot poll requests for pollables that are added from now on.
+	 */
+	void setMultishot(bool enable = true) noexcept
+	{
+		m_multishot = enable;
+	}
+
+	bool multishot() const noexcept
+	{
+		return m_multishot;
+	}
+
+	/*!
+	 * \brief Checks if \c poll() is used, as io_uring is not available.
+	 *
+	 * This is determined when the first pollable is added.
+	 */
+	bool fallback() const noexcept
+	{
+		return m_fallback;
+	}
+
+protected:
+	IoUringPoller()
+		: m_ring()
+		, m_fallback()
+		, m_multishot()
+		, m_generation()
+	{}
+
+	virtual int init(Pollable const& p, IoUringPollerItem& item) noexcept final;
+	virtual void deinit(Pollable const& p, IoUringPollerItem& item) noexcept final;
+	virtual int reindex(Pollable const& p, IoUringPollerItem& item, size_t index) noexcept final;
+	virtual int doPoll(int timeout_ms, PollItemList& items) noexcept final;
+
+private:
+	int setup() noexcept;
+	int submitPoll(IoUringPollerItem& item) noexcept;
+	int submitRemove(uint64_t user_data) noexcept;
+	void reap(PollItemList& items) noexcept;
+	int doFallbackPoll(int timeout_ms, PollItemList& items) noexcept;
+
+private:
+	impl::IoUring* m_ring;
+	bool m_fallback;
+	bool m_multishot;
+	/*! \brief Generation counter, to recognize completions of old requests. */
+	uint32_t m_generation;
+	/*! \brief Requests to be resubmitted before waiting. */
+	Vector<uint64_t>::type m_resubmit;
+	/*! \brief Indices of pollables with completions in the current poll. */
+	Vector<size_t>::type m_ready;
+	/*! \brief Collected events per pollable, indexed like the items. */
+	Vector<Pollable::Events_value>::type m_revents;
+	/*! \brief The items for the \c poll() fallback. */
+	Vector<struct pollfd>::type m_pollfds;
+};
+
+#    ifdef STORED_POLL_IO_URING
+typedef IoUringPoller PollerImpl;
+#    endif
+#  endif // STORED_OS_LINUX && !STORED_HAVE_ZTH
+
+
+
 //////////////////////////////////////////////
 // Polling using poll_once()
 //
@@ -809,7 +1132,11 @@ public:
 	}
 
 protected:
-	InheritablePoller() is_default
+	InheritablePoller() noexcept
+		: m_dispatch()
+		, m_dispatchArg()
+		, m_dispatched()
+	{}
 
 	void throwing(int res)
 	{
@@ -841,6 +1168,12 @@ public:
 	 */
 	virtual int add(Pollable& p) noexcept
 	{
+		if(m_dispatch)
+			// Called from within runOnce().
+			return EBUSY;
+
+		AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryPoller);
+
 		try {
 			reserve(1);
 		} catch(std::bad_alloc const&) {
@@ -873,6 +1206,14 @@ public:
 			return EINVAL;
 		}
 
+		res = this->reindex(p, m_items.back(), m_items.size() - 1U);
+		if(res) {
+			this->deinit(p, m_items.back());
+			m_items.pop_back();
+			m_pollables.pop_back();
+			return res;
+		}
+
 		return 0;
 	}
 
@@ -914,6 +1255,10 @@ public:
 	 */
 	virtual int remove(Pollable& p) noexcept
 	{
+		if(m_dispatch)
+			// Called from within runOnce().
+			return EBUSY;
+
 		for(size_t i = 0; i < m_pollables.size(); i++)
 			if(m_pollables[i] == &p) {
 				this->deinit(p, m_items[i]);
@@ -925,6 +1270,14 @@ public:
 				m_items.pop_back();
 				m_pollables[i] = m_pollables.back();
 				m_pollables.pop_back();
+
+				if(i < m_items.size()) {
+					// The last item moved to i.
+					int res = this->reindex(*m_pollables[i], m_items[i], i);
+					STORED_UNUSED(res)
+					stored_assert(res == 0);
+				}
+
 				return 0;
 			}
 
@@ -938,6 +1291,8 @@ public:
 	 */
 	virtual void reserve(size_t more)
 	{
+		AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryPoller);
+
 		size_t capacity = m_pollables.size() + more;
 		m_pollables.reserve(capacity);
 		m_items.reserve(capacity);
@@ -954,6 +1309,8 @@ public:
 
 	virtual void clear() noexcept
 	{
+		stored_assert(!m_dispatch);
+
 		for(size_t i = 0; i < m_items.size(); i++)
 			this->deinit(*m_pollables[i], m_items[i]);
 
@@ -964,8 +1321,11 @@ public:
 	virtual Result const& poll(int timeout_ms = -1) noexcept
 	{
 		stored_assert(m_pollables.size() == m_items.size());
+		stored_assert(!m_dispatch);
 		m_result.clear();
 
+		AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryPoller);
+
 		errno = this->doPoll(timeout_ms, m_items);
 		if(errno)
 			m_result.clear();
@@ -976,12 +1336,127 @@ public:
 		return m_result;
 	}
 
+#    if STORED_cplusplus >= 201103L
+	/*!
+	 * \brief Wait for events and dispatch them to the given callback.
+	 *
+	 * Unlike #poll(), no result list is built. \p f is called as \c
+	 * f(Pollable&) for every pollable with events, straight from the
+	 * ready set of the poll implementation. The \c revents of the
+	 * pollable is set before \p f is called.
+	 *
+	 * \p f must not throw. It must not add or remove pollables either;
+	 * #add() and #remove() return \c EBUSY while dispatching.
+	 *
+	 * \return 0 when events were dispatched, \c EAGAIN on timeout,
+	 *	otherwise an errno
+	 */
+	template <typename F>
+	int runOnce(F&& f, int timeout_ms = -1) noexcept
+	{
+		stored_assert(m_pollables.size() == m_items.size());
+		stored_assert(!m_dispatch);
+
+		m_dispatch = &dispatch<typename std::remove_reference<F>::type>;
+		m_dispatchArg = &f;
+		m_dispatched = false;
+
+		int res = this->doPoll(timeout_ms, m_items);
+
+		m_dispatch = nullptr;
+		m_dispatchArg = nullptr;
+
+		if(!res && !m_dispatched)
+			res = EAGAIN;
+
+		return res;
+	}
+
+	/*!
+	 * \brief Dispatch events to the given callback, until #stop() is called.
+	 *
+	 * This calls #runOnce() repeatedly, without timeout.  When #stop() was
+	 * called before, this function returns immediately.
+	 *
+	 * \return 0 when stopped, otherwise an errno
+	 */
+	template <typename F>
+	int run(F&& f) noexcept
+	{
+		int res = 0;
+
+#      if defined(STORED_OS_POSIX) && !defined(STORED_HAVE_ZTH)
+		// Register the wakeup of stop(). If that fails, stop() only
+		// becomes effective after the next event.
+		bool wake = false;
+		if(m_wake.isOpen() || !m_wake.open()) {
+			m_wakePollable.fd = m_wake.fd();
+			wake = !add(m_wakePollable);
+		}
+
+		auto g = [&](Pollable& p) {
+			if(&p != &m_wakePollable)
+				f(p);
+		};
+
+		while(true) {
+			// Arm first, such that a stop() in between wakes us up.
+			if(wake)
+				m_wake.arm();
+
+			if(m_stop.exchange(false))
+				break;
+
+			res = runOnce(g);
+			m_wake.disarm();
+
+			if(res != EAGAIN && res != EINTR && res != 0)
+				break;
+
+			res = 0;
+		}
+
+		m_wake.disarm();
+
+		if(wake)
+			remove(m_wakePollable);
+#      else
+		while(!m_stop.exchange(false)) {
+			res = runOnce(f);
+
+			if(res != EAGAIN && res != EINTR && res != 0)
+				break;
+
+			res = 0;
+		}
+#      endif
+
+		return res;
+	}
+
+	/*!
+	 * \brief Let #run() return after dispatching the current events.
+	 *
+	 * When #run() is not running, the next #run() returns immediately.
+	 *
+	 * On POSIX, this may be called from another thread, as it wakes up
+	 * #run().  Otherwise, it only becomes effective once the current
+	 * poll returns, so call it from a callback, or make sure that some
+	 * pollable becomes ready afterwards.
+	 */
+	void stop() noexcept
+	{
+		m_stop = true;
+#      if defined(STORED_OS_POSIX) && !defined(STORED_HAVE_ZTH)
+		m_wake.notify();
+#      endif
+	}
+#    endif // C++11
+
 protected:
 	virtual void event(Pollable::Events revents, size_t index) noexcept override
 	{
 		stored_assert(index < m_items.size());
-		// m_result should be large enough, as it was reserve()d before.
-		stored_assert(m_result.size() < m_result.capacity());
 
 		Pollable* p = m_pollables[index];
 		p->revents = revents;
@@ -989,6 +1464,15 @@ protected:
 		if(revents.none())
 			return;
 
+		if(m_dispatch) {
+			m_dispatched = true;
+			m_dispatch(m_dispatchArg, *p);
+			return;
+		}
+
+		// m_result should be large enough, as it was reserve()d before.
+		stored_assert(m_result.size() < m_result.capacity());
+
 		try {
 #    ifdef STORED_POLL_OLD
 			OldResult r = {p->events.to_ulong(), revents.to_ulong(), p->user_data, p};
@@ -1002,10 +1486,32 @@ protected:
 		}
 	}
 
+private:
+	template <typename F>
+	static void dispatch(void* f, Pollable& p)
+	{
+		(*static_cast<F*>(f))(p);
+	}
+
 private:
 	Vector<Pollable*>::type m_pollables;
 	PollItemList m_items;
 	Result m_result;
+
+	/*! \brief Callback of runOnce(), or \c nullptr when poll() is used. */
+	void (*m_dispatch)(void*, Pollable&);
+	void* m_dispatchArg;
+	bool m_dispatched;
+#    if STORED_cplusplus >= 201103L
+	/*! \brief Set by #stop(), and cleared by #run() when it returns. */
+	std::atomic<bool> m_stop{false};
+#      if defined(STORED_OS_POSIX) && !defined(STORED_HAVE_ZTH)
+	/*! \brief Wakes up #run() upon #stop(). */
+	FifoEvent m_wake;
+	/*! \brief The pollable of #m_wake, registered while #run() is running. */
+	PollableFd m_wakePollable{-1, Pollable::Events(Pollable::PollIn)};
+#      endif
+#    endif
 };
 
 template <typename PollerImpl = PollerImpl>
@@ -1291,6 +1797,409 @@ private:
 	Pollables m_pollables;
 #    endif
 };
+
+#    if STORED_cplusplus >= 201103L && (defined(STORED_OS_POSIX) || defined(DOXYGEN))
+/*!
+ * \brief A poller that distributes pollables over multiple worker threads.
+ *
+ * Every worker thread has its own poller.  A pollable is assigned to one of
+ * these threads when it is added, and all its events are dispatched by that
+ * thread.  So, the callback is never called concurrently for the same
+ * pollable, and a ProtocolLayer stack does not have to be thread-safe, as
+ * long as all pollables of the stack are added to the same thread.  A slow
+ * callback only delays the pollables of its own thread.
+ *
+ * Unless specified otherwise, a pollable is added to the thread with the
+ * fewest pollables.  Pollables are not migrated afterwards.
+ *
+ * #add() and #remove() can be called from any thread, also when the workers
+ * are running.  When called from another thread, they block until the worker
+ * has processed the request.  When called from a callback for its own thread,
+ * the request is processed after the current poll round.  The return value is
+ * then always 0.  A pollable removed this way does not get any events
+ * anymore, but it must stay valid until the callback's round has finished.
+ * Blocking requests from a callback to another thread may deadlock when that
+ * thread does the same the other way around.
+ */
+template <typename PollerImpl = PollerImpl>
+class ThreadedPoller {
+	STORED_CLASS_NOCOPY(ThreadedPoller)
+	STORED_CLASS_NEW_DELETE(ThreadedPoller)
+public:
+	typedef typename Callable<void(Pollable&)>::type Callback;
+
+	/*!
+	 * \brief Ctor.
+	 * \param threads the number of worker threads, or 0 for one per core
+	 */
+	explicit ThreadedPoller(size_t threads = 0)
+	{
+		if(!threads)
+			threads = std::max<size_t>(1U, std::thread::hardware_concurrency());
+
+		m_shards.reserve(threads);
+		for(size_t i = 0; i < threads; i++)
+			m_shards.push_back(new Shard());
+	}
+
+	/*!
+	 * \brief Dtor.
+	 *
+	 * Stops the worker threads, if they are still running.
+	 */
+	~ThreadedPoller()
+	{
+		stop();
+
+		for(size_t i = 0; i < m_shards.size(); i++)
+			delete m_shards[i];
+	}
+
+	/*!
+	 * \brief The number of worker threads.
+	 */
+	size_t threads() const noexcept
+	{
+		return m_shards.size();
+	}
+
+	/*!
+	 * \brief Start the worker threads.
+	 *
+	 * \p f is called as \c f(Pollable&) for every event.  It is called
+	 * concurrently by all worker threads, but never concurrently for the
+	 * same pollable.  It must not throw.
+	 *
+	 * \return 0 on success, otherwise an errno
+	 */
+	template <typename F>
+	int start(F&& f) noexcept
+	{
+		if(running())
+			return EALREADY;
+
+		try {
+			m_callback = std::forward<F>(f);
+		} catch(...) {
+			return ENOMEM;
+		}
+
+		m_running = true;
+
+		for(size_t i = 0; i < m_shards.size(); i++) {
+			Shard& s = *m_shards[i];
+			int res = 0;
+
+			{
+				std::lock_guard<std::mutex> l(s.lock);
+
+				res = s.open();
+				if(!res) {
+					try {
+						// The worker waits for the lock, such that
+						// s.thread is assigned before it starts.
+						s.thread = std::thread(
+							&ThreadedPoller::worker, this, std::ref(s));
+						s.active = true;
+					} catch(...) {
+						s.poller.remove(s.wakePollable);
+						res = EAGAIN;
+					}
+				}
+			}
+
+			if(res) {
+				stop();
+				return res;
+			}
+		}
+
+		return 0;
+	}
+
+	/*!
+	 * \brief Checks if the worker threads are started.
+	 */
+	bool running() const noexcept
+	{
+		return m_running;
+	}
+
+	/*!
+	 * \brief Stop and join all worker threads.
+	 *
+	 * This must not be called from a callback.  The pollables remain
+	 * registered; #start() can be called again later on.
+	 */
+	void stop() noexcept
+	{
+		for(size_t i = 0; i < m_shards.size(); i++) {
+			Shard& s = *m_shards[i];
+			stored_assert(std::this_thread::get_id() != s.thread.get_id());
+
+			{
+				std::lock_guard<std::mutex> l(s.lock);
+				s.stopping = true;
+			}
+
+			s.wake.notify();
+		}
+
+		for(size_t i = 0; i < m_shards.size(); i++) {
+			Shard& s = *m_shards[i];
+
+			if(s.thread.joinable())
+				s.thread.join();
+
+			s.poller.remove(s.wakePollable);
+			s.stopping = false;
+		}
+
+		m_running = false;
+	}
+
+	/*!
+	 * \brief Add a pollable to the worker thread with the fewest pollables.
+	 * \return 0 on success, otherwise an errno
+	 */
+	int add(Pollable& p) noexcept
+	{
+		size_t thread = 0;
+		size_t count = std::numeric_limits<size_t>::max();
+
+		for(size_t i = 0; i < m_shards.size(); i++) {
+			size_t c = m_shards[i]->size();
+			if(c < count) {
+				count = c;
+				thread = i;
+			}
+		}
+
+		return add(p, thread);
+	}
+
+	/*!
+	 * \brief Add a pollable to the given worker thread.
+	 * \return 0 on success, otherwise an errno
+	 */
+	int add(Pollable& p, size_t thread) noexcept
+	{
+		if(thread >= m_shards.size())
+			return EINVAL;
+
+		return m_shards[thread]->request(p, true);
+	}
+
+	/*!
+	 * \brief Remove a pollable.
+	 * \return 0 on success, otherwise an errno
+	 */
+	int remove(Pollable& p) noexcept
+	{
+		size_t t = thread(p);
+		if(t >= m_shards.size())
+			return ESRCH;
+
+		return m_shards[t]->request(p, false);
+	}
+
+	/*!
+	 * \brief Return the worker thread index the given pollable is added to.
+	 *
+	 * Use this to add related pollables to the same thread.
+	 *
+	 * \return the index, or #threads() when not found
+	 */
+	size_t thread(Pollable const& p) const noexcept
+	{
+		for(size_t i = 0; i < m_shards.size(); i++)
+			if(m_shards[i]->contains(p))
+				return i;
+
+		return m_shards.size();
+	}
+
+private:
+	struct Request {
+		Pollable* p;
+		bool add;
+		/*! \brief Where to store the result, or \c nullptr when nobody waits for it. */
+		int* result;
+	};
+
+	class Shard {
+		STORED_CLASS_NOCOPY(Shard)
+		STORED_CLASS_NEW_DELETE(Shard)
+	public:
+		Shard()
+			: wakePollable(-1, Pollable::Events(Pollable::PollIn))
+		{}
+
+		int open() noexcept
+		{
+			if(!wake.isOpen()) {
+				int res = wake.open();
+				if(res)
+					return res;
+
+				wakePollable.fd = wake.fd();
+			}
+
+			return poller.add(wakePollable);
+		}
+
+		size_t size() const noexcept
+		{
+			std::lock_guard<std::mutex> l(lock);
+			return pollables.size();
+		}
+
+		bool contains(Pollable const& p) const noexcept
+		{
+			std::lock_guard<std::mutex> l(lock);
+			return std::find(pollables.begin(), pollables.end(), &p) != pollables.end();
+		}
+
+		bool self() const noexcept
+		{
+			return std::this_thread::get_id() == thread.get_id();
+		}
+
+		int request(Pollable& p, bool add) noexcept
+		{
+			std::unique_lock<std::mutex> l(lock);
+
+			if(!active)
+				return apply(p, add);
+
+			bool async = self();
+			int result = -1;
+
+			try {
+				if(async && !add)
+					removed.push_back(&p);
+
+				requests.push_back(Request{&p, add, async ? nullptr : &result});
+			} catch(...) {
+				return ENOMEM;
+			}
+
+			if(async)
+				return 0;
+
+			wake.notify();
+			done.wait(l, [&]() { return result >= 0; });
+			return result;
+		}
+
+		/*!
+		 * \brief Process pending requests.
+		 * \return \c false when the worker should stop
+		 */
+		bool process() noexcept
+		{
+			std::lock_guard<std::mutex> l(lock);
+			removed.clear();
+
+			if(!requests.empty()) {
+				for(size_t i = 0; i < requests.size(); i++) {
+					Request const& r = requests[i];
+					int res = apply(*r.p, r.add);
+					if(r.result)
+						*r.result = res;
+				}
+
+				requests.clear();
+				done.notify_all();
+			}
+
+			if(stopping)
+				active = false;
+
+			return active;
+		}
+
+		bool isRemoved(Pollable const& p) const noexcept
+		{
+			return !removed.empty()
+			       && std::find(removed.begin(), removed.end(), &p) != removed.end();
+		}
+
+	private:
+		int apply(Pollable& p, bool add) noexcept
+		{
+			if(!add) {
+				int res = poller.remove(p);
+				if(!res)
+					pollables.erase(
+						std::find(pollables.begin(), pollables.end(), &p));
+				return res;
+			}
+
+			try {
+				pollables.reserve(pollables.size() + 1U);
+			} catch(...) {
+				return ENOMEM;
+			}
+
+			int res = poller.add(p);
+			if(!res)
+				pollables.push_back(&p);
+			return res;
+		}
+
+	public:
+		CustomPoller<PollerImpl> poller;
+		FifoEvent wake;
+		PollableFd wakePollable;
+		std::thread thread;
+
+		mutable std::mutex lock;
+		std::condition_variable done;
+		/*! \brief Pending requests, protected by #lock. */
+		typename Vector<Request>::type requests;
+		/*! \brief Added pollables, protected by #lock. */
+		Vector<Pollable*>::type pollables;
+		/*! \brief Removed by a callback during the current round, only used by the worker. */
+		Vector<Pollable*>::type removed;
+		bool active = false;
+		bool stopping = false;
+	};
+
+	void worker(Shard& s) noexcept
+	{
+		{
+			// Wait till start() has finished setting up this shard.
+			std::lock_guard<std::mutex> l(s.lock);
+		}
+
+		auto f = [&](Pollable& p) {
+			if(&p == &s.wakePollable || s.isRemoved(p))
+				return;
+
+			m_callback(p);
+		};
+
+		while(true) {
+			// Arm first, such that a request or stop() in between wakes us up.
+			s.wake.arm();
+
+			if(!s.process())
+				break;
+
+			s.poller.runOnce(f);
+			s.wake.disarm();
+		}
+
+		s.wake.disarm();
+	}
+
+private:
+	typename Vector<Shard*>::type m_shards;
+	Callback m_callback;
+	std::atomic<bool> m_running{false};
+};
+#    endif // C++11 && STORED_OS_POSIX
 #  endif // !STORED_HAVE_ZTH
 
 } // namespace stored
@@ -287,6 +287,19 @@ public:
 		return down() ? down()->flush() : true;
 	}
 
+	/*!
+	 * \brief Checks if a message can be encoded now, without blocking or being dropped.
+	 *
+	 * A layer that experiences backpressure of the transport can return \c
+	 * false, such that the layers above can hold back their messages.
+	 *
+	 * \return \c true if the stack (top-down) is writable
+	 */
+	virtual bool writable()
+	{
+		return down() ? down()->writable() : true;
+	}
+
 	/*!
 	 * \brief Reset the stack (top-down), and drop all messages.
 	 */
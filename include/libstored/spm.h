@@ -11,6 +11,10 @@
 
 #	include <new>
 
+#	if STORED_cplusplus >= 201103L
+#		include <atomic>
+#	endif
+
 namespace stored {
 
 /*!
@@ -28,6 +32,10 @@ namespace stored {
  * like a stack; you can #reset() it, or make a #snapshot(), which you can
  * rollback to.
  *
+ * Use #stats() to see how often the ScratchPad had to allocate from the
+ * heap.  With #setAutoReserve(), #reset() reserves the observed peak usage
+ * plus some headroom, such that subsequent runs fit in one chunk.
+ *
  * \tparam MaxSize the maximum total size to be allocated, which is used to
  *         determine the type of the internal counters.
  */
@@ -55,6 +63,9 @@ public:
 		, m_size()
 		, m_total()
 		, m_max()
+		, m_spills()
+		, m_allocations()
+		, m_autoReserve()
 	{
 		this->reserve(reserve);
 	}
@@ -88,7 +99,14 @@ public:
 
 			m_old.clear();
 			try {
-				reserve(m_max);
+				reserve(reserveSize());
+			} catch(...) {
+				// Leave for now.
+			}
+		} else if(unlikely(m_autoReserve && bufferSize() < (size_t)m_max + (size_t)m_max / 8U)) {
+			// Running out of headroom.
+			try {
+				reserve(reserveSize());
 			} catch(...) {
 				// Leave for now.
 			}
@@ -124,6 +142,69 @@ public:
 		return (size_t)m_max;
 	}
 
+	/*!
+	 * \brief Usage statistics of a ScratchPad.
+	 * \see #stats()
+	 */
+	struct Stats {
+		/*! \brief Current number of chunks. See #chunks(). */
+		size_t chunks;
+		/*! \brief Number of times a new chunk was added, while the current one was in use. */
+		size_t spills;
+		/*! \brief Number of chunks allocated from the heap. */
+		size_t allocations;
+		/*! \brief Peak usage. See #max(). */
+		size_t peak;
+		/*! \brief Current capacity. See #capacity(). */
+		size_t capacity;
+	};
+
+	/*!
+	 * \brief Returns the usage statistics.
+	 */
+	Stats stats() const noexcept
+	{
+		Stats s;
+		s.chunks = chunks();
+		s.spills = m_spills;
+		s.allocations = m_allocations;
+		s.peak = max();
+		s.capacity = capacity();
+		return s;
+	}
+
+	/*!
+	 * \brief Resets the counters of #stats().
+	 * \details It leaves #max() untouched.
+	 */
+	void resetStats() noexcept
+	{
+		m_spills = 0;
+		m_allocations = 0;
+	}
+
+	/*!
+	 * \brief Let #reset() reserve the peak usage, plus some headroom.
+	 *
+	 * By default, #reset() only reserves #max() when chunks have to be
+	 * coalesced.  In auto-reserve mode, it also makes sure that the buffer
+	 * has some headroom above #max(), such that a slightly higher peak
+	 * next time does not spill into another chunk.
+	 */
+	void setAutoReserve(bool enable = true) noexcept
+	{
+		m_autoReserve = enable;
+	}
+
+	/*!
+	 * \brief Returns whether auto-reserve mode is enabled.
+	 * \see #setAutoReserve()
+	 */
+	bool autoReserve() const noexcept
+	{
+		return m_autoReserve;
+	}
+
 	/*!
 	 * \brief Returns the total capacity currently available within the ScratchPad.
 	 */
@@ -295,6 +376,17 @@ private:
 		STORED_MAKE_MEM_NOACCESS(&m_buffer[m_size], bufferSize() - m_size);
 	}
 
+	/*!
+	 * \brief Returns the size #reset() should reserve.
+	 */
+	size_t reserveSize() const noexcept
+	{
+		size_t size = max();
+		if(m_autoReserve && size > 0)
+			size = std::min<size_t>(size + size / 4U + spare, maxSize);
+		return size;
+	}
+
 	/*!
 	 * \brief Allocate a new buffer with the given size.
 	 * \details The current buffer is moved to the #m_old list.
@@ -305,6 +397,7 @@ private:
 
 		// May throw std::bad_alloc.
 		char* p = allocate<char>(size + chunkHeader);
+		m_allocations++;
 
 		if(m_buffer) {
 			try {
@@ -321,6 +414,9 @@ private:
 			}
 		}
 
+		if(m_buffer && m_size > 0)
+			m_spills++;
+
 		m_buffer = buffer(p);
 		setBufferSize(size);
 		m_size = 0;
@@ -370,6 +466,7 @@ private:
 		// and then allocate a new one.
 		chunkDeallocate(chunk(), bufferSize());
 		m_buffer = buffer(allocate<char>(size + chunkHeader));
+		m_allocations++;
 		setBufferSize(size);
 
 		STORED_MAKE_MEM_NOACCESS(&m_buffer[m_size], size - m_size);
@@ -579,7 +676,350 @@ private:
 	size_type m_total;
 	/*! \brief Maximum value of #m_total. */
 	size_type m_max;
+	/*! \brief Number of chunks pushed while the previous one was in use. */
+	size_t m_spills;
+	/*! \brief Number of chunk allocations. */
+	size_t m_allocations;
+	/*! \brief Auto-reserve mode. See #setAutoReserve(). */
+	bool m_autoReserve;
+};
+
+#	if STORED_cplusplus >= 201103L
+/*!
+ * \brief A thread-safe pool of ScratchPads.
+ *
+ * A ScratchPad is not thread-safe. When multiple threads need scratch
+ * memory, every thread can #acquire() its own arena from the pool. The
+ * arena is returned to the pool when the Lease is released. Snapshots and
+ * rollbacks work as usual on the leased ScratchPad.
+ *
+ * Arenas are allocated on first use, and kept for reuse afterwards. So,
+ * the number of arenas is the maximum number of concurrent leases. A
+ * thread tends to get the same arena it used before, such that the
+ * capacity of that arena matches the needs of that thread. Once all arenas
+ * have grown to their required size, acquiring and releasing does not
+ * allocate, and does not lock.
+ *
+ * With #setAutoReserve(), the pool tracks the peak usage of all arenas,
+ * and reserves that in every arena when it is acquired. So, an arena that
+ * is used for the first time is already large enough.
+ *
+ * \tparam MaxSize see #stored::ScratchPad
+ */
+template <size_t MaxSize = 0xffff>
+class ScratchPadPool {
+	STORED_CLASS_NOCOPY(ScratchPadPool)
+public:
+	/*! \brief The type of the arenas. */
+	typedef ScratchPad<MaxSize> ScratchPad_type;
+
+	enum {
+		/*! \brief Number of arenas that are allocated at once. */
+		BlockSize = 8
+	};
+
+private:
+	/*! \brief One arena. */
+	struct Slot {
+		/*! \brief Flag that indicates that the slot is leased. */
+		std::atomic<bool> busy{false};
+		/*! \brief The arena, which is only accessed by the owner of #busy. */
+		ScratchPad_type* spm{};
+	};
+
+	/*! \brief A set of slots. Blocks are only appended, and never removed. */
+	struct Block {
+		Slot slots[BlockSize]; // NOLINT(hicpp-avoid-c-arrays)
+		std::atomic<Block*> next{};
+	};
+
+public:
+	/*!
+	 * \brief Ctor.
+	 * \param reserve the number of bytes to reserve in every new arena
+	 */
+	explicit ScratchPadPool(size_t reserve = 0) noexcept
+		: m_reserve(reserve)
+	{}
+
+	/*!
+	 * \brief Dtor.
+	 * \details All leases must have been released.
+	 */
+	~ScratchPadPool() noexcept
+	{
+		Block* b = &m_first;
+		while(b) {
+			for(size_t i = 0; i < BlockSize; i++) {
+				stored_assert(!b->slots[i].busy.load(std::memory_order_relaxed));
+				cleanup(b->slots[i].spm);
+			}
+
+			Block* next = b->next.load(std::memory_order_relaxed);
+			if(b != &m_first)
+				cleanup(b);
+			b = next;
+		}
+	}
+
+	/*!
+	 * \brief A leased arena of the pool.
+	 *
+	 * The arena is reset and returned to the pool upon destruction or
+	 * #release(). A Lease must not be shared between threads.
+	 */
+	class Lease {
+	protected:
+		friend class ScratchPadPool;
+
+		/*! \brief Ctor. */
+		Lease(ScratchPadPool& pool, Slot* slot) noexcept
+			: m_pool(&pool)
+			, m_slot(slot)
+		{}
+
+	public:
+		/*! \brief Ctor for an empty lease. */
+		Lease() noexcept
+			: m_pool()
+			, m_slot()
+		{}
+
+		Lease(Lease const&) = delete;
+		void operator=(Lease const&) = delete;
+
+		/*! \brief Move ctor. */
+		Lease(Lease&& l) noexcept
+			: m_pool(l.m_pool)
+			, m_slot(l.m_slot)
+		{
+			l.m_slot = nullptr;
+		}
+
+		/*! \brief Move-assign. */
+		Lease& operator=(Lease&& l) noexcept
+		{
+			if(this != &l) {
+				release();
+				m_pool = l.m_pool;
+				m_slot = l.m_slot;
+				l.m_slot = nullptr;
+			}
+			return *this;
+		}
+
+		/*! \brief Dtor, which implies #release(). */
+		~Lease() noexcept
+		{
+			release();
+		}
+
+		/*!
+		 * \brief Reset the arena and return it to the pool.
+		 * \details Snapshots of the arena must have been reset or rolled back before.
+		 */
+		void release() noexcept
+		{
+			if(!m_slot)
+				return;
+
+			m_pool->updatePeak(m_slot->spm->max());
+			m_slot->spm->reset();
+			m_slot->busy.store(false, std::memory_order_release);
+			m_slot = nullptr;
+		}
+
+		/*! \brief Checks if this lease holds an arena. */
+		bool valid() const noexcept
+		{
+			return m_slot != nullptr;
+		}
+
+		/*! \brief Returns the leased arena. */
+		ScratchPad_type& spm() const noexcept
+		{
+			stored_assert(valid());
+			return *m_slot->spm;
+		}
+
+		/*! \brief Returns the leased arena. */
+		ScratchPad_type& operator*() const noexcept
+		{
+			return spm();
+		}
+
+		/*! \brief Returns the leased arena. */
+		ScratchPad_type* operator->() const noexcept
+		{
+			return &spm();
+		}
+
+	private:
+		/*! \brief The pool this lease belongs to. */
+		ScratchPadPool* m_pool;
+		/*! \brief The leased slot. */
+		Slot* m_slot;
+	};
+
+	/*!
+	 * \brief Lease an arena from the pool.
+	 *
+	 * This function is thread-safe and lock-free. It only allocates when
+	 * there are more concurrent leases than ever before.
+	 */
+	Lease acquire()
+	{
+		// Index of the slot this thread used last time.
+		static STORED_thread_local size_t hint = 0;
+
+		Slot* slot = nullptr;
+		size_t index = 0;
+
+		// Try the previous slot first, then find any free one.
+		Block* b = &m_first;
+		for(size_t i = hint / BlockSize; b && i > 0; i--)
+			b = b->next.load(std::memory_order_acquire);
+
+		if(b && claim(b->slots[hint % BlockSize])) {
+			slot = &b->slots[hint % BlockSize];
+			index = hint;
+		} else {
+			Block* last = nullptr;
+			size_t base = 0;
+			for(b = &m_first; b && !slot;
+			    b = b->next.load(std::memory_order_acquire), base += BlockSize) {
+				last = b;
+				for(size_t i = 0; i < BlockSize; i++)
+					if(claim(b->slots[i])) {
+						slot = &b->slots[i];
+						index = base + i;
+						break;
+					}
+			}
+
+			if(!slot) {
+				// All slots are in use. Add another block.
+				index = base;
+				slot = append(last, index);
+			}
+		}
+
+		bool autoReserve = m_autoReserve.load(std::memory_order_relaxed);
+		size_t reserve = m_reserve;
+		if(autoReserve)
+			reserve = std::max(reserve, m_peak.load(std::memory_order_relaxed));
+
+		try {
+			if(unlikely(!slot->spm)) {
+				// May throw std::bad_alloc.
+				slot->spm = new(allocate<ScratchPad_type>()) ScratchPad_type(reserve);
+				m_arenas.fetch_add(1, std::memory_order_relaxed);
+			} else if(autoReserve) {
+				// May throw std::bad_alloc.
+				slot->spm->reserve(reserve);
+			}
+		} catch(...) {
+			slot->busy.store(false, std::memory_order_release);
+#		ifdef STORED_cpp_exceptions
+			// cppcheck-suppress rethrowNoCurrentException
+			throw;
+#		else
+			std::terminate();
+#		endif
+		}
+
+		slot->spm->setAutoReserve(autoReserve);
+		hint = index;
+		return Lease(*this, slot);
+	}
+
+	/*!
+	 * \brief Reserve the peak usage of all arenas in every acquired arena.
+	 * \see #stored::ScratchPad::setAutoReserve()
+	 */
+	void setAutoReserve(bool enable = true) noexcept
+	{
+		m_autoReserve.store(enable, std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Returns the peak usage of all released arenas.
+	 */
+	size_t peak() const noexcept
+	{
+		return m_peak.load(std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Returns the number of allocated arenas.
+	 */
+	size_t arenas() const noexcept
+	{
+		return m_arenas.load(std::memory_order_relaxed);
+	}
+
+private:
+	/*!
+	 * \brief Update #peak() with the given size.
+	 */
+	void updatePeak(size_t size) noexcept
+	{
+		size_t peak = m_peak.load(std::memory_order_relaxed);
+		while(size > peak && !m_peak.compare_exchange_weak(peak, size, std::memory_order_relaxed)) {
+		}
+	}
+
+	/*!
+	 * \brief Try to lease the given slot.
+	 */
+	static bool claim(Slot& slot) noexcept
+	{
+		return !slot.busy.load(std::memory_order_relaxed)
+		       && !slot.busy.exchange(true, std::memory_order_acquire);
+	}
+
+	/*!
+	 * \brief Append a new block with its first slot leased.
+	 * \param last the last known block
+	 * \param index the index of the first slot after \p last, which is updated to the index of
+	 *        the returned slot
+	 * \return the leased slot of the new block
+	 */
+	Slot* append(Block* last, size_t& index)
+	{
+		stored_assert(last);
+
+		// May throw std::bad_alloc.
+		Block* b = new(allocate<Block>()) Block();
+		b->slots[0].busy.store(true, std::memory_order_relaxed);
+
+		// Other threads may append blocks concurrently. Just add ours at the end.
+		Block* expected = nullptr;
+		while(!last->next.compare_exchange_weak(
+			expected, b, std::memory_order_acq_rel, std::memory_order_acquire)) {
+			if(expected) {
+				last = expected;
+				index += BlockSize;
+				expected = nullptr;
+			}
+		}
+
+		return &b->slots[0];
+	}
+
+private:
+	/*! \brief The reserve size of new arenas. */
+	size_t const m_reserve;
+	/*! \brief The first block, which is never deallocated. */
+	Block m_first;
+	/*! \brief Number of allocated arenas. */
+	std::atomic<size_t> m_arenas{0};
+	/*! \brief Peak usage of all arenas. */
+	std::atomic<size_t> m_peak{0};
+	/*! \brief Auto-reserve mode. */
+	std::atomic<bool> m_autoReserve{false};
 };
+#	endif // C++11
 
 } // namespace stored
 #endif // __cplusplus
@@ -627,6 +627,8 @@ public:
 	template <typename Store>
 	void map(Synchronizable<Store>& store)
 	{
+		AllocationTracker::Scope alloc_scope(AllocationTracker::CategorySynchronizer);
+
 		m_storeMap.insert(std::make_pair(store.hash(), &store.journal()));
 
 		if(Synchronizable<Store>::MaxMessageSize > m_encodeBuffer.size())
@@ -23,6 +23,11 @@ namespace stored {
  *
  * This is a generic ZeroMQ class, for practical usages, instantiate
  * #stored::DebugZmqLayer or #stored::SyncZmqLayer instead.
+ *
+ * Received messages are decoded in place, without a copy, when only one part
+ * holds data.  Sent messages are copied into ZeroMQ, as the buffer passed to
+ * #encode() is only valid during that call.  This also holds for batching:
+ * every message is copied once into its ZeroMQ message.
  */
 class ZmqLayer : public PolledSocketLayer {
 	STORED_CLASS_NOCOPY(ZmqLayer)
@@ -46,24 +51,96 @@ public:
 	using base::encode;
 #		endif
 
+	virtual bool flush() override;
+	virtual bool writable() override;
+
+	/*!
+	 * \brief Send statistics.
+	 * \see #stats()
+	 */
+	struct Stats {
+		/*! \brief Number of messages passed to ZeroMQ. */
+		size_t messages;
+		/*! \brief Number of batches, which were sent as one multipart message. */
+		size_t batches;
+		/*! \brief Number of batched messages that were held back because of backpressure. */
+		size_t deferred;
+		/*! \brief Number of messages that were dropped because of an error. */
+		size_t dropped;
+	};
+
+	Stats const& stats() const;
+	void resetStats();
+
 protected:
 	int block(fd_type fd, bool forReading, long timeout_us = -1, bool suspend = false) final;
 	int block(bool forReading, long timeout_us = -1, bool suspend = false);
 	int recv1(long timeout_us = 0);
 
+	void setBatching(bool enable);
+	bool batching() const;
+
 private:
+	int sendPart(void const* buffer, size_t len, bool last);
+	int gather(void const* buffer, size_t len);
+	int sendEnvelope();
+	int batchDirect(void const* buffer, size_t len);
+	int batchGathered();
+	int sendBatch();
+	void dropBatch();
+	int keepPart(zmq_msg_t& msg);
+	int decodePart(zmq_msg_t& msg);
+	int decodeParts(zmq_msg_t* parts, size_t count);
+	int decodeRouted();
+	void dropParts();
+	void dropEnvelope();
+
 	/*! \brief The ZeroMQ context. */
 	void* m_context;
 	/*! \brief Flag to indicate if we created #m_context or not. */
 	bool m_contextCleanup;
-	/*! \brief A buffer to save partial request before decode() can start. */
+	/*! \brief A buffer to concatenate multipart or shared messages before decode(). */
 	void* m_buffer;
-	/*! \brief Number of bytes in #m_buffer. */
-	size_t m_bufferCapacity;
 	/*! \brief Allocated size of #m_buffer. */
-	size_t m_bufferSize;
+	size_t m_bufferCapacity;
 	/*! \brief The REP socket. */
 	void* m_socket;
+	/*! \brief Flag to indicate that #m_socket is a ROUTER socket. */
+	bool m_router;
+	/*! \brief The parts of a multipart message received so far. */
+	zmq_msg_t* m_parts;
+	/*! \brief Number of parts in #m_parts. */
+	size_t m_partsCount;
+	/*! \brief Allocated number of parts of #m_parts. */
+	size_t m_partsCapacity;
+	/*! \brief The routing envelope of the last received message of a ROUTER socket. */
+	zmq_msg_t* m_envelope;
+	/*! \brief Number of parts in #m_envelope. */
+	size_t m_envelopeCount;
+	/*! \brief Allocated number of parts of #m_envelope. */
+	size_t m_envelopeCapacity;
+	/*! \brief Flag to indicate that parts of the current message have been sent. */
+	bool m_sendMore;
+	/*! \brief Flag to indicate that the rest of the current message is dropped. */
+	bool m_sendDrop;
+	/*! \brief A buffer to join the parts of a batched message. */
+	char* m_send;
+	/*! \brief Number of bytes in #m_send. */
+	size_t m_sendSize;
+	/*! \brief Allocated size of #m_send. */
+	size_t m_sendCapacity;
+	/*! \brief Flag to indicate that messages are batched. See #setBatching(). */
+	bool m_batching;
+	/*! \brief The messages that are held back until the next #flush(). */
+	zmq_msg_t* m_batch;
+	/*! \brief Number of messages in #m_batch. */
+	size_t m_batchCount;
+	/*! \brief Number of messages in #m_batch that are counted as Stats::deferred. */
+	size_t m_batchDeferred;
+	/*! \brief Allocated number of messages of #m_batch. */
+	size_t m_batchCapacity;
+	/*! \brief Send statistics. */
+	Stats m_stats;
 };
 
 /*!
@@ -88,8 +165,78 @@ public:
 };
 
 /*!
- * \brief Constructs a protocol stack on top of a PAIR ZeroMQ socket, specifically for the
+ * \brief Constructs a protocol stack on top of a ROUTER ZeroMQ socket, specifically for the
+ * #stored::Debugger.
+ *
+ * Like #stored::DebugZmqLayer, but it serves multiple clients concurrently.
+ * Requests are processed in the order they arrive, regardless of the client,
+ * and every response is routed back to the client that sent the request.
+ * REQ and DEALER clients are supported.
+ *
+ * The #stored::Debugger has no per-client state. All clients share its
+ * streams, macros, trace configuration, publishing, priming and aliases. So,
+ * one client that reads a stream drains it for all of them, and a macro or
+ * alias defined by one client replaces the one of another client using the
+ * same name. Let clients agree on distinct names, or give every client its
+ * own #stored::Debugger and #stored::DebugZmqLayer when they need to be
+ * isolated.
+ */
+class DebugZmqRouterLayer : public ZmqLayer {
+	STORED_CLASS_NOCOPY(DebugZmqRouterLayer)
+public:
+	typedef ZmqLayer base;
+
+	explicit DebugZmqRouterLayer(
+		void* context = nullptr, int port = DebugZmqLayer::DefaultPort,
+		ProtocolLayer* up = nullptr, ProtocolLayer* down = nullptr);
+	/*! \brief Dtor. */
+	virtual ~DebugZmqRouterLayer() override is_default
+};
+
+/*!
+ * \brief A PUB ZeroMQ socket to push stream data of the #stored::Debugger.
+ *
+ * Pass this layer to #stored::Debugger::setPublisher(). A client subscribes
+ * to the streams it requested using the \c p command. Every message is a
+ * multipart message, of which the first frame holds the stream and tag,
+ * which is the topic to subscribe to. Messages are dropped
+ * when a subscriber cannot keep up, so the #stored::Debugger is never
+ * blocked by it.
+ */
+class DebugZmqPubLayer : public ZmqLayer {
+	STORED_CLASS_NOCOPY(DebugZmqPubLayer)
+public:
+	typedef ZmqLayer base;
+
+	enum {
+		/*!
+		 * \brief The default port.
+		 *
+		 * This is #stored::DebugZmqLayer::DefaultPort + 2, as + 1 is used
+		 * by the Python protocol stack.
+		 */
+		DefaultPort = 19028,
+	};
+
+	explicit DebugZmqPubLayer(
+		void* context = nullptr, int port = DefaultPort, ProtocolLayer* up = nullptr,
+		ProtocolLayer* down = nullptr);
+	/*! \brief Dtor. */
+	virtual ~DebugZmqPubLayer() override is_default
+};
+
+/*!
+ * \brief Constructs a protocol stack on top of a DEALER ZeroMQ socket, specifically for the
  * #stored::Synchronizer.
+ *
+ * When the peer does not keep up and the high-water mark of the socket is
+ * reached, the socket is not #writable(). The #stored::SyncConnection holds
+ * back its updates meanwhile. The changes remain in the journal of the store,
+ * and are combined into one update when the socket is writable again, instead
+ * of queueing stale updates.
+ *
+ * Enable #setBatching() on both sides to send all messages of one processing
+ * cycle as one multipart message.
  */
 class SyncZmqLayer : public ZmqLayer {
 	STORED_CLASS_NOCOPY(SyncZmqLayer)
@@ -99,8 +246,12 @@ public:
 	SyncZmqLayer(
 		void* context, char const* endpoint, bool listen, ProtocolLayer* up = nullptr,
 		ProtocolLayer* down = nullptr);
-	/*! \brief Dtor. */
-	virtual ~SyncZmqLayer() override is_default
+	virtual ~SyncZmqLayer() override;
+
+#		ifndef DOXYGEN
+	using base::batching;
+	using base::setBatching;
+#		endif
 };
 
 } // namespace stored
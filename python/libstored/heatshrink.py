@@ -38,16 +38,32 @@ class HeatshrinkDecoder:
 
     Although there is a python wrapper available at https://github.com/eerimoq/pyheatshrink,
     this implementation exists here to break dependencies and compatibility issues.
+
+    The window can be primed with a dictionary, and/or with the history of
+    previously finished data, like stored::CompressLayer::setDictionary() and
+    stored::CompressLayer::setHistory() do. The encoder must use the same
+    priming.
     '''
 
     logger = logging.getLogger(__name__)
 
-    def __init__(self, window_sz2=8, lookahead_sz2=4):
+    def __init__(self, window_sz2=8, lookahead_sz2=4, dictionary=b'', history=False):
         self._window_sz2 = window_sz2
         self._lookahead_sz2 = lookahead_sz2
         self._input_buffer_size = 32
+        self._dictionary = bytes(dictionary[-2 ** window_sz2:]) if dictionary else b''
+        self._history = history
+        self._buffers = None
         self._reset()
 
+    @property
+    def dictionary(self):
+        return self._dictionary
+
+    @property
+    def history(self):
+        return self._history
+
     def fill(self, x):
         start = 0
         rem = len(x)
@@ -77,11 +93,22 @@ class HeatshrinkDecoder:
         self._input_index = 0
         self._output_count = 0
         self._output_index = 0
-        self._head_index = 0
         self._state = HSD_state.HSDS_TAG_BIT
         self._current_byte = 0
         self._bit_index = 0
-        self._buffers = bytearray(b'\0' * (self._input_buffer_size + 2 ** self._window_sz2))
+
+        window_size = 2 ** self._window_sz2
+        if self._history and self._buffers is not None:
+            # Keep the window, but rotate it such that the head is at the start.
+            buf_i = self._input_buffer_size
+            head = buf_i + (self._head_index & (window_size - 1))
+            window = self._buffers[head:] + self._buffers[buf_i:head]
+        else:
+            # The most recent data is just before the head, which is at the end of the window.
+            window = b'\0' * (window_size - len(self._dictionary)) + self._dictionary
+
+        self._head_index = 0
+        self._buffers = bytearray(b'\0' * self._input_buffer_size) + window
 
     def _sink(self, x):
         rem = self._input_buffer_size - self._input_size
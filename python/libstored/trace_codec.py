@@ -0,0 +1,160 @@
+# SPDX-FileCopyrightText: 2020-2023 Jochem Rutgers
+#
+# SPDX-License-Identifier: MPL-2.0
+
+import logging
+
+class TraceDecoder(object):
+    """Decoder of the binary trace samples, as produced by stored::Debugger.
+
+    The layout has one char per command of the trace macro, as passed to the
+    debugger's ``c`` command. ``decode()`` returns all complete samples, as
+    lists of the responses of every command. Fields that are not sent by the
+    debugger, like the output of echo commands, are ``None``.
+
+    Samples are skipped until a key sample is received, as only that one
+    resets the codec state.
+    """
+
+    Skip = '_'
+    Raw = '-'
+    Int = 'i'
+    Float = 'f'
+    Double = 'd'
+
+    Key = ord('K')
+    Delta = ord('D')
+
+    _mask = (1 << 64) - 1
+
+    class _Incomplete(Exception):
+        pass
+
+    def __init__(self, layout):
+        if isinstance(layout, bytes):
+            layout = layout.decode()
+
+        for kind in layout:
+            if not kind in (self.Skip, self.Raw, self.Int, self.Float, self.Double):
+                raise ValueError('Invalid trace field ' + kind)
+
+        self.logger = logging.getLogger(__name__)
+        self._layout = layout
+        self.reset()
+
+    @property
+    def layout(self):
+        return self._layout
+
+    @property
+    def synced(self):
+        return self._synced
+
+    def reset(self):
+        self._buffer = b''
+        self._state = [[0, 0] for _ in self._layout]
+        self._synced = False
+
+    def decode(self, data):
+        self._buffer += data
+        samples = []
+        pos = 0
+
+        while pos < len(self._buffer):
+            state = [list(s) for s in self._state]
+            try:
+                key, fields, pos_ = self._sample(pos, state)
+            except TraceDecoder._Incomplete:
+                break
+            except ValueError as e:
+                # Sample boundaries are lost. Drop everything until the stream is reset.
+                self.logger.debug('Corrupt trace data: %s', e)
+                self._buffer = b''
+                self._synced = False
+                return samples
+
+            pos = pos_
+            self._state = state
+            if key:
+                self._synced = True
+            if self._synced:
+                samples.append(fields)
+
+        self._buffer = self._buffer[pos:]
+        return samples
+
+    def _byte(self, pos):
+        if pos >= len(self._buffer):
+            raise TraceDecoder._Incomplete()
+        return self._buffer[pos]
+
+    def _varint(self, pos):
+        value = 0
+        shift = 0
+        while True:
+            b = self._byte(pos)
+            pos += 1
+            value |= (b & 0x7f) << shift
+            if b < 0x80:
+                return value & self._mask, pos
+            shift += 7
+            if shift >= 70:
+                raise ValueError('Invalid varint')
+
+    def _sample(self, pos, state):
+        h = self._byte(pos)
+        pos += 1
+
+        if h == self.Key:
+            key = True
+            for s in state:
+                s[0] = s[1] = 0
+        elif h == self.Delta:
+            key = False
+        else:
+            raise ValueError('Invalid sample header')
+
+        fields = []
+        for i, kind in enumerate(self._layout):
+            s = state[i]
+
+            if kind == self.Skip:
+                fields.append(None)
+                continue
+            elif kind == self.Int:
+                z, pos = self._varint(pos)
+                if z > 0:
+                    z -= 1
+                    dd = (z >> 1) ^ -(z & 1)
+                    s[1] = (s[1] + dd) & self._mask
+                    s[0] = (s[0] + s[1]) & self._mask
+                    fields.append(b'%x' % s[0])
+                    continue
+
+                # Escaped to raw.
+                s[0] = s[1] = 0
+            elif kind == self.Float or kind == self.Double:
+                b = self._byte(pos)
+                pos += 1
+                fmt = b'%08x' if kind == self.Float else b'%016x'
+                if b == 0x40:
+                    fields.append(fmt % s[0])
+                    continue
+                elif b < 64:
+                    x, pos = self._varint(pos)
+                    s[0] ^= (x << b) & self._mask
+                    fields.append(fmt % s[0])
+                    continue
+                elif b != 0x41:
+                    raise ValueError('Invalid float field')
+
+                # Escaped to raw.
+                s[0] = 0
+
+            n, pos = self._varint(pos)
+            if pos + n > len(self._buffer):
+                raise TraceDecoder._Incomplete()
+            fields.append(self._buffer[pos:pos + n])
+            pos += n
+
+        return key, fields, pos
@@ -23,6 +23,7 @@ from PySide6.QtGui import QKeyEvent
 from .zmq_server import ZmqServer
 from .csv import CsvExport
 from .heatshrink import HeatshrinkDecoder
+from .trace_codec import TraceDecoder
 
 # Wrapper to keep sphinx happy...
 class _Property(Property):
@@ -776,12 +777,18 @@ class Stream(object):
         self._finishing = False
         self._flushing = False
         self._decoder = None
+        self._tag = None
+        self._seq = 0
+        self._callback = None
 
         cap = self._client.capabilities()
         if not 's' in cap:
             raise ValueError('Stream capability missing')
 
-        self._compressed = 'f' in self._client.capabilities()
+        self._compressed = 'f' in cap
+        # Let the debugger prime the compression with a dictionary and the stream's history.
+        self._primable = self._compressed and 'z' in cap
+        self._dictionary = None
         self.reset()
 
     @property
@@ -796,6 +803,49 @@ class Stream(object):
     def raw(self):
         return self._raw
 
+    @property
+    def pushed(self):
+        return self._tag is not None
+
+    def push(self, callback):
+        """Let the debugger push the stream data, instead of polling it.
+
+        The callback is called with the decoded data, when it arrives.
+        Returns False when the debugger cannot push streams.
+        """
+        self._callback = callback
+        if not self.client._push(self):
+            self._callback = None
+            return False
+
+        self._reset()
+        return True
+
+    def _receive(self, seq, data):
+        if seq != self._seq:
+            # Messages were lost, so the (compressed) data cannot be decoded.
+            # Restart the stream with a new tag.
+            self.client.logger.debug('lost pushed data of stream %s; restart', self.name)
+            self.reset()
+            return
+
+        self._seq = (seq + 1) & 0xffff
+
+        if data == b'':
+            # End of the (compressed) data. The decoder is ready for the next part.
+            x = b'' if self._decoder is None else self._decoder.finish()
+        elif not self._decoder is None:
+            x = self._decoder.fill(data)
+        else:
+            x = data
+
+        if x == b'' or self._callback is None:
+            return
+
+        if not self.raw:
+            x = x.decode(errors='backslashreplace')
+        self._callback(x)
+
     def poll(self, suffix='', callback=None):
         req = b's' + (self.name + suffix).encode()
         if callback is None:
@@ -807,15 +857,20 @@ class Stream(object):
         if not self._decoder is None:
             x = self._decoder.fill(x)
             if self._finishing:
+                # The decoder is ready for the next part, but keeps its history when primed.
                 x += self._decoder.finish()
-                self._reset()
+                self._finishing = False
 
         if not self.raw:
             x = x.decode(errors='backslashreplace')
         return x
 
     def flush(self):
-        if self._compressed and not self._flushing and not self._finishing:
+        if self.pushed:
+            # The end of the data is marked in the pushed stream.
+            if self._compressed:
+                self.client.reqAsync(b'f' + self.name.encode(), lambda x: None)
+        elif self._compressed and not self._flushing and not self._finishing:
             self._flushing = True
             self.client.reqAsync(b'f' + self.name.encode(), callback=lambda x: self._finish())
 
@@ -825,15 +880,40 @@ class Stream(object):
             self._finishing = True
 
     def reset(self):
-        if self._compressed:
+        if self.pushed:
+            # Switch to a new tag, which drops the data of the old one.
+            self.client._push(self)
+            self._reset()
+        elif self._primable:
+            # Restart the stream, and (re)start priming.
+            self.client.reqAsync(b'z' + self.name.encode(), lambda x: self._prime(x))
+            self._reset()
+        elif self._compressed:
             self.client.reqAsync(b'f' + self.name.encode(), lambda x: None)
             # Drop old data, as we missed the start of the stream.
             self.client.reqAsync(b's' + self.name.encode(), lambda x: None)
             self._reset()
 
+    def _prime(self, rep):
+        if rep[0:1] == b'!':
+            self._dictionary = rep[1:]
+        else:
+            # Not primed. As the stream was not flushed either, we may have missed its start.
+            self._primable = False
+            self._dictionary = None
+            self.reset()
+            return
+
+        self._reset()
+
     def _reset(self):
+        # A new tag starts with sequence number 0.
+        self._seq = 0
         if self._compressed:
-            self._decoder = HeatshrinkDecoder()
+            if self._dictionary is None:
+                self._decoder = HeatshrinkDecoder()
+            else:
+                self._decoder = HeatshrinkDecoder(dictionary=self._dictionary, history=True)
             self._finishing = False
             self._flushing = False
 
@@ -956,6 +1036,8 @@ class Tracing(Macro):
         self._streamPending = False
         self._streamQueued = False
         self._partial = b''
+        self._codec = None
+        self._codecEcho = []
 
         cap = self.client.capabilities()
         if not 't' in cap:
@@ -969,6 +1051,9 @@ class Tracing(Macro):
 
         self._stream = self._client.stream(stream, raw=True)
 
+        # Let the debugger encode the samples binary, when supported.
+        self._codecSupported = 'c' in cap
+
         # Start with sample separator.
         self.add('e\n', None, 'e')
 
@@ -984,6 +1069,9 @@ class Tracing(Macro):
         self._enabled = False
         self._updateTracing(True);
 
+        if self._stream.push(self._decodeSamples):
+            self.client.logger.debug('Trace stream is pushed')
+
     def __del__(self):
         try:
             self._enabled = False
@@ -993,10 +1081,53 @@ class Tracing(Macro):
 
     def _update(self):
         super()._update()
+        self._updateCodec()
         # Remove existing samples from buffer, as the layout is changing.
         self._stream.reset()
         self._updateTracing()
 
+    def _fieldKind(self, key):
+        if key == 'e':
+            return TraceDecoder.Skip
+
+        o = self.client.time() if key == 't' else key
+        if not isinstance(o, Object):
+            return TraceDecoder.Raw
+
+        dtype = o.type & ~Object.FlagFunction
+        if dtype in (Object.Float, Object.Pointer32):
+            return TraceDecoder.Float
+        elif dtype in (Object.Double, Object.Pointer64):
+            return TraceDecoder.Double
+        elif o.isInt() or dtype == Object.Bool:
+            return TraceDecoder.Int
+        else:
+            return TraceDecoder.Raw
+
+    def _updateCodec(self):
+        if not self._codecSupported or self.macro is None:
+            return
+
+        # Follow the command order of Macro._update().
+        layout = ''
+        echo = []
+        for key in self._cmds.keys():
+            if echo != []:
+                layout += TraceDecoder.Skip
+                echo.append(self._repsep)
+            kind = self._fieldKind(key)
+            layout += kind
+            echo.append(self._cmds[key][0][1:] if kind == TraceDecoder.Skip else None)
+
+        if self.client.req(b'c' + layout.encode()) == b'!':
+            self._codec = TraceDecoder(layout)
+            self._codecEcho = echo
+        else:
+            self._codecSupported = False
+            self._codec = None
+
+        self._partial = b''
+
     def _updateTracing(self, force=False):
         if self._enabled is None:
             # Initializing
@@ -1038,6 +1169,11 @@ class Tracing(Macro):
         return self._stream
 
     def process(self):
+        if self._stream.pushed:
+            # Just handle the data that has arrived already.
+            self.client._subCheck()
+            return
+
         if self._streamPending:
             self._streamQueued = True
             return
@@ -1053,21 +1189,35 @@ class Tracing(Macro):
         else:
             self._streamPending = False
 
+        self._decodeSamples(s)
+
+    def _decodeSamples(self, s):
+        if self._codec is not None:
+            for fields in self._codec.decode(s):
+                # Reconstruct the macro output.
+                sample = b''.join(self._codecEcho[i] if f is None else f for i, f in enumerate(fields))
+                if sample.startswith(b'\n;'):
+                    self._decodeSample(sample[2:])
+            return
+
         samples = (self._partial + s).split(b'\n;')
         self._partial = samples[-1]
-        time = self.client.time()
         for sample in samples[0:-1]:
-            # The first value is the time stamp.
-            t_data = sample.split(b';', 1)
-            if len(t_data) < 2:
-                # Empty sample.
-                continue
-            t = time._decode(t_data[0])
-            if t is None:
-                continue
-            ts = self.client.timestampToTime(t)
-            time.set(t, ts)
-            super().decode(t_data[1], ts, skip=2)
+            self._decodeSample(sample)
+
+    def _decodeSample(self, sample):
+        # The first value is the time stamp.
+        t_data = sample.split(b';', 1)
+        if len(t_data) < 2:
+            # Empty sample.
+            return
+        time = self.client.time()
+        t = time._decode(t_data[0])
+        if t is None:
+            return
+        ts = self.client.timestampToTime(t)
+        time.set(t, ts)
+        super().decode(t_data[1], ts, skip=2)
 
     def __len__(self):
         # Don't count sample separator and time stamp.
@@ -1078,6 +1228,11 @@ class ZmqClient(QObject):
 
     This client can connect to either the libstored.zmq_server.ZmqServer and stored::DebugZmqLayer.
 
+    When the debugger can push streams (the ``p`` capability), the trace
+    stream is received via a SUB socket, connected to pub_port.  By default,
+    this is port + 2, which matches stored::DebugZmqPubLayer.  Set pub_port
+    to 0 to always poll the streams.
+
     Instantiate as libstored.ZmqClient().
     """
 
@@ -1087,7 +1242,7 @@ class ZmqClient(QObject):
     defaultPollIntervalChanged = Signal()
     closed = Signal()
 
-    def __init__(self, address='localhost', port=ZmqServer.default_port, csv=None, multi=False, parent=None, t=None, timeout=None, context=None):
+    def __init__(self, address='localhost', port=ZmqServer.default_port, csv=None, multi=False, parent=None, t=None, timeout=None, context=None, pub_port=None):
         super().__init__(parent=parent)
         self.logger = logging.getLogger(__name__)
         self._multi = multi
@@ -1127,6 +1282,10 @@ class ZmqClient(QObject):
         self._reqQueue = []
         self._socketNotifier = None
         self._useEventLoop = False
+        self._sub = None
+        self._subNotifier = None
+        self._pushed = {}
+        self._pushTag = 0
 
         app = QCoreApplication.instance()
         if app is not None:
@@ -1139,6 +1298,16 @@ class ZmqClient(QObject):
         if 'f' in self.capabilities():
             self.logger.debug('Streams are compressed')
 
+        if pub_port is None:
+            pub_port = port + 2
+        if pub_port and 'p' in self.capabilities():
+            self.logger.debug('Streams can be pushed via port %d', pub_port)
+            self._sub = self._context.socket(zmq.SUB)
+            self._sub.connect(f'tcp://{address}:{pub_port}')
+            if app is not None:
+                self._subNotifier = QSocketNotifier(self._sub.fileno(), QSocketNotifier.Read, parent=self)
+                self._subNotifier.activated.connect(self._subCheck)
+
         try:
             self._tracing = Tracing(self)
         except Exception as e:
@@ -1402,6 +1571,7 @@ class ZmqClient(QObject):
         self._socket = None
         if not s is None:
             s.close(0)
+        self._closeSub()
         self._aboutToQuit()
 
         # Break all references to Objects for gc
@@ -1424,6 +1594,19 @@ class ZmqClient(QObject):
 
         self.closed.emit()
 
+    def _closeSub(self):
+        if not self._subNotifier is None:
+            try:
+                self._subNotifier.setEnabled(False)
+            except:
+                pass
+            self._subNotifier = None
+        s = self._sub
+        self._sub = None
+        self._pushed = {}
+        if not s is None:
+            s.close(0)
+
     def __enter__(self):
         return self
 
@@ -1436,6 +1619,7 @@ class ZmqClient(QObject):
         self._socket = None
         if not s is None:
             s.close(0)
+        self._closeSub()
         if not self.csv is None:
             self.csv.close()
             self.csv = None
@@ -1652,6 +1836,66 @@ class ZmqClient(QObject):
     def stream(self, s, raw=False):
         return Stream(self, s, raw)
 
+    def _push(self, stream):
+        """Let the debugger push the given stream, using a new tag.
+
+        Data of the previous tag of the stream is dropped.
+        Returns False when the debugger cannot push streams.
+        """
+        if self._sub is None:
+            return False
+
+        oldTag = stream._tag
+        stream._tag = chr(ord('a') + self._pushTag % 26)
+        self._pushTag += 1
+        self._pushed[stream.name] = stream
+
+        if oldTag is None:
+            # Subscribe before the debugger starts pushing.  The
+            # subscription covers all tags, such that it is already
+            # active when the stream is restarted with a new tag.
+            # However, the first messages may still be missed, as ZeroMQ
+            # processes the subscription asynchronously.  This is
+            # detected by the sequence number, which restarts the stream.
+            self._sub.setsockopt(zmq.SUBSCRIBE, stream.name.encode())
+
+        if self._publish():
+            return True
+
+        stream._tag = oldTag
+        if oldTag is None:
+            self._sub.setsockopt(zmq.UNSUBSCRIBE, stream.name.encode())
+            del self._pushed[stream.name]
+        return False
+
+    def _publish(self):
+        req = 'p' + ''.join([s.name + s._tag for s in self._pushed.values()])
+        return self.req(req.encode()) == b'!'
+
+    @Slot()
+    def _subCheck(self):
+        while not self._sub is None:
+            try:
+                msg = b''.join(self._sub.recv_multipart(zmq.NOBLOCK))
+            except zmq.ZMQError:
+                return
+
+            # <stream> <tag> <seq> <data>
+            if len(msg) < 6:
+                continue
+
+            stream = self._pushed.get(chr(msg[0]))
+            if stream is None or stream._tag != chr(msg[1]):
+                # Old tag.
+                continue
+
+            try:
+                seq = int(msg[2:6], 16)
+            except ValueError:
+                continue
+
+            stream._receive(seq, msg[6:])
+
     def _defaultPollInterval_get(self):
         return self._defaultPollInterval
 
@@ -0,0 +1,698 @@
+// SPDX-FileCopyrightText: 2020-2024 Jochem Rutgers
+//
+// SPDX-License-Identifier: MPL-2.0
+
+#include <libstored/allocator.h>
+#include <libstored/util.h>
+
+#include <cstdlib>
+#include <new>
+
+#if STORED_cplusplus >= 201103L
+#	include <atomic>
+#endif
+
+namespace stored {
+
+/*!
+ * \brief Storage for a MemoryPool instance.
+ */
+union MemoryPoolStorage {
+	char pool[sizeof(MemoryPool)]; // NOLINT(hicpp-avoid-c-arrays)
+	void* align_p;
+	long double align_d;
+};
+
+/*!
+ * \brief Returns the process-wide pool.
+ *
+ * The pools are never destructed, as containers with static storage
+ * duration may still deallocate during exit.
+ *
+ * \param threadSafe when \c true, return the thread-safe pool
+ */
+MemoryPool& MemoryPool::instance(bool threadSafe)
+{
+	static MemoryPoolStorage storage;
+	static MemoryPoolStorage storageThreadSafe;
+	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+	static MemoryPool* pool = new(storage.pool) MemoryPool(false);
+	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+	static MemoryPool* poolThreadSafe = new(storageThreadSafe.pool) MemoryPool(true);
+
+	return threadSafe ? *poolThreadSafe : *pool;
+}
+
+/*!
+ * \brief Ctor.
+ */
+MemoryPool::MemoryPool(bool threadSafe)
+	: m_threadSafe(threadSafe)
+	, m_initComplete()
+	, m_strict()
+	, m_free()
+	, m_slab()
+	, m_slabLeft()
+	, m_stats()
+#if STORED_cplusplus >= 201103L
+	, m_lock()
+#endif
+{
+#if STORED_cplusplus < 201103L
+	// No atomics available.
+	stored_assert(!threadSafe);
+#endif
+}
+
+/*!
+ * \brief Returns the index of the size class of the given size.
+ * \return the class, or #Classes when the size is larger than #MaxClassSize
+ */
+size_t MemoryPool::sizeClass(size_t size) noexcept
+{
+	size_t c = 0;
+	for(size_t s = Alignment; s < size && c < Classes; s <<= 1U)
+		c++;
+	return c;
+}
+
+/*!
+ * \brief Allocate an object of the given size.
+ *
+ * Thread-safety depends on the #instance() used.
+ *
+ * \return the object, which is aligned to #Alignment
+ */
+void* MemoryPool::allocate(size_t size)
+{
+	lock();
+
+	// In strict mode, no allocation is allowed at all after initialization.
+	stored_assert(!m_initComplete || !m_strict);
+	m_stats.allocations++;
+
+	size_t c = sizeClass(size);
+	void* p = nullptr;
+
+	if(likely(c < Classes && m_free[c])) {
+		p = m_free[c];
+		m_free[c] = *static_cast<void**>(p);
+	} else {
+		// The pool is exhausted; no heap traffic is expected after initialization.
+		stored_assert(!m_initComplete);
+
+		if(c < Classes) {
+			p = carve((size_t)Alignment << c);
+		} else {
+			m_stats.heap++;
+			p = malloc(size);
+		}
+	}
+
+	unlock();
+
+	if(unlikely(!p)) {
+#ifdef STORED_cpp_exceptions
+		throw std::bad_alloc();
+#else
+		std::terminate();
+#endif
+	}
+
+	STORED_MAKE_MEM_UNDEFINED(p, size);
+	return p;
+}
+
+/*!
+ * \brief Return an object to the pool.
+ * \param p the object, as returned by #allocate()
+ * \param size the same size as passed to #allocate()
+ */
+void MemoryPool::deallocate(void* p, size_t size) noexcept
+{
+	if(!p)
+		return;
+
+	size_t c = sizeClass(size);
+
+	lock();
+	m_stats.deallocations++;
+
+	if(c < Classes)
+		release(c, p);
+	else
+		free(p);
+
+	unlock();
+}
+
+/*!
+ * \brief Push an object onto the free list of the given class.
+ * \details Call with the lock held.
+ */
+void MemoryPool::release(size_t c, void* p) noexcept
+{
+	stored_assert(c < Classes);
+	STORED_MAKE_MEM_UNDEFINED(p, sizeof(void*));
+	*static_cast<void**>(p) = m_free[c];
+	m_free[c] = p;
+	STORED_MAKE_MEM_NOACCESS(static_cast<char*>(p) + sizeof(void*), ((size_t)Alignment << c) - sizeof(void*));
+}
+
+/*!
+ * \brief Distribute the remainder of the current slab over the free lists.
+ * \details Call with the lock held.
+ */
+void MemoryPool::releaseSlab() noexcept
+{
+	while(m_slabLeft >= Alignment) {
+		size_t c = Classes - 1;
+		while(((size_t)Alignment << c) > m_slabLeft)
+			c--;
+
+		size_t s = (size_t)Alignment << c;
+		release(c, m_slab);
+		m_slab += s;
+		m_slabLeft -= s;
+	}
+
+	m_slab = nullptr;
+	m_slabLeft = 0;
+}
+
+/*!
+ * \brief Take an object of the given size from the current slab.
+ * \details Call with the lock held.
+ * \return the object, or \c nullptr when out of memory
+ */
+void* MemoryPool::carve(size_t size)
+{
+	stored_assert(size <= SlabSize);
+
+	if(m_slabLeft < size) {
+		releaseSlab();
+
+		m_stats.heap++;
+		char* slab = static_cast<char*>(malloc(SlabSize));
+		if(!slab)
+			return nullptr;
+
+		// Slabs are never freed.
+		m_slab = slab;
+		m_slabLeft = SlabSize;
+	}
+
+	void* p = m_slab;
+	m_slab += size;
+	m_slabLeft -= size;
+	return p;
+}
+
+/*!
+ * \brief Make sure that \p count objects of the given size can be allocated from the pool.
+ *
+ * Objects larger than #MaxClassSize cannot be reserved.
+ */
+void MemoryPool::reserve(size_t size, size_t count)
+{
+	size_t c = sizeClass(size);
+	if(c >= Classes)
+		return;
+
+	lock();
+
+	size_t available = 0;
+	for(void* p = m_free[c]; p && available < count; p = *static_cast<void**>(p))
+		available++;
+
+	for(; available < count; available++) {
+		void* p = carve((size_t)Alignment << c);
+		if(!p) {
+			unlock();
+#ifdef STORED_cpp_exceptions
+			throw std::bad_alloc();
+#else
+			std::terminate();
+#endif
+		}
+
+		release(c, p);
+	}
+
+	unlock();
+}
+
+/*!
+ * \brief Use the given buffer to carve objects from, before using the heap.
+ *
+ * The buffer must remain valid for the lifetime of the application. Any
+ * remainder of a previous buffer or slab is kept in the free lists.
+ */
+void MemoryPool::setBuffer(void* buffer, size_t len)
+{
+	// Align the buffer.
+	uintptr_t b = (uintptr_t)buffer;
+	uintptr_t a = (b + (Alignment - 1U)) & ~(uintptr_t)(Alignment - 1U);
+	if(!buffer || len < (size_t)(a - b))
+		return;
+
+	lock();
+	releaseSlab();
+	m_slab = (char*)a; // NOLINT(performance-no-int-to-ptr)
+	m_slabLeft = (len - (size_t)(a - b)) & ~(size_t)(Alignment - 1U);
+	STORED_MAKE_MEM_NOACCESS(m_slab, m_slabLeft);
+	unlock();
+}
+
+/*!
+ * \brief Mark the end of the initialization of the application.
+ *
+ * Afterwards, allocations are only served from the free lists. When the
+ * pool would need to allocate more memory, an assert is triggered. When
+ * \p strict is \c true, any allocation triggers an assert.
+ */
+void MemoryPool::setInitComplete(bool complete, bool strict)
+{
+	lock();
+	m_initComplete = complete;
+	m_strict = complete && strict;
+	unlock();
+}
+
+/*!
+ * \brief Returns whether #setInitComplete() was called.
+ */
+bool MemoryPool::initComplete() const
+{
+	return m_initComplete;
+}
+
+/*!
+ * \brief Returns the allocation statistics.
+ */
+MemoryPool::Stats MemoryPool::stats() const
+{
+	lock();
+	Stats res = m_stats;
+	unlock();
+	return res;
+}
+
+/*!
+ * \brief Acquire the spinlock, if this is a thread-safe pool.
+ */
+void MemoryPool::lock() const noexcept
+{
+#if STORED_cplusplus >= 201103L
+	if(!m_threadSafe)
+		return;
+
+	while(m_lock.exchange(true, std::memory_order_acquire))
+		while(m_lock.load(std::memory_order_relaxed)) {
+			// Spin.
+		}
+#endif
+}
+
+/*!
+ * \brief Release the spinlock.
+ */
+void MemoryPool::unlock() const noexcept
+{
+#if STORED_cplusplus >= 201103L
+	if(m_threadSafe)
+		m_lock.store(false, std::memory_order_release);
+#endif
+}
+
+
+//////////////////////////////
+// AllocationTracker
+//
+
+#if STORED_cplusplus >= 201103L
+typedef std::atomic<size_t> TrackerCounter;
+#else
+// No atomics available. Counters may be off when used from multiple threads.
+typedef size_t TrackerCounter;
+#endif
+
+/*!
+ * \brief Statistics of one category, as kept by the AllocationTracker.
+ */
+struct TrackerCategory {
+	TrackerCounter allocations;
+	TrackerCounter deallocations;
+	TrackerCounter bytes;
+	TrackerCounter realTime;
+};
+
+/*!
+ * \brief A ScratchPad registered by AllocationTracker::watch().
+ */
+struct TrackerWatch {
+	char const* name;
+	void const* spm;
+	size_t (*max)(void const* spm);
+	size_t (*chunks)(void const* spm);
+	size_t (*spills)(void const* spm);
+};
+
+// NOLINTNEXTLINE(hicpp-avoid-c-arrays,cppcoreguidelines-avoid-non-const-global-variables)
+static TrackerCategory tracker_categories[AllocationTracker::CategoryCount];
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static TrackerCounter tracker_inUse;
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static TrackerCounter tracker_peak;
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static AllocationTracker::TrapHandler* tracker_trap;
+// NOLINTNEXTLINE(hicpp-avoid-c-arrays,cppcoreguidelines-avoid-non-const-global-variables)
+static TrackerWatch tracker_watches[AllocationTracker::MaxWatches];
+#if STORED_cplusplus >= 201103L
+/*! \brief Spinlock that guards #tracker_watches. */
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static std::atomic<bool> tracker_watchLock(false);
+#endif
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static STORED_thread_local AllocationTracker::Category tracker_category =
+	AllocationTracker::CategoryOther;
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static STORED_thread_local unsigned int tracker_realTime = 0;
+
+/*!
+ * \brief Read a counter, regardless of whether it is atomic.
+ */
+static size_t tracker_load(TrackerCounter const& c) noexcept
+{
+	return c;
+}
+
+/*!
+ * \brief Acquire the spinlock of #tracker_watches.
+ *
+ * Without atomics, (un)registering ScratchPads is not thread-safe.
+ */
+static void tracker_lock() noexcept
+{
+#if STORED_cplusplus >= 201103L
+	while(tracker_watchLock.exchange(true, std::memory_order_acquire))
+		while(tracker_watchLock.load(std::memory_order_relaxed)) {
+			// Spin.
+		}
+#endif
+}
+
+/*!
+ * \brief Release the spinlock of #tracker_watches.
+ */
+static void tracker_unlock() noexcept
+{
+#if STORED_cplusplus >= 201103L
+	tracker_watchLock.store(false, std::memory_order_release);
+#endif
+}
+
+/*!
+ * \brief Returns the category of the current thread.
+ */
+AllocationTracker::Category AllocationTracker::category() noexcept
+{
+	return tracker_category;
+}
+
+/*!
+ * \brief Set the category of the current thread.
+ * \return the previous category
+ */
+AllocationTracker::Category AllocationTracker::enter(AllocationTracker::Category category) noexcept
+{
+	stored_assert(category >= CategoryOther && category < CategoryCount);
+	Category prev = tracker_category;
+	tracker_category = category;
+	return prev;
+}
+
+/*!
+ * \brief Returns a printable name of the given category.
+ */
+char const* AllocationTracker::name(AllocationTracker::Category category) noexcept
+{
+	switch(category) {
+	case CategoryOther:
+		return "other";
+	case CategoryDebugger:
+		return "debugger";
+	case CategorySynchronizer:
+		return "synchronizer";
+	case CategoryProtocol:
+		return "protocol";
+	case CategoryPoller:
+		return "poller";
+	case CategoryCount:
+	default:
+		return "?";
+	}
+}
+
+/*!
+ * \brief Record an allocation of the given size.
+ *
+ * Within a #RealTime section, the handler set by #setTrap() is called.
+ */
+void AllocationTracker::allocated(size_t size)
+{
+	Category c = tracker_category;
+	TrackerCategory& t = tracker_categories[c];
+	t.allocations++;
+	t.bytes += size;
+
+	size_t inUse = (tracker_inUse += size);
+#if STORED_cplusplus >= 201103L
+	size_t peak = tracker_peak.load(std::memory_order_relaxed);
+	while(inUse > peak && !tracker_peak.compare_exchange_weak(peak, inUse)) {
+	}
+#else
+	if(inUse > tracker_peak)
+		tracker_peak = inUse;
+#endif
+
+	if(unlikely(tracker_realTime)) {
+		t.realTime++;
+
+		TrapHandler* trap = tracker_trap;
+		if(trap)
+			trap(c, size);
+	}
+}
+
+/*!
+ * \brief Record a deallocation of the given size.
+ */
+void AllocationTracker::deallocated(size_t size) noexcept
+{
+	tracker_categories[tracker_category].deallocations++;
+	tracker_inUse -= size;
+}
+
+/*!
+ * \brief Returns the statistics of the given category.
+ */
+AllocationTracker::Stats AllocationTracker::stats(AllocationTracker::Category category) noexcept
+{
+	Stats s = {};
+	if(category < CategoryOther || category >= CategoryCount)
+		return s;
+
+	TrackerCategory const& t = tracker_categories[category];
+	s.allocations = tracker_load(t.allocations);
+	s.deallocations = tracker_load(t.deallocations);
+	s.bytes = tracker_load(t.bytes);
+	s.realTime = tracker_load(t.realTime);
+	return s;
+}
+
+/*!
+ * \brief Returns the sum of the statistics of all categories.
+ */
+AllocationTracker::Stats AllocationTracker::total() noexcept
+{
+	Stats s = {};
+	for(int c = 0; c < CategoryCount; c++) {
+		Stats sc = stats((Category)c);
+		s.allocations += sc.allocations;
+		s.deallocations += sc.deallocations;
+		s.bytes += sc.bytes;
+		s.realTime += sc.realTime;
+	}
+	return s;
+}
+
+/*!
+ * \brief Returns the number of bytes that are currently allocated.
+ */
+size_t AllocationTracker::inUse() noexcept
+{
+	return tracker_load(tracker_inUse);
+}
+
+/*!
+ * \brief Returns the maximum of #inUse().
+ */
+size_t AllocationTracker::peak() noexcept
+{
+	return tracker_load(tracker_peak);
+}
+
+/*!
+ * \brief Reset all statistics, except for #inUse().
+ */
+void AllocationTracker::reset() noexcept
+{
+	for(int c = 0; c < CategoryCount; c++) {
+		TrackerCategory& t = tracker_categories[c];
+		t.allocations = 0;
+		t.deallocations = 0;
+		t.bytes = 0;
+		t.realTime = 0;
+	}
+
+	tracker_peak = tracker_load(tracker_inUse);
+}
+
+/*!
+ * \brief Checks if the current thread is within a #RealTime section.
+ */
+bool AllocationTracker::realTime() noexcept
+{
+	return tracker_realTime > 0;
+}
+
+/*!
+ * \brief Enter a #RealTime section on the current thread.
+ */
+void AllocationTracker::enterRealTime() noexcept
+{
+	tracker_realTime++;
+}
+
+/*!
+ * \brief Leave a #RealTime section on the current thread.
+ */
+void AllocationTracker::leaveRealTime() noexcept
+{
+	stored_assert(tracker_realTime > 0);
+	tracker_realTime--;
+}
+
+/*!
+ * \brief Set the handler that is called for allocations within a #RealTime section.
+ *
+ * The handler is called after the allocation is counted, but before the
+ * memory is actually allocated. It may throw, or #abort().
+ *
+ * \param handler the handler, or \c nullptr to disable trapping
+ */
+void AllocationTracker::setTrap(AllocationTracker::TrapHandler* handler) noexcept
+{
+	tracker_trap = handler;
+}
+
+/*!
+ * \brief A #TrapHandler that reports the allocation to \c stderr and aborts.
+ */
+void AllocationTracker::abort(AllocationTracker::Category category, size_t size)
+{
+	fprintf(stderr, "Allocation of %zu bytes by %s in real-time section\n", size, name(category));
+	std::abort();
+}
+
+/*!
+ * \brief Register a ScratchPad, with the functions to retrieve its properties.
+ */
+bool AllocationTracker::watch(
+	char const* name, void const* spm, AllocationTracker::WatchFunc* max,
+	AllocationTracker::WatchFunc* chunks, AllocationTracker::WatchFunc* spills) noexcept
+{
+	stored_assert(spm && max && chunks && spills);
+
+	tracker_lock();
+
+	TrackerWatch* w = nullptr;
+	for(size_t i = 0; i < (size_t)MaxWatches; i++) {
+		if(tracker_watches[i].spm == spm) {
+			// Already registered; update.
+			w = &tracker_watches[i];
+			break;
+		}
+
+		if(!w && !tracker_watches[i].spm)
+			w = &tracker_watches[i];
+	}
+
+	if(w) {
+		w->name = name;
+		w->spm = spm;
+		w->max = max;
+		w->chunks = chunks;
+		w->spills = spills;
+	}
+
+	tracker_unlock();
+	return w != nullptr;
+}
+
+/*!
+ * \brief Remove the given ScratchPad, which was registered by #watch().
+ */
+void AllocationTracker::unwatch(void const* spm) noexcept
+{
+	tracker_lock();
+
+	for(size_t i = 0; i < (size_t)MaxWatches; i++)
+		if(tracker_watches[i].spm == spm)
+			tracker_watches[i].spm = nullptr;
+
+	tracker_unlock();
+}
+
+/*!
+ * \brief Print all statistics to the given file.
+ */
+void AllocationTracker::report(FILE* f)
+{
+	if(!f)
+		return;
+
+	fprintf(f, "%-14s %10s %10s %12s %10s\n", "category", "allocs", "frees", "bytes", "realtime");
+
+	for(int c = 0; c < CategoryCount; c++) {
+		Stats s = stats((Category)c);
+		fprintf(f, "%-14s %10zu %10zu %12zu %10zu\n", name((Category)c), s.allocations,
+			s.deallocations, s.bytes, s.realTime);
+	}
+
+	Stats s = total();
+	fprintf(f, "%-14s %10zu %10zu %12zu %10zu\n", "total", s.allocations, s.deallocations,
+		s.bytes, s.realTime);
+	fprintf(f, "in use: %zu bytes, peak: %zu bytes\n", inUse(), peak());
+
+	for(size_t i = 0; i < (size_t)MaxWatches; i++) {
+		// Query the ScratchPad under the lock, as unwatch() is called
+		// just before it is destroyed.
+		tracker_lock();
+		TrackerWatch const& w = tracker_watches[i];
+		void const* spm = w.spm;
+		char const* name = w.name ? w.name : "";
+		size_t max = spm ? w.max(spm) : 0;
+		size_t chunks = spm ? w.chunks(spm) : 0;
+		size_t spills = spm ? w.spills(spm) : 0;
+		tracker_unlock();
+
+		if(spm)
+			fprintf(f, "scratchpad %s %p: max %zu bytes, %zu chunks, %zu spills\n",
+				name, spm, max, chunks, spills);
+	}
+}
+
+} // namespace stored
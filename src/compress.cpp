@@ -11,6 +11,15 @@ extern "C" {
 #	include <heatshrink_encoder.h>
 }
 
+#	include <algorithm>
+#	include <cstring>
+
+#	ifdef STORED_OS_POSIX
+#		include <time.h>
+#	elif STORED_cplusplus >= 201103L
+#		include <chrono>
+#	endif
+
 /*!
  * \brief Helper to get a \c heatshrink_encoder reference from \c CompressLayer::m_encoder.
  */
@@ -31,6 +40,44 @@ static heatshrink_decoder& decoder_(void* d)
 }
 #	define decoder() (decoder_(m_decoder)) // NOLINT(cppcoreguidelines-macro-usage)
 
+/*!
+ * \brief Monotonic time in nanoseconds, or 0 when not supported.
+ */
+static uint64_t now_ns() noexcept
+{
+#	ifdef STORED_OS_POSIX
+	struct timespec ts = {};
+	if(clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+
+	return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+#	elif STORED_cplusplus >= 201103L
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+#	else
+	return 0;
+#	endif
+}
+
+/*!
+ * \brief Append the given buffer to the window, and drop the oldest data.
+ */
+static void slide(stored::Vector<uint8_t>::type& window, void const* buffer, size_t len)
+{
+	size_t const size = 1U << stored::CompressLayer::Window;
+	uint8_t const* b = static_cast<uint8_t const*>(buffer);
+
+	if(len >= size) {
+		window.assign(b + len - size, b + len);
+		return;
+	}
+
+	size_t keep = std::min(window.size(), size - len);
+	window.erase(window.begin(), window.end() - (std::ptrdiff_t)keep);
+	window.insert(window.end(), b, b + len);
+}
+
 namespace stored {
 
 /*!
@@ -42,6 +89,15 @@ CompressLayer::CompressLayer(ProtocolLayer* up, ProtocolLayer* down)
 	, m_decoder()
 	, m_decodeBufferSize()
 	, m_state()
+	, m_dictionary()
+	, m_dictionaryLen()
+	, m_history()
+	, m_adaptive()
+	, m_ratio()
+	, m_sinceProbe()
+	, m_timing()
+	, m_encodeStart()
+	, m_stats()
 {}
 
 /*!
@@ -63,6 +119,28 @@ void CompressLayer::decode(void* buffer, size_t len)
 	if(!buffer || !len)
 		return;
 
+	uint64_t start = timestamp();
+	m_stats.decodeIn += len;
+
+	uint8_t* in_buf = static_cast<uint8_t*>(buffer);
+
+	if(m_adaptive) {
+		uint8_t header = *in_buf++;
+		len--;
+
+		switch(header) {
+		case HeaderStored:
+			m_stats.decodeTime_ns += timestamp() - start;
+			decodeStored(in_buf, len);
+			return;
+		case HeaderCompressed:
+			break;
+		default:
+			// Unknown header; drop the message.
+			return;
+		}
+	}
+
 	if(unlikely(!m_decoder)) {
 		m_decoder = heatshrink_decoder_alloc(DecodeInputBuffer, Window, Lookahead);
 		if(!m_decoder) {
@@ -72,13 +150,16 @@ void CompressLayer::decode(void* buffer, size_t len)
 			std::terminate();
 #	endif
 		}
+	} else {
+		// Drop the state of the previous message, including any padding bits.
+		heatshrink_decoder_reset(&decoder());
 	}
 
+	prime(false);
 	m_state |= (uint8_t)FlagDecoding;
 
 	m_decodeBufferSize = 0;
 
-	uint8_t* in_buf = static_cast<uint8_t*>(buffer);
 	while(len > 0) {
 		size_t sunk = 0;
 		HSD_sink_res res = heatshrink_decoder_sink(&decoder(), in_buf, len, &sunk);
@@ -94,10 +175,32 @@ void CompressLayer::decode(void* buffer, size_t len)
 	while(heatshrink_decoder_finish(&decoder()) == HSDR_FINISH_MORE)
 		decoderPoll();
 
+	// Save the history before the layer above may modify the buffer.
+	if(m_history)
+		slide(m_decodeWindow, m_decodeBuffer.data(), m_decodeBufferSize);
+
+	m_stats.decodeOut += m_decodeBufferSize;
+	m_stats.decodeTime_ns += timestamp() - start;
+
 	base::decode(m_decodeBuffer.data(), m_decodeBufferSize);
 	m_state &= (uint8_t) ~(uint8_t)FlagDecoding;
 }
 
+/*!
+ * \brief Pass a message upstream that was not compressed in adaptive mode.
+ */
+void CompressLayer::decodeStored(void* buffer, size_t len)
+{
+	m_state |= (uint8_t)FlagDecoding;
+
+	if(m_history)
+		slide(m_decodeWindow, buffer, len);
+
+	m_stats.decodeOut += len;
+	base::decode(buffer, len);
+	m_state &= (uint8_t) ~(uint8_t)FlagDecoding;
+}
+
 /*!
  * \brief Check if there is data to be extracted from the decoder.
  */
@@ -131,18 +234,52 @@ void CompressLayer::encode(void const* buffer, size_t len, bool last)
 {
 	stored_assert(len == 0 || buffer);
 
-	if(unlikely(!m_encoder)) {
-		m_encoder = heatshrink_encoder_alloc(Window, Lookahead);
-		if(!m_encoder) {
+	m_encodeStart = timestamp();
+	m_stats.encodeIn += len;
+
+	if(!(m_state & (uint8_t)FlagEncoding)) {
+		// Start of a new message.
+		m_state |= (uint8_t)FlagEncoding;
+		m_stats.messages++;
+
+		if(m_adaptive && m_ratio >= (unsigned int)RatioScale
+		   && ++m_sinceProbe < (unsigned int)ProbeInterval) {
+			// Recent messages did not compress. Do not even try.
+			m_state |= (uint8_t)FlagSkipping;
+			m_stats.skipped++;
+			uint8_t header = HeaderStored;
+			encodeDown(&header, 1, false);
+		} else {
+			if(unlikely(!m_encoder)) {
+				m_encoder = heatshrink_encoder_alloc(Window, Lookahead);
+				if(!m_encoder) {
 #	ifdef STORED_cpp_exceptions
-			throw std::bad_alloc();
+					throw std::bad_alloc();
 #	else
-			std::terminate();
+					std::terminate();
 #	endif
+				}
+			}
+
+			prime(true);
 		}
 	}
 
-	m_state |= (uint8_t)FlagEncoding;
+	if(m_history && len)
+		slide(m_encodeWindow, buffer, len);
+
+	if(m_state & (uint8_t)FlagSkipping) {
+		encodeDown(buffer, len, last);
+		if(last)
+			m_state &= (uint8_t) ~(uint8_t)(FlagEncoding | FlagSkipping);
+		m_stats.encodeTime_ns += timestamp() - m_encodeStart;
+		return;
+	}
+
+	if(m_adaptive && len) {
+		uint8_t const* b = static_cast<uint8_t const*>(buffer);
+		m_encodeBuffer.insert(m_encodeBuffer.end(), b, b + len);
+	}
 
 	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast)
 	uint8_t* in_buf = (uint8_t*)buffer;
@@ -162,10 +299,54 @@ void CompressLayer::encode(void const* buffer, size_t len, bool last)
 	if(last) {
 		while(heatshrink_encoder_finish(&encoder()) == HSER_FINISH_MORE)
 			encoderPoll();
-		base::encode(nullptr, 0, true);
 		heatshrink_encoder_reset(&encoder());
+
+		if(!m_adaptive) {
+			encodeDown(nullptr, 0, true);
+		} else {
+			size_t in = m_encodeBuffer.size();
+			size_t out = m_encodeOutput.size();
+
+			if(in > 0) {
+				// Update the estimated ratio.
+				unsigned int sample = (unsigned int)std::min<uint64_t>(
+					(uint64_t)out * RatioScale / in, 2U * RatioScale);
+				m_ratio = m_ratio - (m_ratio >> RatioWeight) + (sample >> RatioWeight);
+			}
+			m_sinceProbe = 0;
+
+			// Send whatever is smaller.
+			uint8_t header = out < in ? HeaderCompressed : HeaderStored;
+			encodeDown(&header, 1, false);
+
+			if(header == HeaderCompressed) {
+				encodeDown(m_encodeOutput.data(), out, true);
+			} else {
+				m_stats.stored++;
+				encodeDown(m_encodeBuffer.data(), in, true);
+			}
+
+			m_encodeBuffer.clear();
+			m_encodeOutput.clear();
+		}
+
 		m_state &= (uint8_t) ~(uint8_t)FlagEncoding;
 	}
+
+	m_stats.encodeTime_ns += timestamp() - m_encodeStart;
+}
+
+/*!
+ * \brief Pass encoded data to the layer below.
+ *
+ * The time spent below is not accounted as compression time.
+ */
+void CompressLayer::encodeDown(void const* buffer, size_t len, bool last)
+{
+	m_stats.encodeTime_ns += timestamp() - m_encodeStart;
+	m_stats.encodeOut += len;
+	base::encode(buffer, len, last);
+	m_encodeStart = timestamp();
 }
 
 /*!
@@ -180,8 +361,13 @@ void CompressLayer::encoderPoll()
 		HSE_poll_res res =
 			heatshrink_encoder_poll(&encoder(), out_buf, sizeof(out_buf), &output_size);
 
-		if(output_size > 0)
-			base::encode(out_buf, output_size, false);
+		if(output_size > 0) {
+			if(m_adaptive)
+				m_encodeOutput.insert(
+					m_encodeOutput.end(), out_buf, out_buf + output_size);
+			else
+				encodeDown(out_buf, output_size, false);
+		}
 
 		switch(res) {
 		case HSER_POLL_EMPTY:
@@ -214,6 +400,213 @@ bool CompressLayer::idle() const
 	return m_state == 0;
 }
 
+/*!
+ * \brief Prime the window of the encoder and decoder with the given dictionary.
+ *
+ * Every message is compressed as if the dictionary was sent just before it.
+ * Therefore, (partial) strings in a message that also occur in the
+ * dictionary are replaced by a back-reference, which makes even short
+ * messages compress well.  Only the last <tt>1 << Window</tt> bytes of the
+ * dictionary are used.  The dictionary is not copied; the buffer must
+ * remain valid during the lifetime of this layer.
+ *
+ * The other side of the connection must use the same dictionary.
+ * Pass \c nullptr or a zero length to disable the dictionary.
+ *
+ * This also resets the history. Do not call this function while a message
+ * is being encoded.
+ */
+void CompressLayer::setDictionary(void const* dictionary, size_t len)
+{
+	stored_assert(dictionary || !len);
+
+	size_t const size = 1U << Window;
+	if(len > size) {
+		dictionary = static_cast<uint8_t const*>(dictionary) + len - size;
+		len = size;
+	}
+
+	m_dictionary = static_cast<uint8_t const*>(dictionary);
+	m_dictionaryLen = dictionary ? len : 0;
+	resetHistory();
+}
+
+/*!
+ * \brief Prime the window with the previous messages.
+ *
+ * When enabled, every message is compressed as if the dictionary (see
+ * #setDictionary()) and all previous messages in the same direction were
+ * sent just before it.  This works well when messages are repetitive,
+ * but requires that the other side gets all messages in the same order,
+ * without loss.  Use #resetHistory() to start over, e.g. after a
+ * reconnect.
+ *
+ * This also resets the history. Do not call this function while a message
+ * is being encoded.
+ */
+void CompressLayer::setHistory(bool enable)
+{
+	m_history = enable;
+	resetHistory();
+}
+
+/*!
+ * \brief Returns if the previous messages prime the window.
+ * \see #setHistory()
+ */
+bool CompressLayer::history() const
+{
+	return m_history;
+}
+
+/*!
+ * \brief Returns if the window is primed with a dictionary or history.
+ */
+bool CompressLayer::primed() const
+{
+	return m_history || m_dictionaryLen > 0;
+}
+
+/*!
+ * \brief Forget the previous messages, and only use the dictionary to prime the window.
+ */
+void CompressLayer::resetHistory()
+{
+	stored_assert(!(m_state & (uint8_t)FlagEncoding));
+
+	if(m_history) {
+		size_t const size = 1U << Window;
+		m_encodeWindow.reserve(size);
+		m_decodeWindow.reserve(size);
+	}
+
+	m_encodeWindow.assign(m_dictionary, m_dictionary + m_dictionaryLen);
+	m_decodeWindow.assign(m_dictionary, m_dictionary + m_dictionaryLen);
+}
+
+/*!
+ * \brief Send every message either compressed or as-is, whatever is smaller.
+ *
+ * In this mode, every encoded message starts with a header byte:
+ * #HeaderCompressed or #HeaderStored.  The whole message is buffered, as
+ * the choice can only be made afterwards.
+ *
+ * Moreover, the compression ratio is estimated over the recent messages.
+ * When it indicates that messages do not shrink, compression is not tried,
+ * except for one in every #ProbeInterval messages, to detect that the data
+ * compresses again.  The messages are passed down immediately then.
+ *
+ * Do not call this function while a message is being encoded.
+ */
+void CompressLayer::setAdaptive(bool enable)
+{
+	stored_assert(!(m_state & (uint8_t)FlagEncoding));
+	m_adaptive = enable;
+	m_ratio = 0;
+	m_sinceProbe = 0;
+}
+
+/*!
+ * \brief Returns if adaptive mode is enabled.
+ * \see #setAdaptive()
+ */
+bool CompressLayer::adaptive() const
+{
+	return m_adaptive;
+}
+
+/*!
+ * \brief Measure the time spent in compression and decompression.
+ *
+ * This reads the clock a few times per message, which is not for free.
+ * Therefore, it is disabled by default, and the time statistics remain
+ * zero then.
+ *
+ * Do not call this function while a message is being encoded.
+ *
+ * \see #stats()
+ */
+void CompressLayer::setTiming(bool enable)
+{
+	stored_assert(!(m_state & (uint8_t)FlagEncoding));
+	m_timing = enable;
+}
+
+/*!
+ * \brief Returns if the time spent in compression and decompression is measured.
+ * \see #setTiming()
+ */
+bool CompressLayer::timing() const
+{
+	return m_timing;
+}
+
+/*!
+ * \brief Returns the current time in ns when #timing() is enabled, or 0 otherwise.
+ */
+uint64_t CompressLayer::timestamp() const
+{
+	return m_timing ? now_ns() : 0;
+}
+
+/*!
+ * \brief Returns the statistics.
+ *
+ * The overall compression ratio is \c encodeOut / \c encodeIn.
+ */
+CompressLayer::Stats const& CompressLayer::stats() const
+{
+	return m_stats;
+}
+
+/*!
+ * \brief Reset all #stats() to zero.
+ */
+void CompressLayer::resetStats()
+{
+	m_stats = Stats();
+}
+
+/*!
+ * \brief Returns the estimated compression ratio of the recent messages, scaled by #RatioScale.
+ *
+ * This is only updated in adaptive mode. A value of #RatioScale or higher
+ * means that the messages do not shrink.
+ */
+unsigned int CompressLayer::ratio() const
+{
+	return m_ratio;
+}
+
+/*!
+ * \brief Copy the priming data into the (just reset) window of the encoder or decoder.
+ */
+void CompressLayer::prime(bool encoding)
+{
+	size_t const size = 1U << Window;
+
+	if(encoding) {
+		if(m_encodeWindow.empty())
+			return;
+
+		// The buffer of the encoder consists of the window, followed by the
+		// input. The window ends just before the first input byte.
+		stored_assert(m_encodeWindow.size() <= size);
+		memcpy(&encoder().buffer[size - m_encodeWindow.size()], m_encodeWindow.data(),
+		       m_encodeWindow.size());
+	} else {
+		if(m_decodeWindow.empty())
+			return;
+
+		// The buffers of the decoder consist of the input buffer, followed
+		// by a circular window. After a reset, the head is at the start of
+		// the window, so the most recent data is at the end.
+		stored_assert(m_decodeWindow.size() <= size);
+		memcpy(&decoder().buffers[DecodeInputBuffer + size - m_decodeWindow.size()],
+		       m_decodeWindow.data(), m_decodeWindow.size());
+	}
+}
+
 } // namespace stored
 #else  // !STORED_HAVE_HEATSHRINK
 char dummy_char_to_make_compress_cpp_non_empty; // NOLINT
@@ -48,13 +48,27 @@ Debugger::Debugger(char const* identification, char const* versions)
 	, m_traceStream()
 	, m_traceDecimate()
 	, m_traceCount()
-{}
+	, m_traceKey()
+	, m_publisher()
+	, m_streamDictionary()
+	, m_streamDictionaryLen()
+{
+#if STORED_cplusplus >= 201103L
+	m_scratchpadPool = nullptr;
+#endif
+
+	if(Config::TrackAllocations)
+		AllocationTracker::watch("debugger", m_scratchpad);
+}
 
 /*!
  * \brief Destructor.
  */
 Debugger::~Debugger() noexcept
 {
+	if(Config::TrackAllocations)
+		AllocationTracker::unwatch(&m_scratchpad);
+
 	for(StoreMap::iterator it = m_map.begin(); it != m_map.end(); ++it)
 		delete it->second; // NOLINT(cppcoreguidelines-owning-memory)
 	for(StreamMap::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
@@ -145,6 +159,8 @@ gotit:
  */
 void Debugger::map(DebugStoreBase* store, char const* name)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryDebugger);
+
 	if(!name && store)
 		name = store->name();
 
@@ -252,7 +268,7 @@ void Debugger::list(ListCallbackArg* f, void* arg) const
  */
 void Debugger::capabilities(char*& caps, size_t& len, size_t reserve)
 {
-	size_t const maxlen = 16;
+	size_t const maxlen = 20;
 	caps = spm().alloc<char>(maxlen + reserve);
 	len = 0;
 
@@ -282,10 +298,17 @@ void Debugger::capabilities(char*& caps, size_t& len, size_t reserve)
 		caps[len++] = CmdWriteMem;
 	if(Config::DebuggerStreams > 0 && Config::DebuggerStreamBuffer > 0)
 		caps[len++] = CmdStream;
-	if(Config::DebuggerTrace)
+	if(Config::DebuggerTrace) {
 		caps[len++] = CmdTrace;
+		caps[len++] = CmdTraceCodec;
+	}
 	if(Config::CompressStreams)
 		caps[len++] = CmdFlush;
+	if(Config::DebuggerStreams > 0 && Config::DebuggerStreamBuffer > 0 && m_publisher)
+		caps[len++] = CmdPublish;
+	if(Config::CompressStreams && Config::DebuggerStreams > 0
+	   && Config::DebuggerStreamBuffer > 0)
+		caps[len++] = CmdPrime;
 
 	stored_assert(len < maxlen);
 	caps[len] = 0;
@@ -355,6 +378,58 @@ void Debugger::decode(void* buffer, size_t len)
 	process(buffer, len, *this);
 }
 
+/*!
+ * \brief Finds \p pair in the given list of stream name and tag pairs.
+ * \return the index of the pair in \p pairs, or \p len when not found
+ */
+static size_t findPair(char const* pairs, size_t len, char const* pair)
+{
+	for(size_t i = 0; i + 1 < len; i += 2)
+		if(pairs[i] == pair[0] && pairs[i + 1] == pair[1])
+			return i;
+
+	return len;
+}
+
+/*!
+ * \brief Checks if the given list of stream name and tag pairs contains \p pair.
+ */
+static bool hasPair(char const* pairs, size_t len, char const* pair)
+{
+	return findPair(pairs, len, pair) < len;
+}
+
+#if STORED_cplusplus >= 201103L
+/*!
+ * \brief The ScratchPad leased by this thread from a ScratchPadPool.
+ */
+static STORED_thread_local ScratchPad<>* spm_leased = nullptr;
+
+/*!
+ * \brief Leases a ScratchPad from a pool for the current thread, if it does not have one yet.
+ */
+class ScratchPadLease {
+	STORED_CLASS_NOCOPY(ScratchPadLease)
+public:
+	explicit ScratchPadLease(ScratchPadPool<>* pool)
+	{
+		if(pool && !spm_leased) {
+			m_lease = pool->acquire();
+			spm_leased = &m_lease.spm();
+		}
+	}
+
+	~ScratchPadLease() noexcept
+	{
+		if(m_lease.valid())
+			spm_leased = nullptr;
+	}
+
+private:
+	ScratchPadPool<>::Lease m_lease;
+};
+#endif
+
 /*!
  * \brief Process a Embedded %Debugger message.
  * \param frame the frame to decode
@@ -363,9 +438,14 @@ void Debugger::decode(void* buffer, size_t len)
  */
 void Debugger::process(void const* frame, size_t len, ProtocolLayer& response)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryDebugger);
+
 	if(unlikely(!frame || len == 0))
 		return;
 
+#if STORED_cplusplus >= 201103L
+	ScratchPadLease lease(m_scratchpadPool);
+#endif
 	ScratchPad<>::Snapshot snapshot = spm().snapshot();
 
 	char const* p = static_cast<char const*>(frame);
@@ -755,45 +835,7 @@ void Debugger::process(void const* frame, size_t len, ProtocolLayer& response)
 		if(!Config::CompressStreams && tracing() && s == m_traceStream)
 			response.setPurgeableResponse();
 
-		if(Config::AvoidDynamicMemory) {
-			String::type const& strstr = str->buffer();
-
-			// Note that the buffer should not be realloc'ed during
-			// the encode(), which may happen if Zth would do a
-			// yield during the (low-level) encode(), or you would
-			// have some other strange loop in your program.
-			size_t size = strstr.size();
-			if(size) {
-				char const* data = strstr.data();
-				response.encode(data, size, false);
-				// cppcheck-suppress[knownConditionTrueFalse,unmatchedSuppression]
-				stored_assert(data == strstr.data());
-
-				// Note that the buffer may have grown
-				// meanwhile. Only drop the data that we just
-				// encoded.
-				str->drop(size);
-			}
-		} else {
-			// In this case, the buffer may grow arbitrarily.
-			// Swap the buffers...
-			String::type strbuf;
-			str->swap(strbuf);
-			response.encode(strbuf.data(), strbuf.size(), false);
-
-			if(str->buffer().empty()) {
-				// Buffer is empty. Clear and swap again to
-				// avoid useless malloc/free of the internal
-				// buffers of the String.
-				strbuf.clear();
-				str->swap(strbuf);
-			}
-			// else: data was added meanwhile, leave it in that
-			// buffer and release the old one.
-		}
-
-		str->unblock();
-
+		drain(*str, response);
 		response.encode(suffix, suffixlen);
 		return;
 	}
@@ -807,12 +849,16 @@ void Debugger::process(void const* frame, size_t len, ProtocolLayer& response)
 			goto error;
 
 		if(len == 1) {
-			for(StreamMap::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+			for(StreamMap::iterator it = m_streams.begin(); it != m_streams.end(); ++it) {
 				it->second->flush();
+				publish(it->first, true);
+			}
 		} else if(len == 2) {
 			Stream<>* str = stream(p[1]);
-			if(str)
+			if(str) {
 				str->flush();
+				publish(p[1], true);
+			}
 		} else
 			goto error;
 
@@ -845,6 +891,8 @@ void Debugger::process(void const* frame, size_t len, ProtocolLayer& response)
 
 		m_traceMacro = p[1];
 		m_traceStream = p[2];
+		// Start with a key sample.
+		m_traceKey = 0;
 
 		// Make sure the trace stream exists.
 		if(!stream(m_traceStream, true))
@@ -862,6 +910,148 @@ void Debugger::process(void const* frame, size_t len, ProtocolLayer& response)
 			m_traceDecimate = 1;
 		break;
 	}
+	case CmdPublish: {
+		// Push stream data to the publisher
+		// Request: 'p' ( <stream char> <tag char> ) *
+		//
+		// Response: '?' | '!'
+
+		if(Config::DebuggerStreams < 1 || !m_publisher)
+			goto error;
+
+		char const* pairs = &p[1];
+		size_t pairslen = len - 1;
+
+		if(pairslen % 2 || pairslen / 2 > Config::DebuggerStreams)
+			goto error;
+
+		for(size_t i = 0; i < pairslen; i += 2) {
+			if(pairs[i] == '?' || !stream(pairs[i], true))
+				// Cannot allocate.
+				goto error;
+
+			for(size_t j = 0; j < i; j += 2)
+				if(pairs[j] == pairs[i])
+					// Every stream can only have one tag.
+					goto error;
+		}
+
+		// End the streams that are not published with the same tag anymore.
+		for(size_t i = 0; i < m_publish.size(); i += 2) {
+			char s = m_publish[i];
+			if(hasPair(pairs, pairslen, &m_publish[i]))
+				continue;
+
+			Stream<>* str = stream(s);
+			if(str)
+				str->flush();
+
+			publish(s, true);
+		}
+
+		String::type old;
+		old.swap(m_publish);
+		m_publish.append(pairs, pairslen);
+
+		Vector<uint16_t>::type oldSeq;
+		oldSeq.swap(m_publishSeq);
+		m_publishSeq.resize(pairslen / 2, 0);
+
+		// Start the new ones.
+		for(size_t i = 0; i < pairslen; i += 2) {
+			size_t o = findPair(old.data(), old.size(), &pairs[i]);
+			if(o < old.size()) {
+				// Continue the sequence.
+				m_publishSeq[i / 2] = oldSeq[o / 2];
+				continue;
+			}
+
+			if(Config::CompressStreams) {
+				// The client missed the start of the stream. Restart it.
+				Stream<>* str = stream(pairs[i]);
+				if(str) {
+					str->flush();
+					str->clear();
+					if(str->primed())
+						str->prime(m_streamDictionary, m_streamDictionaryLen);
+				}
+				if(pairs[i] == m_traceStream)
+					m_traceKey = 0;
+			} else {
+				// Push out what we have already.
+				publish(pairs[i]);
+			}
+		}
+		break;
+	}
+	case CmdPrime: {
+		// Prime the compression of a stream with a dictionary and its history
+		// Request: 'z' <stream char>
+		//
+		// Response: '?' | '!' <dictionary>
+
+		if(!Config::CompressStreams || Config::DebuggerStreams < 1 || len != 2
+		   || p[1] == '?')
+			goto error;
+
+		Stream<>* str = stream(p[1], true);
+		if(!str)
+			goto error;
+
+		// Restart the stream, and drop all data that was compressed without priming.
+		str->flush();
+		str->clear();
+		str->prime(m_streamDictionary, m_streamDictionaryLen);
+		if(p[1] == m_traceStream)
+			m_traceKey = 0;
+
+		char ack = Ack;
+		response.encode(&ack, 1, false);
+		response.encode(m_streamDictionary, m_streamDictionaryLen, true);
+		return;
+	}
+	case CmdTraceCodec: {
+		// Configure the binary encoding of trace samples
+		// Request: 'c' <field layout> ?
+		//
+		// Response: '?' | '!'
+		//
+		// The layout has one char per command of the trace macro.  Without
+		// layout, the plain macro output is traced.
+
+		if(!Config::DebuggerTrace)
+			goto error;
+
+		for(size_t i = 1; i < len; i++)
+			switch(p[i]) {
+			case TraceFieldSkip:
+			case TraceFieldRaw:
+			case TraceFieldInt:
+			case TraceFieldFloat:
+			case TraceFieldDouble:
+				break;
+			default:
+				goto error;
+			}
+
+		m_traceLayout.clear();
+		m_traceLayout.append(&p[1], len - 1);
+		m_traceState.clear();
+		m_traceState.resize(m_traceLayout.size() * 2U, 0);
+		m_traceKey = 0;
+
+		// Drop all samples that were encoded differently.
+		if(tracing()) {
+			Stream<>* str = stream(m_traceStream);
+			if(str) {
+				str->flush();
+				str->clear();
+				if(str->primed())
+					str->prime(m_streamDictionary, m_streamDictionaryLen);
+			}
+		}
+		break;
+	}
 	default:
 		// Unknown command.
 
@@ -1115,12 +1305,50 @@ bool Debugger::decodeHex(Type::type type, void const*& data, size_t& len)
 
 /*!
  * \brief Returns a scratch pad memory.
+ *
+ * While processing a request, this is the ScratchPad that is leased from
+ * the #scratchPadPool(), if any.
  */
 ScratchPad<>& Debugger::spm() const
 {
+#if STORED_cplusplus >= 201103L
+	if(m_scratchpadPool && spm_leased)
+		return *spm_leased;
+#endif
+
 	return m_scratchpad;
 }
 
+#if STORED_cplusplus >= 201103L
+/*!
+ * \brief Use the given pool for scratch memory.
+ *
+ * By default, the Debugger uses its own ScratchPad, which makes concurrent
+ * calls to #process() unsafe. When a pool is set, #process() leases an
+ * arena for the calling thread, such that multiple Debugger instances in
+ * different threads can share the pool, and the memory is bound to the
+ * number of concurrent requests, instead of the number of Debuggers.
+ *
+ * Note that only the scratch memory is thread-safe this way; the other
+ * state of the Debugger, like streams and the trace configuration, is not.
+ *
+ * The pool must outlive the Debugger, or it must be reset before the pool
+ * is destroyed.
+ */
+void Debugger::setScratchPadPool(ScratchPadPool<>* pool)
+{
+	m_scratchpadPool = pool;
+}
+
+/*!
+ * \brief Returns the pool set by #setScratchPadPool().
+ */
+ScratchPadPool<>* Debugger::scratchPadPool() const
+{
+	return m_scratchpadPool;
+}
+#endif
+
 /*!
  * \brief #list() callback for processing #CmdList.
  */
@@ -1190,6 +1418,7 @@ size_t Debugger::stream(char s, char const* data, size_t len)
 		return 0;
 
 	str->encode(data, len);
+	publish(s);
 	return len;
 }
 
@@ -1213,6 +1442,8 @@ Stream<> const* Debugger::stream(char s) const
  */
 Stream<>* Debugger::stream(char s, bool alloc)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryDebugger);
+
 	StreamMap::iterator it = m_streams.find(s);
 
 	if(it != m_streams.end()) {
@@ -1226,8 +1457,9 @@ Stream<>* Debugger::stream(char s, bool alloc)
 			cleaned = false;
 			for(StreamMap::iterator it2 = m_streams.begin(); it2 != m_streams.end();
 			    ++it2)
-				if(it2->second->empty()) {
-					// Got one.
+				if(it2->second->empty() && !it2->second->primed()) {
+					// Got one. Primed streams are not recycled, as
+					// the client depends on their history.
 					if(!recycle) {
 						recycle = it2->second;
 					} else {
@@ -1289,6 +1521,8 @@ char const* Debugger::streams(void const*& buffer, size_t& len)
  */
 void Debugger::trace()
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryDebugger);
+
 	if(!tracing())
 		return;
 
@@ -1318,7 +1552,11 @@ void Debugger::trace()
 
 	// Note that runMacro() may overrun the defined maximum buffer size,
 	// but samples are never truncated.
-	runMacro(m_traceMacro, *str);
+	if(m_traceLayout.empty())
+		runMacro(m_traceMacro, *str);
+	else
+		traceSample(*str);
+	publish(m_traceStream);
 	// If runMacro() returns false, the macro does not exist, and the Stream
 	// is untouched, or there was an error while executing it. If the Stream
 	// is compressed, the internal state cannot be restored once the first
@@ -1329,6 +1567,230 @@ void Debugger::trace()
 	// Success.
 }
 
+namespace {
+/*!
+ * \brief Helper layer to collect the response of one command.
+ */
+class FieldCollector : public ProtocolLayer {
+	STORED_CLASS_NOCOPY(FieldCollector)
+public:
+	typedef ProtocolLayer base;
+
+	explicit FieldCollector(String::type& buffer)
+		: m_buffer(&buffer)
+	{
+		m_buffer->clear();
+	}
+
+	void encode(void const* buffer, size_t len, bool last = true) final
+	{
+		STORED_UNUSED(last)
+		m_buffer->append(static_cast<char const*>(buffer), len);
+	}
+
+	using base::encode;
+
+	void setPurgeableResponse(bool purgeable = true) final
+	{
+		STORED_UNUSED(purgeable)
+	}
+
+private:
+	String::type* m_buffer;
+};
+} // namespace
+
+/*!
+ * \brief Execute the trace macro, and encode its output binary in the given stream.
+ *
+ * Every sample starts with #TraceKey or #TraceDelta.  A key sample resets the
+ * codec state, such that a client can start decoding from there.  Then, every
+ * command of the macro is encoded as a field, according to #m_traceLayout.
+ *
+ * \return \c false when the macro does not exist
+ * \see #traceField()
+ */
+bool Debugger::traceSample(Stream<>& str)
+{
+	MacroMap::iterator it = macros().find(m_traceMacro);
+
+	if(it == macros().end() || it->second.size() < 2)
+		// Unknown macro, recursive call, or nothing to execute.
+		return false;
+
+	// Mark macro as in use, like runMacro() does.
+	String::type& definition = it->second;
+	String::type definition_;
+	definition.swap(definition_);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+	String::type const& def = const_cast<String::type const&>(definition_);
+
+	char sep = def[0];
+
+	char header = TraceDelta;
+	if(m_traceKey == 0) {
+		header = TraceKey;
+		std::fill(m_traceState.begin(), m_traceState.end(), 0);
+		m_traceKey = TraceKeyInterval;
+	}
+
+	m_traceKey--;
+	str.encode(&header, 1, false);
+
+	size_t pos = 0;
+	size_t field = 0;
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-do-while)
+	do {
+		size_t nextpos = def.find(sep, ++pos);
+		size_t len = 0;
+		if(nextpos == String::type::npos)
+			len = def.size() - pos;
+		else
+			len = nextpos - pos;
+
+		{
+			FieldCollector collector(m_traceField);
+			process(&def[pos], len, collector);
+		}
+
+		char kind = TraceFieldRaw;
+		if(field < m_traceLayout.size())
+			kind = m_traceLayout[field];
+
+		traceField(kind, field, str);
+		field++;
+		pos = nextpos;
+	} while(pos != String::type::npos);
+
+	str.encode();
+
+	// Restore recursion protection.
+	definition.swap(definition_);
+	return true;
+}
+
+/*!
+ * \brief Write a LEB128 varint to the given buffer.
+ * \return the number of bytes written, which is at most 10
+ */
+static size_t encodeVarint(uint8_t* buf, uint64_t value)
+{
+	size_t len = 0;
+	for(; value >= 0x80U; value >>= 7U)
+		buf[len++] = (uint8_t)(value | 0x80U);
+	buf[len++] = (uint8_t)value;
+	return len;
+}
+
+/*!
+ * \brief Parse ASCII hex, as produced by #Debugger::encodeHex().
+ *
+ * Only when the exact text can be reconstructed from the value, parsing
+ * succeeds.
+ *
+ * \param width the number of digits, or 0 for the shortest notation of integers
+ */
+static bool parseTraceHex(String::type const& s, size_t width, uint64_t& value)
+{
+	size_t len = s.size();
+	if(width ? len != width : (len == 0 || len > 16 || (len > 1 && s[0] == '0')))
+		return false;
+
+	value = 0;
+	for(size_t i = 0; i < len; i++) {
+		char c = s[i];
+		uint64_t n = 0;
+		if(c >= '0' && c <= '9')
+			n = (uint64_t)(c - '0');
+		else if(c >= 'a' && c <= 'f')
+			n = (uint64_t)(c - 'a' + 10);
+		else
+			return false;
+		value = (value << 4U) | n;
+	}
+
+	return true;
+}
+
+/*!
+ * \brief Encode the response of one command of the trace macro into the stream.
+ *
+ * The response is in #m_traceField.  The field kinds are:
+ *
+ * - #TraceFieldSkip: the field is not sent at all, as the client knows it
+ *   already, like the output of an echo command.
+ * - #TraceFieldRaw: varint length, followed by the response.
+ * - #TraceFieldInt: the delta-of-delta of the value, zigzag encoded, plus
+ *   1, as varint.  A varint 0 escapes to a raw field and resets the state.
+ * - #TraceFieldFloat, #TraceFieldDouble: the XOR with the previous value
+ *   of 8 or 16 hex digits, respectively.  The byte 0x40 means
+ *   equal to the previous value; 0-63 is the number of trailing zero bits of
+ *   the XOR, followed by the remaining bits as varint.  The byte 0x41
+ *   escapes to a raw field and resets the state.
+ *
+ * The numbers are the ASCII hex responses of the read command.  Varints are
+ * LEB128 encoded.
+ */
+void Debugger::traceField(char kind, size_t field, Stream<>& str)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays)
+	uint8_t buf[24];
+	size_t len = 0;
+	uint64_t value = 0;
+	uint64_t* state = field * 2U < m_traceState.size() ? &m_traceState[field * 2U] : nullptr;
+
+	switch(kind) {
+	case TraceFieldSkip:
+		return;
+	case TraceFieldInt:
+		if(state && parseTraceHex(m_traceField, 0, value)) {
+			uint64_t delta = value - state[0];
+			uint64_t dd = delta - state[1];
+			uint64_t zigzag = (dd << 1U) ^ (0U - (dd >> 63U));
+			if(zigzag != ~(uint64_t)0) {
+				state[0] = value;
+				state[1] = delta;
+				len = encodeVarint(buf, zigzag + 1U);
+				str.encode(buf, len, false);
+				return;
+			}
+		}
+
+		if(state)
+			state[0] = state[1] = 0;
+		buf[len++] = 0;
+		break;
+	case TraceFieldFloat:
+	case TraceFieldDouble:
+		if(state && parseTraceHex(m_traceField, kind == TraceFieldFloat ? 8U : 16U, value)) {
+			uint64_t x = value ^ state[0];
+			state[0] = value;
+			if(!x) {
+				buf[len++] = 0x40U;
+			} else {
+				uint8_t tz = 0;
+				for(; !(x & 1U); x >>= 1U, tz++)
+					;
+				buf[len++] = tz;
+				len += encodeVarint(&buf[len], x);
+			}
+			str.encode(buf, len, false);
+			return;
+		}
+
+		if(state)
+			state[0] = 0;
+		buf[len++] = 0x41U;
+		break;
+	case TraceFieldRaw:
+	default:;
+	}
+
+	len += encodeVarint(&buf[len], (uint64_t)m_traceField.size());
+	str.encode(buf, len, false);
+	str.encode(m_traceField.data(), m_traceField.size(), false);
+}
+
 /*!
  * \brief Checks if tracing is currently enabled and configured.
  */
@@ -1337,4 +1799,198 @@ bool Debugger::tracing() const
 	return Config::DebuggerTrace && m_traceDecimate > 0;
 }
 
+/*!
+ * \brief Encode all data of the given stream to \p out, and remove it from the stream.
+ *
+ * The data is encoded as a partial message; the caller must finish it.
+ * The stream is unblocked afterwards.
+ */
+void Debugger::drain(Stream<>& str, ProtocolLayer& out)
+{
+	if(Config::AvoidDynamicMemory) {
+		String::type const& strstr = str.buffer();
+
+		// Note that the buffer should not be realloc'ed during
+		// the encode(), which may happen if Zth would do a
+		// yield during the (low-level) encode(), or you would
+		// have some other strange loop in your program.
+		size_t size = strstr.size();
+		if(size) {
+			char const* data = strstr.data();
+			out.encode(data, size, false);
+			// cppcheck-suppress[knownConditionTrueFalse,unmatchedSuppression]
+			stored_assert(data == strstr.data());
+
+			// Note that the buffer may have grown
+			// meanwhile. Only drop the data that we just
+			// encoded.
+			str.drop(size);
+		}
+	} else {
+		// In this case, the buffer may grow arbitrarily.
+		// Swap the buffers...
+		String::type strbuf;
+		str.swap(strbuf);
+		out.encode(strbuf.data(), strbuf.size(), false);
+
+		if(str.buffer().empty()) {
+			// Buffer is empty. Clear and swap again to
+			// avoid useless malloc/free of the internal
+			// buffers of the String.
+			strbuf.clear();
+			str.swap(strbuf);
+		}
+		// else: data was added meanwhile, leave it in that
+		// buffer and release the old one.
+	}
+
+	str.unblock();
+}
+
+/*!
+ * \brief Set the layer to push stream data to.
+ *
+ * Normally, a client polls the streams using the \c s command. When a
+ * publisher is set, a client can request with the \c p command to push the
+ * data of specific streams to this layer, as soon as it is available.
+ * Every message to the publisher is:
+ *
+ * \code
+ * <stream char> <tag char> <sequence number> <stream data>
+ * \endcode
+ *
+ * The tag is chosen by the client. When the stream is flushed, or when it is
+ * not published anymore with a specific tag, the end of the data is marked by
+ * a message without stream data. A client can restart decompression
+ * afterwards. Usually, the publisher is a #stored::DebugZmqPubLayer.
+ *
+ * The sequence number is 16-bit in 4 hex digits. It starts at 0 for a new
+ * tag, and is incremented for every message, including the end markers. The
+ * publisher may drop messages, for example when a subscriber does not keep up,
+ * or has not subscribed yet. As (compressed) stream data cannot be decoded
+ * after a lost message, the client should publish the stream with a new tag
+ * when it detects a gap in the sequence, which restarts the stream.
+ *
+ * \param publisher the layer, or \c nullptr to disable publishing
+ */
+void Debugger::setPublisher(ProtocolLayer* publisher)
+{
+	m_publisher = publisher;
+	if(!publisher) {
+		m_publish.clear();
+		m_publishSeq.clear();
+	}
+}
+
+/*!
+ * \brief Returns the publisher, as set by #setPublisher().
+ */
+ProtocolLayer* Debugger::publisher() const
+{
+	return m_publisher;
+}
+
+/*!
+ * \brief Push all available data of the given stream to the #publisher().
+ *
+ * This is done automatically when data is added by #stream(char, char
+ * const*, size_t) or #trace(). Call this function when data is added to the
+ * stream by other means.
+ *
+ * Nothing is done when the stream is not published.
+ *
+ * \param s the stream name
+ * \param end when \c true, the end of the (compressed) data is marked by an
+ *	empty message afterwards
+ */
+void Debugger::publish(char s, bool end)
+{
+	if(likely(m_publish.empty() || !m_publisher))
+		return;
+
+	for(size_t i = 0; i < m_publish.size(); i += 2) {
+		if(m_publish[i] != s)
+			continue;
+
+		Stream<>* str = stream(s);
+
+		if(!str) {
+			// Not allocated (anymore).
+		} else if(str->buffer().empty()) {
+			// Nothing to push, but do not leave it blocked by a flush.
+			str->unblock();
+		} else {
+			publishHeader(i, false);
+			drain(*str, *m_publisher);
+			m_publisher->encode();
+		}
+
+		if(end)
+			publishHeader(i, true);
+		return;
+	}
+}
+
+/*!
+ * \brief Encode the header of the next published message of the given pair in #m_publish.
+ *
+ * The header is the stream name, the tag, and the 16-bit sequence number of
+ * the message in hex.
+ */
+void Debugger::publishHeader(size_t index, bool last)
+{
+	stored_assert(index + 1 < m_publish.size() && index / 2 < m_publishSeq.size());
+
+	uint16_t seq = m_publishSeq[index / 2]++;
+
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays)
+	char const header[6] = {
+		m_publish[index],
+		m_publish[index + 1],
+		encodeNibble((uint8_t)(seq >> 12U)),
+		encodeNibble((uint8_t)(seq >> 8U)),
+		encodeNibble((uint8_t)(seq >> 4U)),
+		encodeNibble((uint8_t)seq)};
+
+	m_publisher->encode(header, sizeof(header), last);
+}
+
+/*!
+ * \brief Set the dictionary to prime compressed streams with.
+ *
+ * Compressed streams are flushed regularly, after which the compression
+ * starts over with an empty window.  When the client sends the \c z
+ * command for a stream, the window of every new part of that stream is
+ * primed with this dictionary, followed by the data of the previous parts.
+ * This makes short and repetitive stream data, like trace samples,
+ * compress much better.  The client gets the dictionary in the response of
+ * the \c z command.
+ *
+ * Typically, the dictionary holds data that is likely to be in the streams,
+ * like common object names.  Only the last part of the dictionary that
+ * fits in the window of the stored::CompressLayer is used.  The dictionary
+ * is not copied; the buffer must remain valid during the lifetime of the
+ * Debugger.
+ *
+ * This only affects streams that are primed afterwards.
+ *
+ * \param dictionary the dictionary, or \c nullptr to prime with the history only
+ * \param len the length of \p dictionary
+ */
+void Debugger::setStreamDictionary(char const* dictionary, size_t len)
+{
+	stored_assert(dictionary || !len);
+
+#ifdef STORED_HAVE_HEATSHRINK
+	size_t const size = 1U << CompressLayer::Window;
+	if(len > size) {
+		dictionary += len - size;
+		len = size;
+	}
+#endif
+
+	m_streamDictionary = dictionary;
+	m_streamDictionaryLen = dictionary ? len : 0;
+}
+
 } // namespace stored
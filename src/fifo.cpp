@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2020-2023 Jochem Rutgers
+//
+// SPDX-License-Identifier: MPL-2.0
+
+#include <libstored/fifo.h>
+
+#if STORED_cplusplus >= 201103L && defined(STORED_OS_POSIX)
+#	include <algorithm>
+#	include <cerrno>
+#	include <cstdint>
+
+#	include <fcntl.h>
+#	include <poll.h>
+#	include <unistd.h>
+
+#	ifdef STORED_OS_LINUX
+#		include <sys/eventfd.h>
+#	endif
+
+namespace stored {
+
+//////////////////////////////////////////////
+// FifoEvent
+//
+
+FifoEvent::~FifoEvent()
+{
+	close();
+}
+
+int FifoEvent::open() noexcept
+{
+	if(isOpen())
+		return 0;
+
+#	ifdef STORED_OS_LINUX
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(fd < 0)
+		return errno;
+
+	m_fd[0] = m_fd[1] = fd;
+#	else
+	if(pipe(m_fd))
+		return errno;
+
+	for(int i = 0; i < 2; i++) {
+		if(fcntl(m_fd[i], F_SETFL, fcntl(m_fd[i], F_GETFL) | O_NONBLOCK) == -1
+		   || fcntl(m_fd[i], F_SETFD, FD_CLOEXEC) == -1) {
+			int res = errno;
+			close();
+			return res;
+		}
+	}
+#	endif
+
+	m_armed.store(false, std::memory_order_relaxed);
+	m_pending = false;
+	return 0;
+}
+
+void FifoEvent::close() noexcept
+{
+	if(!isOpen())
+		return;
+
+	::close(m_fd[0]);
+	if(m_fd[1] != m_fd[0])
+		::close(m_fd[1]);
+
+	m_fd[0] = m_fd[1] = -1;
+}
+
+int FifoEvent::block(long timeout_us) noexcept
+{
+	struct pollfd fd = {};
+	fd.fd = m_fd[0];
+	fd.events = POLLIN;
+
+	int timeout_ms = -1;
+	if(timeout_us >= 0)
+		// Round up, such that we do not spin with a zero timeout.
+		timeout_ms = (int)std::min<long>((timeout_us + 999L) / 1000L, 0x7fffffffL);
+
+	switch(::poll(&fd, 1, timeout_ms)) {
+	case -1:
+		return errno == EINTR ? 0 : errno;
+	case 0:
+		return EAGAIN;
+	default:
+		if(fd.revents & (POLLERR | POLLNVAL))
+			return EIO;
+		return 0;
+	}
+}
+
+void FifoEvent::signal() noexcept
+{
+#	ifdef STORED_OS_LINUX
+	uint64_t one = 1;
+#	else
+	char one = 1;
+#	endif
+
+	// When this fails with EAGAIN, the fd is readable anyway.
+	ssize_t res = ::write(m_fd[1], &one, sizeof(one));
+	STORED_UNUSED(res)
+}
+
+void FifoEvent::drain() noexcept
+{
+	char buf[sizeof(uint64_t) * 4];
+	// eventfd resets its counter in one read; a pipe may need more.
+	while(::read(m_fd[0], buf, sizeof(buf)) == (ssize_t)sizeof(buf))
+		;
+
+	m_pending = false;
+}
+
+} // namespace stored
+#else  // !POSIX
+char dummy_char_to_make_fifo_cpp_non_empty; // NOLINT
+#endif // POSIX
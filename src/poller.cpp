@@ -4,8 +4,164 @@
 
 #include <libstored/poller.h>
 
+#ifdef STORED_OS_POSIX
+#	include <time.h>
+#	include <unistd.h>
+#elif STORED_cplusplus >= 201103L
+#	include <chrono>
+#endif
+
+#ifdef STORED_OS_LINUX
+#	include <sys/timerfd.h>
+
+#	if defined(__has_include) && !defined(STORED_HAVE_ZTH)
+#		if __has_include(<linux/io_uring.h>)
+#			include <linux/io_uring.h>
+#			include <sys/mman.h>
+#			include <sys/syscall.h>
+#			if defined(IORING_ENTER_EXT_ARG) && defined(IORING_POLL_ADD_MULTI) \
+				&& defined(__NR_io_uring_setup)
+#				define STORED_HAVE_IO_URING
+#			endif
+#		endif
+#	endif
+#endif
+
 namespace stored {
 
+//////////////////////////////////////////////
+// PollableTimer
+//
+
+/*!
+ * \brief Monotonic time in microseconds, or 0 when not supported.
+ */
+static uint64_t now_us() noexcept
+{
+#ifdef STORED_OS_POSIX
+	struct timespec ts = {};
+	if(clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+
+	return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+#elif STORED_cplusplus >= 201103L
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+#else
+	return 0;
+#endif
+}
+
+PollableTimer::PollableTimer(void* user) noexcept
+	: TypedPollable(PollIn, user)
+	, m_fd(-1)
+	, m_deadline_us()
+	, m_interval_us()
+{
+#ifdef STORED_OS_LINUX
+	// On failure, fall back to the generic implementation.
+	m_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+#endif
+}
+
+PollableTimer::~PollableTimer()
+{
+#ifdef STORED_OS_LINUX
+	if(m_fd >= 0)
+		::close(m_fd);
+#endif
+}
+
+int PollableTimer::start(long interval_us, bool periodic, bool aligned) noexcept
+{
+	if(interval_us <= 0)
+		return EINVAL;
+
+	uint64_t now = now_us();
+	if(!now)
+		return ENOSYS;
+
+	uint64_t interval = (uint64_t)interval_us;
+	uint64_t deadline = now + interval;
+
+	if(aligned)
+		// Expire at the next multiple of the interval.
+		deadline -= deadline % interval;
+	if(deadline <= now)
+		deadline += interval;
+
+#ifdef STORED_OS_LINUX
+	if(m_fd >= 0) {
+		struct itimerspec spec = {};
+		uint64_t first = deadline - now;
+		spec.it_value.tv_sec = (time_t)(first / 1000000U);
+		spec.it_value.tv_nsec = (long)(first % 1000000U) * 1000L;
+
+		if(periodic) {
+			spec.it_interval.tv_sec = (time_t)(interval / 1000000U);
+			spec.it_interval.tv_nsec = (long)(interval % 1000000U) * 1000L;
+		}
+
+		if(timerfd_settime(m_fd, 0, &spec, nullptr))
+			return errno;
+	}
+#endif
+
+	m_deadline_us = deadline;
+	m_interval_us = periodic ? interval : 0;
+	return 0;
+}
+
+void PollableTimer::stop() noexcept
+{
+#ifdef STORED_OS_LINUX
+	if(m_fd >= 0) {
+		struct itimerspec spec = {};
+		timerfd_settime(m_fd, 0, &spec, nullptr);
+	}
+#endif
+
+	m_deadline_us = 0;
+}
+
+bool PollableTimer::expired() const noexcept
+{
+	return running() && now_us() >= m_deadline_us;
+}
+
+unsigned long PollableTimer::expirations() noexcept
+{
+	if(!running())
+		return 0;
+
+	uint64_t count = 0;
+
+#ifdef STORED_OS_LINUX
+	if(m_fd >= 0) {
+		// The kernel counts the (missed) expirations.  EAGAIN means none.
+		if(::read(m_fd, &count, sizeof(count)) != (ssize_t)sizeof(count))
+			count = 0;
+	} else
+#endif
+	{
+		uint64_t now = now_us();
+		if(now >= m_deadline_us)
+			count = m_interval_us ? 1U + (now - m_deadline_us) / m_interval_us : 1U;
+	}
+
+	if(!count)
+		return 0;
+
+	if(m_interval_us)
+		m_deadline_us += count * m_interval_us;
+	else
+		m_deadline_us = 0;
+
+	return (unsigned long)count;
+}
+
+
 //////////////////////////////////////////////
 // WfmoPoller
 //
@@ -349,6 +505,9 @@ int ZmqPoller::init(Pollable const& p, zmq_pollitem_t& item) noexcept
 		item.fd = down_cast<PollableFd const&>(tp).fd;
 	else if(tp.type() == PollableFileLayer::staticType())
 		item.fd = down_cast<PollableFileLayer const&>(tp).layer->fd();
+	else if(tp.type() == PollableTimer::staticType()
+		&& down_cast<PollableTimer const&>(tp).fd() >= 0)
+		item.fd = down_cast<PollableTimer const&>(tp).fd();
 #	endif
 	else
 		return EINVAL;
@@ -382,16 +541,14 @@ int ZmqPoller::doPoll(int timeout_ms, PollItemList& items) noexcept
 		if(item.revents) {
 			res--;
 
-			try {
-				if(item.revents & ZMQ_POLLIN) // NOLINT(hicpp-signed-bitwise)
-					revents.set(Pollable::PollInIndex);
-				if(item.revents & ZMQ_POLLOUT) // NOLINT(hicpp-signed-bitwise)
-					revents.set(Pollable::PollOutIndex);
-				if(item.revents & ZMQ_POLLERR) // NOLINT(hicpp-signed-bitwise)
-					revents.set(Pollable::PollErrIndex);
-			} catch(std::out_of_range const&) {
-				stored_assert(false); // NOLINT
-			}
+			Pollable::Events_value r = 0;
+			if(item.revents & ZMQ_POLLIN) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollIn;
+			if(item.revents & ZMQ_POLLOUT) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollOut;
+			if(item.revents & ZMQ_POLLERR) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollErr;
+			revents = Pollable::Events(r);
 		}
 
 		event(revents, i);
@@ -419,6 +576,9 @@ int PollPoller::init(Pollable const& p, struct pollfd& item) noexcept
 		item.fd = down_cast<PollableFd const&>(tp).fd;
 	else if(tp.type() == PollableFileLayer::staticType())
 		item.fd = down_cast<PollableFileLayer const&>(tp).layer->fd();
+	else if(tp.type() == PollableTimer::staticType()
+		&& down_cast<PollableTimer const&>(tp).fd() >= 0)
+		item.fd = down_cast<PollableTimer const&>(tp).fd();
 	else
 		return EINVAL;
 
@@ -455,20 +615,18 @@ int PollPoller::doPoll(int timeout_ms, PollItemList& items) noexcept
 		if(item.revents) {
 			res--;
 
-			try {
-				if(item.revents & POLLIN) // NOLINT(hicpp-signed-bitwise)
-					revents.set(Pollable::PollInIndex);
-				if(item.revents & POLLOUT) // NOLINT(hicpp-signed-bitwise)
-					revents.set(Pollable::PollOutIndex);
-				if(item.revents & POLLERR) // NOLINT(hicpp-signed-bitwise)
-					revents.set(Pollable::PollErrIndex);
-				if(item.revents & POLLPRI) // NOLINT(hicpp-signed-bitwise)
-					revents.set(Pollable::PollPriIndex);
-				if(item.revents & POLLHUP) // NOLINT(hicpp-signed-bitwise)
-					revents.set(Pollable::PollHupIndex);
-			} catch(std::out_of_range const&) {
-				stored_assert(false); // NOLINT
-			}
+			Pollable::Events_value r = 0;
+			if(item.revents & POLLIN) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollIn;
+			if(item.revents & POLLOUT) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollOut;
+			if(item.revents & POLLERR) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollErr;
+			if(item.revents & POLLPRI) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollPri;
+			if(item.revents & POLLHUP) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollHup;
+			revents = Pollable::Events(r);
 		}
 
 		event(revents, i);
@@ -481,6 +639,683 @@ int PollPoller::doPoll(int timeout_ms, PollItemList& items) noexcept
 
 
 
+//////////////////////////////////////////////
+// EpollPoller
+//
+
+#if defined(STORED_OS_LINUX) && !defined(STORED_HAVE_ZTH)
+EpollPoller::~EpollPoller()
+{
+	if(m_fd >= 0)
+		::close(m_fd);
+}
+
+int EpollPoller::init(Pollable const& p, EpollPollerItem& item) noexcept
+{
+	// We only have TypedPollables.
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	TypedPollable const& tp = static_cast<TypedPollable const&>(p);
+
+	if(tp.type() == PollableFd::staticType())
+		item.fd = down_cast<PollableFd const&>(tp).fd;
+	else if(tp.type() == PollableFileLayer::staticType())
+		item.fd = down_cast<PollableFileLayer const&>(tp).layer->fd();
+	else if(tp.type() == PollableTimer::staticType()
+		&& down_cast<PollableTimer const&>(tp).fd() >= 0)
+		item.fd = down_cast<PollableTimer const&>(tp).fd();
+	else
+		return EINVAL;
+
+	item.registered = false;
+
+	try {
+		item.events = m_edgeTriggered ? (unsigned int)EPOLLET : 0U;
+		if((tp.events.test(Pollable::PollInIndex)))
+			item.events |= EPOLLIN; // NOLINT(hicpp-signed-bitwise)
+		if((tp.events.test(Pollable::PollOutIndex)))
+			item.events |= EPOLLOUT; // NOLINT(hicpp-signed-bitwise)
+		if((tp.events.test(Pollable::PollPriIndex)))
+			item.events |= EPOLLPRI; // NOLINT(hicpp-signed-bitwise)
+		if((tp.events.test(Pollable::PollHupIndex)))
+			item.events |= EPOLLHUP; // NOLINT(hicpp-signed-bitwise)
+	} catch(std::out_of_range const&) {
+		stored_assert(false); // NOLINT
+	}
+
+	return 0;
+}
+
+int EpollPoller::reindex(Pollable const& p, EpollPollerItem& item, size_t index) noexcept
+{
+	STORED_UNUSED(p)
+
+	if(m_fd < 0) {
+		m_fd = epoll_create1(EPOLL_CLOEXEC);
+		if(m_fd < 0)
+			return errno;
+	}
+
+	if(!item.registered) {
+		// Make sure that doPoll() can receive all events at once.
+		try {
+			if(m_events.size() <= index)
+				m_events.resize(index + 1U);
+		} catch(std::bad_alloc const&) {
+			return ENOMEM;
+		} catch(...) {
+			return EINVAL;
+		}
+	}
+
+	struct epoll_event ev = {};
+	ev.events = item.events;
+	ev.data.u64 = (uint64_t)index;
+
+	if(epoll_ctl(m_fd, item.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, item.fd, &ev))
+		return errno;
+
+	item.registered = true;
+	return 0;
+}
+
+void EpollPoller::deinit(Pollable const& p, EpollPollerItem& item) noexcept
+{
+	STORED_UNUSED(p)
+
+	if(!item.registered)
+		return;
+
+	// This fails when the fd was closed already, which is fine, as the
+	// kernel removed it from the set.
+	epoll_ctl(m_fd, EPOLL_CTL_DEL, item.fd, nullptr);
+	item.registered = false;
+}
+
+int EpollPoller::doPoll(int timeout_ms, PollItemList& items) noexcept
+{
+	if(m_fd < 0 || items.empty()) {
+		// Nothing registered (yet), but the timeout should be honored.
+		return ::poll(nullptr, 0, timeout_ms) < 0 ? errno : 0;
+	}
+
+	stored_assert(m_events.size() >= items.size());
+
+	int res = epoll_wait(m_fd, m_events.data(), (int)items.size(), timeout_ms);
+
+	if(res < 0)
+		// Error.
+		return errno;
+
+	for(int i = 0; i < res; i++) {
+		struct epoll_event const& ev = m_events[(size_t)i];
+		Pollable::Events_value r = 0;
+
+		if(ev.events & EPOLLIN) // NOLINT(hicpp-signed-bitwise)
+			r |= Pollable::PollIn;
+		if(ev.events & EPOLLOUT) // NOLINT(hicpp-signed-bitwise)
+			r |= Pollable::PollOut;
+		if(ev.events & EPOLLERR) // NOLINT(hicpp-signed-bitwise)
+			r |= Pollable::PollErr;
+		if(ev.events & EPOLLPRI) // NOLINT(hicpp-signed-bitwise)
+			r |= Pollable::PollPri;
+		if(ev.events & EPOLLHUP) // NOLINT(hicpp-signed-bitwise)
+			r |= Pollable::PollHup;
+
+		size_t index = (size_t)ev.data.u64;
+		stored_assert(index < items.size());
+		event(Pollable::Events(r), index);
+	}
+
+	return 0;
+}
+#endif // STORED_OS_LINUX && !STORED_HAVE_ZTH
+
+
+
+
+//////////////////////////////////////////////
+// IoUringPoller
+//
+
+#if defined(STORED_OS_LINUX) && !defined(STORED_HAVE_ZTH)
+#	ifdef STORED_HAVE_IO_URING
+namespace impl {
+/*!
+ * \brief The mapped submission and completion queues of an io_uring.
+ */
+struct IoUring {
+	int fd;
+
+	void* sq;
+	size_t sqSize;
+	void* cq;
+	size_t cqSize;
+	struct io_uring_sqe* sqes;
+	size_t sqesSize;
+
+	unsigned* sqHead;
+	unsigned* sqTail;
+	unsigned* sqArray;
+	unsigned sqMask;
+	unsigned sqEntries;
+
+	unsigned* cqHead;
+	unsigned* cqTail;
+	struct io_uring_cqe* cqes;
+	unsigned cqMask;
+};
+} // namespace impl
+
+static void uring_close(impl::IoUring* r) noexcept
+{
+	if(!r)
+		return;
+
+	if(r->sqes)
+		munmap(r->sqes, r->sqesSize);
+	if(r->cq && r->cq != r->sq)
+		munmap(r->cq, r->cqSize);
+	if(r->sq)
+		munmap(r->sq, r->sqSize);
+	if(r->fd >= 0)
+		::close(r->fd);
+
+	cleanup(r);
+}
+
+static impl::IoUring* uring_open() noexcept
+{
+	struct io_uring_params params = {};
+	params.flags = IORING_SETUP_CLAMP | IORING_SETUP_CQSIZE;
+	// Every pollable has at most one poll request in flight, but prevent
+	// that the completion queue overflows in the common case.
+	params.cq_entries = 4096;
+
+	int fd = (int)syscall(__NR_io_uring_setup, 256U, &params);
+	if(fd < 0)
+		return nullptr;
+
+	if(!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP)) {
+		// Too old.
+		::close(fd);
+		return nullptr;
+	}
+
+	impl::IoUring* r = nullptr;
+
+	try {
+		r = new(allocate<impl::IoUring>()) impl::IoUring();
+	} catch(...) {
+		::close(fd);
+		return nullptr;
+	}
+
+	r->fd = fd;
+	r->sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	r->cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	r->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if(single)
+		r->sqSize = r->cqSize = std::max(r->sqSize, r->cqSize);
+
+	r->sq =
+		mmap(nullptr, r->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+		     IORING_OFF_SQ_RING);
+	if(r->sq == MAP_FAILED) {
+		r->sq = nullptr;
+		uring_close(r);
+		return nullptr;
+	}
+
+	if(single) {
+		r->cq = r->sq;
+	} else {
+		r->cq =
+			mmap(nullptr, r->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			     fd, IORING_OFF_CQ_RING);
+		if(r->cq == MAP_FAILED) {
+			r->cq = nullptr;
+			uring_close(r);
+			return nullptr;
+		}
+	}
+
+	void* sqes =
+		mmap(nullptr, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+		     IORING_OFF_SQES);
+	if(sqes == MAP_FAILED) {
+		uring_close(r);
+		return nullptr;
+	}
+
+	r->sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+	char* sq = static_cast<char*>(r->sq);
+	// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	r->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+	r->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	r->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	r->sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	r->sqEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+
+	char* cq = static_cast<char*>(r->cq);
+	r->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	r->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	r->cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+	r->cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+	return r;
+}
+
+static unsigned uring_pending(impl::IoUring& r) noexcept
+{
+	return *r.sqTail - __atomic_load_n(r.sqHead, __ATOMIC_ACQUIRE);
+}
+
+static int uring_enter(
+	impl::IoUring& r, unsigned min_complete, unsigned flags, int timeout_ms = -1) noexcept
+{
+	struct __kernel_timespec ts = {};
+	struct io_uring_getevents_arg arg = {};
+
+	if(timeout_ms > 0) {
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+		arg.ts = (uint64_t)(uintptr_t)&ts;
+	}
+
+	if(syscall(__NR_io_uring_enter, r.fd, uring_pending(r), min_complete,
+		   flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg))
+	   >= 0)
+		return 0;
+
+	switch(errno) {
+	case ETIME:
+		// Timeout.
+	case EBUSY:
+	case EAGAIN:
+		// Completion queue is (over)full, or out of resources; reap first.
+		return 0;
+	default:
+		return errno;
+	}
+}
+
+/*!
+ * \brief Get a cleared submission queue entry, which is submitted with the next enter.
+ * \return the entry, or \c nullptr when the queue is full and cannot be flushed
+ */
+static struct io_uring_sqe* uring_get_sqe(impl::IoUring& r) noexcept
+{
+	if(uring_pending(r) >= r.sqEntries) {
+		// Full. Submit what we have.
+		if(uring_enter(r, 0, 0) || uring_pending(r) >= r.sqEntries)
+			return nullptr;
+	}
+
+	unsigned tail = *r.sqTail;
+	unsigned index = tail & r.sqMask;
+	struct io_uring_sqe* sqe = &r.sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	r.sqArray[index] = index;
+	__atomic_store_n(r.sqTail, tail + 1U, __ATOMIC_RELEASE);
+	return sqe;
+}
+#	else  // !STORED_HAVE_IO_URING
+namespace impl {
+struct IoUring {};
+} // namespace impl
+
+static void uring_close(impl::IoUring* r) noexcept
+{
+	STORED_UNUSED(r)
+}
+#	endif // !STORED_HAVE_IO_URING
+
+IoUringPoller::~IoUringPoller()
+{
+	uring_close(m_ring);
+}
+
+int IoUringPoller::setup() noexcept
+{
+	if(m_ring || m_fallback)
+		return 0;
+
+#	ifdef STORED_HAVE_IO_URING
+	m_ring = uring_open();
+#	endif
+
+	if(!m_ring)
+		// Not supported, disabled, or not permitted. Use poll() instead.
+		m_fallback = true;
+
+	return 0;
+}
+
+int IoUringPoller::init(Pollable const& p, IoUringPollerItem& item) noexcept
+{
+	// We only have TypedPollables.
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	TypedPollable const& tp = static_cast<TypedPollable const&>(p);
+
+	if(tp.type() == PollableFd::staticType())
+		item.fd = down_cast<PollableFd const&>(tp).fd;
+	else if(tp.type() == PollableFileLayer::staticType())
+		item.fd = down_cast<PollableFileLayer const&>(tp).layer->fd();
+	else if(tp.type() == PollableTimer::staticType()
+		&& down_cast<PollableTimer const&>(tp).fd() >= 0)
+		item.fd = down_cast<PollableTimer const&>(tp).fd();
+	else
+		return EINVAL;
+
+	item.user_data = 0;
+	item.armed = false;
+	item.multishot = m_multishot;
+
+	try {
+		item.events = 0;
+		if((tp.events.test(Pollable::PollInIndex)))
+			item.events |= POLLIN; // NOLINT(hicpp-signed-bitwise)
+		if((tp.events.test(Pollable::PollOutIndex)))
+			item.events |= POLLOUT; // NOLINT(hicpp-signed-bitwise)
+		if((tp.events.test(Pollable::PollPriIndex)))
+			item.events |= POLLPRI; // NOLINT(hicpp-signed-bitwise)
+		if((tp.events.test(Pollable::PollHupIndex)))
+			item.events |= POLLHUP; // NOLINT(hicpp-signed-bitwise)
+	} catch(std::out_of_range const&) {
+		stored_assert(false); // NOLINT
+	}
+
+	return 0;
+}
+
+int IoUringPoller::submitPoll(IoUringPollerItem& item) noexcept
+{
+#	ifdef STORED_HAVE_IO_URING
+	stored_assert(m_ring);
+
+	struct io_uring_sqe* sqe = uring_get_sqe(*m_ring);
+	if(!sqe)
+		return EAGAIN;
+
+	uint32_t events = item.events;
+#		if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	// The kernel expects the 16-bit halves to be swapped.
+	events = (events << 16U) | (events >> 16U);
+#		endif
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = item.fd;
+	sqe->poll32_events = events;
+	sqe->len = item.multishot ? IORING_POLL_ADD_MULTI : 0U;
+	sqe->user_data = item.user_data;
+	item.armed = true;
+	return 0;
+#	else
+	STORED_UNUSED(item)
+	return ENOSYS;
+#	endif
+}
+
+int IoUringPoller::submitRemove(uint64_t user_data) noexcept
+{
+#	ifdef STORED_HAVE_IO_URING
+	stored_assert(m_ring);
+
+	struct io_uring_sqe* sqe = uring_get_sqe(*m_ring);
+	if(!sqe)
+		return EAGAIN;
+
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->addr = user_data;
+	// The completion of the removal itself is ignored.
+	sqe->user_data = 0;
+	return 0;
+#	else
+	STORED_UNUSED(user_data)
+	return ENOSYS;
+#	endif
+}
+
+int IoUringPoller::reindex(Pollable const& p, IoUringPollerItem& item, size_t index) noexcept
+{
+	STORED_UNUSED(p)
+
+	int res = setup();
+	if(res)
+		return res;
+
+	try {
+		// Make sure that doPoll() does not have to allocate.
+		if(m_fallback) {
+			if(m_pollfds.size() <= index)
+				m_pollfds.resize(index + 1U);
+		} else {
+			if(m_revents.size() <= index)
+				m_revents.resize(index + 1U);
+			m_ready.reserve(index + 1U);
+			m_resubmit.reserve(index + 1U);
+		}
+	} catch(std::bad_alloc const&) {
+		return ENOMEM;
+	} catch(...) {
+		return EINVAL;
+	}
+
+	if(m_fallback) {
+		struct pollfd& pfd = m_pollfds[index];
+		pfd.fd = item.fd;
+		pfd.events = (short)item.events;
+		pfd.revents = 0;
+		return 0;
+	}
+
+	if(index > 0xffffffffU)
+		return ENOMEM;
+
+	if(item.armed) {
+		res = submitRemove(item.user_data);
+		if(res)
+			return res;
+
+		item.armed = false;
+	}
+
+	// The user_data identifies the index of the item, and the generation
+	// to recognize completions of requests that have been removed since.
+	if(++m_generation == 0)
+		m_generation++;
+
+	item.user_data = ((uint64_t)m_generation << 32U) | (uint64_t)index;
+	m_revents[index] = 0;
+	return submitPoll(item);
+}
+
+void IoUringPoller::deinit(Pollable const& p, IoUringPollerItem& item) noexcept
+{
+	STORED_UNUSED(p)
+
+	if(item.armed)
+		submitRemove(item.user_data);
+
+	item.armed = false;
+	item.user_data = 0;
+}
+
+int IoUringPoller::doFallbackPoll(int timeout_ms, PollItemList& items) noexcept
+{
+	stored_assert(m_pollfds.size() >= items.size());
+
+	int res = ::poll(m_pollfds.data(), (nfds_t)items.size(), timeout_ms);
+
+	if(res < 0)
+		// Error.
+		return errno;
+
+	for(size_t i = 0; res > 0 && i < items.size(); i++) {
+		struct pollfd& item = m_pollfds[i];
+		Pollable::Events_value r = 0;
+
+		if(item.revents) {
+			res--;
+
+			if(item.revents & POLLIN) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollIn;
+			if(item.revents & POLLOUT) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollOut;
+			if(item.revents & (POLLERR | POLLNVAL)) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollErr;
+			if(item.revents & POLLPRI) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollPri;
+			if(item.revents & POLLHUP) // NOLINT(hicpp-signed-bitwise)
+				r |= Pollable::PollHup;
+		}
+
+		event(Pollable::Events(r), i);
+	}
+
+	return 0;
+}
+
+#	ifdef STORED_HAVE_IO_URING
+/*!
+ * \brief Collect all completions, and merge the events per pollable in #m_revents.
+ */
+void IoUringPoller::reap(PollItemList& items) noexcept
+{
+	stored_assert(m_ring);
+	impl::IoUring& r = *m_ring;
+
+	unsigned head = *r.cqHead;
+	unsigned tail = __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE);
+
+	for(; head != tail; head++) {
+		struct io_uring_cqe const& cqe = r.cqes[head & r.cqMask];
+		uint64_t user_data = cqe.user_data;
+		size_t index = (size_t)(user_data & 0xffffffffU);
+
+		if(!user_data || index >= items.size() || items[index].user_data != user_data)
+			// Removal, or a completion of a removed request.
+			continue;
+
+		IoUringPollerItem& item = items[index];
+
+		if(!(cqe.flags & IORING_CQE_F_MORE)) {
+			// This request is finished; resubmit it during the next poll.
+			item.armed = false;
+			m_resubmit.push_back(user_data);
+		}
+
+		Pollable::Events_value rev = 0;
+
+		if(cqe.res < 0) {
+			rev = Pollable::PollErr;
+		} else {
+			if(cqe.res & POLLIN) // NOLINT(hicpp-signed-bitwise)
+				rev |= Pollable::PollIn;
+			if(cqe.res & POLLOUT) // NOLINT(hicpp-signed-bitwise)
+				rev |= Pollable::PollOut;
+			if(cqe.res & (POLLERR | POLLNVAL)) // NOLINT(hicpp-signed-bitwise)
+				rev |= Pollable::PollErr;
+			if(cqe.res & POLLPRI) // NOLINT(hicpp-signed-bitwise)
+				rev |= Pollable::PollPri;
+			if(cqe.res & POLLHUP) // NOLINT(hicpp-signed-bitwise)
+				rev |= Pollable::PollHup;
+		}
+
+		if(!rev)
+			continue;
+
+		if(!m_revents[index])
+			m_ready.push_back(index);
+
+		m_revents[index] |= rev;
+	}
+
+	__atomic_store_n(r.cqHead, head, __ATOMIC_RELEASE);
+}
+#	endif // STORED_HAVE_IO_URING
+
+int IoUringPoller::doPoll(int timeout_ms, PollItemList& items) noexcept
+{
+	if(m_fallback)
+		return doFallbackPoll(timeout_ms, items);
+
+#	ifdef STORED_HAVE_IO_URING
+	if(!m_ring)
+		// Nothing registered (yet), but the timeout should be honored.
+		return ::poll(nullptr, 0, timeout_ms) < 0 ? errno : 0;
+
+	impl::IoUring& r = *m_ring;
+	uint64_t deadline = timeout_ms > 0 ? now_us() + (uint64_t)timeout_ms * 1000U : 0;
+
+	while(true) {
+		// Rearm the requests that completed during the previous poll.
+		for(size_t i = 0; i < m_resubmit.size(); i++) {
+			uint64_t user_data = m_resubmit[i];
+			size_t index = (size_t)(user_data & 0xffffffffU);
+
+			// Skip when removed or moved in the mean time.
+			if(index < items.size() && items[index].user_data == user_data
+			   && !items[index].armed) {
+				int res = submitPoll(items[index]);
+				if(res)
+					return res;
+			}
+		}
+
+		m_resubmit.clear();
+
+		// Submit and wait in one go.
+		bool ready = *r.cqHead != __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE);
+		bool wait = timeout_ms != 0 && !ready && !items.empty();
+		int res = uring_enter(
+			r, wait ? 1U : 0U, wait ? (unsigned)IORING_ENTER_GETEVENTS : 0U,
+			timeout_ms);
+		if(res)
+			return res;
+
+		if(items.empty())
+			// Nothing to wait for, but the timeout should be honored.
+			return ::poll(nullptr, 0, timeout_ms) < 0 ? errno : 0;
+
+		reap(items);
+
+		if(!m_ready.empty() || timeout_ms == 0)
+			break;
+
+		// Only got completions of removed requests.
+		if(timeout_ms > 0) {
+			uint64_t now = now_us();
+			if(now >= deadline)
+				break;
+
+			timeout_ms = (int)((deadline - now + 999U) / 1000U);
+		}
+	}
+
+	for(size_t i = 0; i < m_ready.size(); i++) {
+		size_t index = m_ready[i];
+		Pollable::Events_value rev = m_revents[index];
+		m_revents[index] = 0;
+		event(Pollable::Events(rev), index);
+	}
+
+	m_ready.clear();
+	return 0;
+#	else  // !STORED_HAVE_IO_URING
+	// setup() always falls back.
+	STORED_UNUSED(items)
+	return ::poll(nullptr, 0, timeout_ms) < 0 ? errno : 0;
+#	endif // !STORED_HAVE_IO_URING
+}
+#endif // STORED_OS_LINUX && !STORED_HAVE_ZTH
+
+
+
 //////////////////////////////////////////////
 // LoopPoller
 //
@@ -514,6 +1349,11 @@ int poll_once_default(TypedPollable const& p, Pollable::Events& revents) noexcep
 	if(p.type() == PollableCallbackBase::staticType()) {
 		revents = down_cast<PollableCallbackBase const&>(p)();
 		return 0;
+	} else if(p.type() == PollableTimer::staticType()) {
+		revents.reset();
+		if(down_cast<PollableTimer const&>(p).expired())
+			revents.set(Pollable::PollInIndex);
+		return 0;
 	} else {
 		// Not supported by default poll_once().
 		return EINVAL;
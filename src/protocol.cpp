@@ -226,6 +226,8 @@ TerminalLayer::~TerminalLayer() is_default
 
 void TerminalLayer::decode(void* buffer, size_t len)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryProtocol);
+
 	size_t nonDebugOffset = m_decodeState < StateDebug ? 0 : len;
 
 	for(size_t i = 0; i < len; i++) {
@@ -382,6 +384,8 @@ size_t SegmentationLayer::lowerMtu() const
 
 void SegmentationLayer::decode(void* buffer, size_t len)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryProtocol);
+
 	if(len == 0)
 		return;
 
@@ -506,6 +510,8 @@ void ArqLayer::reset()
 
 void ArqLayer::decode(void* buffer, size_t len)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryProtocol);
+
 	uint8_t* buffer_ = static_cast<uint8_t*>(buffer);
 	bool reconnect = false;
 
@@ -662,6 +668,8 @@ bool ArqLayer::waitingForAck() const
 
 void ArqLayer::encode(void const* buffer, size_t len, bool last)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryProtocol);
+
 	if(m_maxEncodeBuffer > 0 && m_maxEncodeBuffer < m_encodeQueueSize + len + 1U /* seq */)
 		event(EventEncodeBufferOverflow);
 
@@ -821,6 +829,8 @@ size_t ArqLayer::retransmits() const
  */
 void ArqLayer::keepAlive()
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryProtocol);
+
 	if(m_encodeQueue.empty()) {
 		// Send empty message. This will trigger (re)transmits, so a broken
 		// connection will be detected.
@@ -1063,6 +1073,8 @@ void DebugArqLayer::decode(void* buffer, size_t len)
 
 void DebugArqLayer::encode(void const* buffer, size_t len, bool last)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryProtocol);
+
 	if(m_decodeState == DecodeStateDecoding) {
 		// This seems to be the first part of the response.
 		// So, the request message must have been complete.
@@ -1474,6 +1486,8 @@ void BufferLayer::reset()
  */
 void BufferLayer::encode(void const* buffer, size_t len, bool last)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryProtocol);
+
 	char const* buffer_ = static_cast<char const*>(buffer);
 
 	size_t remaining = m_size - m_buffer.size();
@@ -1666,6 +1680,8 @@ void impl::Loopback1::reserve(size_t capacity)
  */
 void impl::Loopback1::encode(void const* buffer, size_t len, bool last)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryProtocol);
+
 	if(likely(len > 0)) {
 		if(unlikely(m_len + len > m_capacity))
 			reserve(m_len + len + ExtraAlloc);
@@ -1779,7 +1795,8 @@ int PolledFileLayer::block(
 	}
 
 	while(true) {
-		Poller::Result const& pres = poller.poll((int)(timeout_us / 1000L));
+		Poller::Result const& pres =
+			poller.poll(timeout_us < 0 ? -1 : (int)(timeout_us / 1000L));
 
 		if(pres.empty()) {
 			if(timeout_us <= 0 && errno == EINTR)
@@ -2007,6 +2024,8 @@ bool FileLayer::isOpen() const
  */
 void FileLayer::encode(void const* buffer, size_t len, bool last)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryProtocol);
+
 	if(m_fd_w == -1) {
 		setLastError(EBADF);
 done:
@@ -2501,6 +2520,8 @@ void FileLayer::writeCompletionRoutine(
  */
 void FileLayer::encode(void const* buffer, size_t len, bool last)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategoryProtocol);
+
 	if(!isValidHandle(fd_w())) {
 		setLastError(EBADF);
 done:
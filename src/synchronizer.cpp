@@ -363,6 +363,8 @@ StoreJournal::Seq StoreJournal::toLong(StoreJournal::ShortSeq seq) const
  */
 void StoreJournal::changed(StoreJournal::Key key, size_t len, bool insertIfNew)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategorySynchronizer);
+
 	m_partialSeq = true;
 
 	if(!update(key, len, seq(), 0, m_changes.size()) && insertIfNew) {
@@ -1062,9 +1064,13 @@ againIn:
  *
  * The provided \p encodeBuffer must point to a scratch pad memory, large
  * enough for the store's MaxMessageSize.
+ *
+ * Nothing is sent while the connection is not #writable().
  */
 StoreJournal::Seq SyncConnection::process(StoreJournal& store, void* encodeBuffer)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategorySynchronizer);
+
 	StoreMap::iterator s = m_store.find(&store);
 	if(s == m_store.end())
 		// Unknown store.
@@ -1072,6 +1078,10 @@ StoreJournal::Seq SyncConnection::process(StoreJournal& store, void* encodeBuffe
 	if(!store.hasChanged(s->second.seq))
 		// No recent changes.
 		return 0;
+	if(!writable())
+		// Backpressure. The changes remain in the journal, and are
+		// combined with later ones into one update.
+		return 0;
 
 	uint8_t* encodeBuffer_ = static_cast<uint8_t*>(encodeBuffer);
 	encodeCmd(Update, encodeBuffer_);
@@ -1101,6 +1111,8 @@ char SyncConnection::decodeCmd(void*& buffer, size_t& len)
 
 void SyncConnection::decode(void* buffer, size_t len)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategorySynchronizer);
+
 	// We can use the buffer as scratch pad memory, up to where the buffer
 	// was decoded.
 	void* scratch = buffer;
@@ -1403,6 +1415,8 @@ StoreJournal* Synchronizer::toJournal(char const* hash) const
  */
 SyncConnection const& Synchronizer::connect(ProtocolLayer& connection)
 {
+	AllocationTracker::Scope alloc_scope(AllocationTracker::CategorySynchronizer);
+
 	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
 	SyncConnection* c = new SyncConnection(*this, connection);
 	m_connections.insert(c);
@@ -256,6 +256,12 @@ char const* banner() noexcept
 #ifdef STORED_POLL_LOOP
 	       " poll=loop"
 #endif
+#ifdef STORED_POLL_EPOLL
+	       " poll=epoll"
+#endif
+#ifdef STORED_POLL_IO_URING
+	       " poll=io_uring"
+#endif
 #ifdef STORED_DRAFT_API
 	       " draft"
 #endif
@@ -15,6 +15,8 @@
 
 #	include <cerrno>
 #	include <cstdlib>
+#	include <cstring>
+#	include <new>
 
 #	if STORED_cplusplus < 201103L
 #		include <inttypes.h>
@@ -25,6 +27,19 @@
 namespace stored {
 
 
+/*!
+ * \brief Release a buffer that was passed to \c zmq_msg_init_data().
+ *
+ * This is the \c zmq_free_fn, which may be called from any thread.
+ */
+static void zmq_free_buffer(void* data, void* hint) noexcept
+{
+	STORED_UNUSED(hint)
+	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+	free(data);
+}
+
+
 //////////////////////////////
 // ZmqLayer
 //
@@ -40,8 +55,25 @@ ZmqLayer::ZmqLayer(void* context, int type, ProtocolLayer* up, ProtocolLayer* do
 	, m_contextCleanup(!context)
 	, m_buffer()
 	, m_bufferCapacity()
-	, m_bufferSize()
 	, m_socket(zmq_socket(this->context(), type))
+	, m_router(type == ZMQ_ROUTER)
+	, m_parts()
+	, m_partsCount()
+	, m_partsCapacity()
+	, m_envelope()
+	, m_envelopeCount()
+	, m_envelopeCapacity()
+	, m_sendMore()
+	, m_sendDrop()
+	, m_send()
+	, m_sendSize()
+	, m_sendCapacity()
+	, m_batching()
+	, m_batch()
+	, m_batchCount()
+	, m_batchDeferred()
+	, m_batchCapacity()
+	, m_stats()
 {
 	if(!m_socket)
 		setLastError(errno);
@@ -58,6 +90,21 @@ ZmqLayer::~ZmqLayer()
 	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
 	free(m_buffer);
 
+	dropParts();
+	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+	free(m_parts);
+
+	dropEnvelope();
+	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+	free(m_envelope);
+
+	dropBatch();
+	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+	free(m_batch);
+
+	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+	free(m_send);
+
 	zmq_close(m_socket);
 
 	if(m_contextCleanup) {
@@ -134,7 +181,8 @@ int ZmqLayer::block(bool forReading, long timeout_us, bool suspend)
 	}
 
 	while(true) {
-		Poller::Result const& pres = poller.poll((int)(timeout_us / 1000L));
+		Poller::Result const& pres =
+			poller.poll(timeout_us < 0 ? -1 : (int)(timeout_us / 1000L));
 
 		if(pres.empty()) {
 			err = errno;
@@ -202,42 +250,29 @@ int ZmqLayer::recv1(long timeout_us)
 
 	more = zmq_msg_more(&msg);
 
-	if(unlikely(m_bufferSize || more || zmq_msg_get(&msg, ZMQ_SHARED))) {
-		// Save for later processing.
-		size_t msgSize = zmq_msg_size(&msg);
-		size_t newBufferSize = m_bufferSize + msgSize;
-
-		if(newBufferSize > m_bufferCapacity) {
-			// NOLINTNEXTLINE(cppcoreguidelines-no-malloc,cppcoreguidelines-owning-memory)
-			void* p = realloc(m_buffer, newBufferSize);
-			if(!p) {
-				res = ENOMEM;
-				goto error_buffer;
-			}
-
-			m_buffer = p;
-			m_bufferCapacity = newBufferSize;
-		}
-
-		memcpy(static_cast<char*>(m_buffer) + m_bufferSize, zmq_msg_data(&msg), msgSize);
-		m_bufferSize = newBufferSize;
-	}
-
-	if(likely(!more)) {
-		if(likely(!m_bufferSize)) {
-			// Process immediately, without copying to the buffer.
-			decode(zmq_msg_data(&msg), zmq_msg_size(&msg));
+	if(unlikely(more || m_partsCount)) {
+		// Keep the part until the last one has been received.
+		res = keepPart(msg);
+		if(res || more) {
+			// Wait for the rest.
+		} else if(m_router) {
+			res = decodeRouted();
+		} else if(m_batching) {
+			// Every part is a message of the batch.
+			for(size_t i = 0; i < m_partsCount && !res; i++)
+				res = decodePart(m_parts[i]);
+			dropParts();
 		} else {
-			// Process message from buffer.
-			decode(m_buffer, m_bufferSize);
-			m_bufferSize = 0;
+			res = decodeParts(m_parts, m_partsCount);
+			dropParts();
 		}
+		return setLastError(res);
 	}
 
+	res = decodePart(msg);
 	zmq_msg_close(&msg);
-	return setLastError(0);
+	return setLastError(res);
 
-error_buffer:
 error_recv:
 	zmq_msg_close(&msg);
 error_msg:
@@ -246,6 +281,222 @@ error_msg:
 	return setLastError(res);
 }
 
+/*!
+ * \brief Move \p msg to the end of the given array, which is grown when required.
+ *
+ * On success, \p msg is left empty. On failure, \p msg is closed.
+ *
+ * \return 0 on success, otherwise an errno
+ */
+static int zmq_msgs_append(zmq_msg_t*& msgs, size_t& count, size_t& capacity, zmq_msg_t& msg)
+{
+	if(count == capacity) {
+		size_t newCapacity = capacity ? capacity * 2U : 4U;
+		// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+		zmq_msg_t* p = static_cast<zmq_msg_t*>(malloc(newCapacity * sizeof(zmq_msg_t)));
+
+		if(!p) {
+			zmq_msg_close(&msg);
+			return ENOMEM;
+		}
+
+		// zmq_msg_t should not be copied; move them properly.
+		for(size_t i = 0; i < count; i++) {
+			zmq_msg_init(&p[i]);
+			zmq_msg_move(&p[i], &msgs[i]);
+			zmq_msg_close(&msgs[i]);
+		}
+
+		// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+		free(msgs);
+		msgs = p;
+		capacity = newCapacity;
+	}
+
+	zmq_msg_t& m = msgs[count];
+	zmq_msg_init(&m);
+	zmq_msg_move(&m, &msg);
+	zmq_msg_close(&msg);
+	count++;
+	return 0;
+}
+
+/*!
+ * \brief Move the given part of a multipart message to #m_parts.
+ *
+ * On success, \p msg is left empty. On failure, all parts, including \p msg, are dropped.
+ */
+int ZmqLayer::keepPart(zmq_msg_t& msg)
+{
+	int res = zmq_msgs_append(m_parts, m_partsCount, m_partsCapacity, msg);
+	if(res)
+		dropParts();
+
+	return res;
+}
+
+/*!
+ * \brief Decode the given message.
+ *
+ * The message is decoded in place, unless others may be using the same data.
+ * In that case, a copy in #m_buffer is decoded instead.
+ */
+int ZmqLayer::decodePart(zmq_msg_t& msg)
+{
+	if(likely(!zmq_msg_get(&msg, ZMQ_SHARED))) {
+		// Process immediately, without copying to the buffer.
+		decode(zmq_msg_data(&msg), zmq_msg_size(&msg));
+		return 0;
+	}
+
+	size_t msgSize = zmq_msg_size(&msg);
+
+	if(msgSize > m_bufferCapacity) {
+		// NOLINTNEXTLINE(cppcoreguidelines-no-malloc,cppcoreguidelines-owning-memory)
+		void* p = realloc(m_buffer, msgSize);
+		if(!p)
+			return ENOMEM;
+
+		m_buffer = p;
+		m_bufferCapacity = msgSize;
+	}
+
+	if(msgSize)
+		memcpy(m_buffer, zmq_msg_data(&msg), msgSize);
+
+	decode(m_buffer, msgSize);
+	return 0;
+}
+
+/*!
+ * \brief Decode the given parts as one message.
+ *
+ * If only one of the parts holds data, it is decoded in place. Otherwise, the
+ * parts are concatenated in #m_buffer first, which is done with a single copy.
+ */
+int ZmqLayer::decodeParts(zmq_msg_t* parts, size_t count)
+{
+	size_t total = 0;
+	zmq_msg_t* data = nullptr;
+	size_t dataParts = 0;
+
+	for(size_t i = 0; i < count; i++) {
+		size_t size = zmq_msg_size(&parts[i]);
+		if(!size)
+			continue;
+
+		total += size;
+		data = &parts[i];
+		dataParts++;
+	}
+
+	if(dataParts == 0) {
+		decode(count ? zmq_msg_data(&parts[0]) : m_buffer, 0);
+		return 0;
+	}
+
+	if(dataParts == 1 && !zmq_msg_get(data, ZMQ_SHARED)) {
+		decode(zmq_msg_data(data), total);
+		return 0;
+	}
+
+	if(total > m_bufferCapacity) {
+		// Don't realloc(), there is no need to preserve the old content.
+		// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+		free(m_buffer);
+		// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+		m_buffer = malloc(total);
+		m_bufferCapacity = m_buffer ? total : 0;
+
+		if(!m_buffer)
+			return ENOMEM;
+	}
+
+	char* p = static_cast<char*>(m_buffer);
+	for(size_t i = 0; i < count; i++) {
+		size_t size = zmq_msg_size(&parts[i]);
+		if(size)
+			memcpy(p, zmq_msg_data(&parts[i]), size);
+		p += size;
+	}
+
+	decode(m_buffer, total);
+	return 0;
+}
+
+/*!
+ * \brief Split the routing envelope off #m_parts, and decode the rest.
+ *
+ * The envelope consists of all parts up to and including the first empty
+ * delimiter, as sent by REQ clients. If there is no delimiter, like for DEALER
+ * clients, the envelope is only the first part, which is the routing id.
+ *
+ * The envelope is kept in #m_envelope, such that encode() can route the
+ * response to the sender of the last request.
+ */
+int ZmqLayer::decodeRouted()
+{
+	size_t envelope = 1;
+	for(size_t i = 0; i + 1 < m_partsCount; i++) {
+		if(!zmq_msg_size(&m_parts[i])) {
+			envelope = i + 1;
+			break;
+		}
+	}
+
+	// Swap the buffers, such that the envelope stays where it is.
+	dropEnvelope();
+
+	zmq_msg_t* parts = m_envelope;
+	m_envelope = m_parts;
+	m_parts = parts;
+
+	size_t capacity = m_envelopeCapacity;
+	m_envelopeCapacity = m_partsCapacity;
+	m_partsCapacity = capacity;
+
+	size_t count = m_partsCount;
+	m_partsCount = 0;
+
+	if(envelope > count)
+		envelope = count;
+
+	// Only the envelope is to be used by encode() during decode().
+	m_envelopeCount = envelope;
+
+	int res = 0;
+	if(envelope < count)
+		res = decodeParts(&m_envelope[envelope], count - envelope);
+
+	// Drop the payload, but keep the envelope.
+	for(size_t i = envelope; i < count; i++)
+		zmq_msg_close(&m_envelope[i]);
+
+	return res;
+}
+
+/*!
+ * \brief Release all #m_parts.
+ */
+void ZmqLayer::dropParts()
+{
+	for(size_t i = 0; i < m_partsCount; i++)
+		zmq_msg_close(&m_parts[i]);
+
+	m_partsCount = 0;
+}
+
+/*!
+ * \brief Release all #m_envelope parts.
+ */
+void ZmqLayer::dropEnvelope()
+{
+	for(size_t i = 0; i < m_envelopeCount; i++)
+		zmq_msg_close(&m_envelope[i]);
+
+	m_envelopeCount = 0;
+}
+
 /*!
  * \brief Try to receive all available data from the ZeroMQ REP socket, and decode() it.
  * \param timeout_us if zero, this function does not block. -1 blocks indefinitely.
@@ -253,58 +504,349 @@ error_msg:
 int ZmqLayer::recv(long timeout_us)
 {
 	bool first = true;
+	int res = 0;
 
-	while(true) {
-		int res = recv1(first ? timeout_us : 0);
+	// Receive until EAGAIN, or another error.
+	while(!(res = recv1(first ? timeout_us : 0)))
+		first = false;
 
-		switch(res) {
-		case 0:
-			// Got more.
-			break;
-		case EAGAIN:
-			// That's it.
-			if(!first) {
-				// We already got something, so don't make this an error.
-				return setLastError(0);
-			}
-			STORED_FALLTHROUGH
-		default:
-			return res;
-		}
+	if(res == EAGAIN && !first)
+		// We already got something, so don't make this an error.
+		res = 0;
 
-		first = false;
-	}
+	if(unlikely(m_batchCount))
+		// Send the responses to all received messages at once.
+		sendBatch();
+
+	return setLastError(res);
 }
 
 /*!
  * \copydoc stored::ProtocolLayer::encode(void const*, size_t, bool)
  * \details Encoded data is send as REP over the ZeroMQ socket.
+ *
+ * Every part of a message is sent as a separate frame of a multipart
+ * ZeroMQ message.
+ *
+ * When #batching(), messages are held back until #flush(). Then, all parts
+ * of a message are joined into one frame.
  */
 void ZmqLayer::encode(void const* buffer, size_t len, bool last)
 {
-	// First try, assume we are writable.
-	// NOLINTNEXTLINE(hicpp-signed-bitwise,cppcoreguidelines-pro-type-cstyle-cast)
-	if(likely(zmq_send(m_socket, (void*)buffer, len, ZMQ_DONTWAIT | (last ? 0 : ZMQ_SNDMORE))
-		  != -1)) {
-		// Success.
-		setLastError(0);
-	} else if(setLastError(errno) != EAGAIN) { // NOLINT(bugprone-branch-clone)
-						   // Some other error occurred.
-	} else if(block(false)) {
-		// Socket is not writable, and blocking failed.
-	} else {
-		// Socket should be writable now. This is a blocking call,
-		// but it should not block anymore.
-		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast)
-		if(zmq_send(m_socket, (void*)buffer, len, last ? 0 : ZMQ_SNDMORE) != -1)
-			// Some error.
-			setLastError(errno);
-		else
+	if(unlikely(m_batching)) {
+		if(last && !m_sendSize)
+			batchDirect(buffer, len);
+		else if(!gather(buffer, len) && last)
+			batchGathered();
+	} else
+		sendPart(buffer, len, last);
+
+	base::encode(buffer, len, last);
+}
+
+/*!
+ * \brief Send the given buffer as one frame of the current message using \c zmq_send().
+ *
+ * When a part could not be sent, the rest of the message is dropped. If
+ * earlier frames (including the routing envelope) were sent already, the
+ * message is terminated by an empty frame. So, the peer receives a message
+ * with an empty last part, instead of a part of the next message.
+ */
+int ZmqLayer::sendPart(void const* buffer, size_t len, bool last)
+{
+	if(unlikely(m_sendDrop)) {
+		// An earlier part of this message failed.
+		m_sendDrop = !last;
+		return lastError();
+	}
+
+	int res = 0;
+
+	if(unlikely(m_router && !m_sendMore))
+		res = sendEnvelope();
+
+	if(likely(!res)) {
+		// NOLINTNEXTLINE(hicpp-signed-bitwise)
+		int flags = last ? 0 : ZMQ_SNDMORE;
+
+		// First try, assume we are writable.
+		// NOLINTNEXTLINE(hicpp-signed-bitwise,cppcoreguidelines-pro-type-cstyle-cast)
+		if(likely(zmq_send(m_socket, (void*)buffer, len, ZMQ_DONTWAIT | flags) != -1)) {
 			// Success.
-			setLastError(0);
+		} else if((res = errno) != EAGAIN) { // NOLINT(bugprone-branch-clone)
+			// Some other error occurred.
+		} else if((res = block(false))) {
+			// Socket is not writable, and blocking failed.
+		} else if(
+			// Socket should be writable now. This is a blocking call,
+			// but it should not block anymore.
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast)
+			zmq_send(m_socket, (void*)buffer, len, flags) == -1) {
+			// Some error.
+			res = errno;
+		}
 	}
 
-	base::encode(buffer, len, last);
+	if(unlikely(res)) {
+		if(m_sendMore)
+			// Frames of this message have been queued already, which
+			// cannot be taken back. Terminate the message with an
+			// empty frame, instead of leaving it open for the next one.
+			zmq_send(m_socket, "", 0, ZMQ_DONTWAIT);
+
+		m_stats.dropped++;
+		m_sendMore = false;
+		m_sendDrop = !last;
+	} else {
+		m_sendMore = !last;
+		if(last)
+			m_stats.messages++;
+	}
+
+	return setLastError(res);
+}
+
+/*!
+ * \brief Send the routing envelope of the last received message of a ROUTER socket.
+ *
+ * The payload must follow.
+ */
+int ZmqLayer::sendEnvelope()
+{
+	if(!m_envelopeCount)
+		// Nobody to respond to.
+		return setLastError(EHOSTUNREACH);
+
+	for(size_t i = 0; i < m_envelopeCount; i++) {
+		zmq_msg_t msg;
+		zmq_msg_init(&msg);
+
+		// A ROUTER socket drops messages it cannot route, so this does not block.
+		if(zmq_msg_copy(&msg, &m_envelope[i]) == -1
+		   || zmq_msg_send(&msg, m_socket, ZMQ_SNDMORE) == -1) {
+			int res = errno;
+			zmq_msg_close(&msg);
+			return setLastError(res);
+		}
+
+		m_sendMore = true;
+	}
+
+	return 0;
+}
+
+/*!
+ * \brief Append the given buffer to #m_send.
+ */
+int ZmqLayer::gather(void const* buffer, size_t len)
+{
+	size_t size = m_sendSize + len;
+
+	if(m_sendCapacity < size) {
+		size_t capacity = m_sendCapacity * 2U;
+		if(capacity < size)
+			capacity = size;
+
+		// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+		void* p = realloc(m_send, capacity);
+		if(!p) {
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+			free(m_send);
+			m_send = nullptr;
+			m_sendSize = m_sendCapacity = 0;
+			return setLastError(ENOMEM);
+		}
+
+		m_send = static_cast<char*>(p);
+		m_sendCapacity = capacity;
+	}
+
+	if(len)
+		memcpy(m_send + m_sendSize, buffer, len);
+
+	m_sendSize = size;
+	return 0;
+}
+
+/*!
+ * \brief Add a copy of the given buffer to #m_batch.
+ */
+int ZmqLayer::batchDirect(void const* buffer, size_t len)
+{
+	zmq_msg_t msg;
+	if(unlikely(zmq_msg_init_size(&msg, len) == -1)) {
+		m_stats.dropped++;
+		return setLastError(errno);
+	}
+
+	if(len)
+		memcpy(zmq_msg_data(&msg), buffer, len);
+
+	int res = zmq_msgs_append(m_batch, m_batchCount, m_batchCapacity, msg);
+	if(res)
+		m_stats.dropped++;
+
+	return setLastError(res);
+}
+
+/*!
+ * \brief Add #m_send to #m_batch, and pass its ownership to ZeroMQ.
+ */
+int ZmqLayer::batchGathered()
+{
+	char* b = m_send;
+	size_t size = m_sendSize;
+	m_send = nullptr;
+	m_sendSize = m_sendCapacity = 0;
+
+	zmq_msg_t msg;
+	if(unlikely(zmq_msg_init_data(&msg, b, size, &zmq_free_buffer, nullptr) == -1)) {
+		int res = errno;
+		zmq_free_buffer(b, nullptr);
+		m_stats.dropped++;
+		return setLastError(res);
+	}
+
+	int res = zmq_msgs_append(m_batch, m_batchCount, m_batchCapacity, msg);
+	if(res)
+		m_stats.dropped++;
+
+	return setLastError(res);
+}
+
+/*!
+ * \brief Send #m_batch as one multipart message.
+ *
+ * The batch is kept when the socket is not writable.
+ *
+ * \return 0 on success, \c EAGAIN when the batch is held back, or another errno
+ */
+int ZmqLayer::sendBatch()
+{
+	if(!m_batchCount)
+		return setLastError(0);
+
+	int res = 0;
+	size_t i = 0;
+
+	// A multipart message is delivered atomically. If the first part is
+	// accepted, the others are too.
+	for(; i < m_batchCount; i++) {
+		int flags = ZMQ_DONTWAIT | (i + 1 < m_batchCount ? ZMQ_SNDMORE : 0);
+		if(zmq_msg_send(&m_batch[i], m_socket, flags) == -1) {
+			res = errno;
+			break;
+		}
+	}
+
+	if(res == EAGAIN && i == 0) {
+		// Not writable. Try again later.
+		m_stats.deferred += m_batchCount - m_batchDeferred;
+		m_batchDeferred = m_batchCount;
+		return setLastError(res);
+	}
+
+	m_stats.messages += i;
+	m_stats.dropped += m_batchCount - i;
+	if(i)
+		m_stats.batches++;
+
+	// Sent parts are empty now; close the rest.
+	dropBatch();
+	return setLastError(res);
+}
+
+/*!
+ * \brief Release all messages in #m_batch.
+ */
+void ZmqLayer::dropBatch()
+{
+	for(size_t i = 0; i < m_batchCount; i++)
+		zmq_msg_close(&m_batch[i]);
+
+	m_batchCount = 0;
+	m_batchDeferred = 0;
+}
+
+/*!
+ * \brief Enable or disable batching.
+ *
+ * When enabled, encoded messages are held back until #flush() is called, or
+ * until #recv() has processed all available messages. Then, all messages are
+ * sent as one multipart message. This saves a notification of ZeroMQ's I/O
+ * thread per message.
+ *
+ * When used for a stored::Synchronizer, call #flush() on every connection
+ * after stored::Synchronizer::process(), like \c examples/8_sync does, to
+ * send all updates of one cycle as one batch.
+ *
+ * Moreover, every part of a received multipart message is decoded as a
+ * separate message. Therefore, batching should be enabled on both sides.
+ *
+ * Batching is not supported for ROUTER sockets.
+ */
+void ZmqLayer::setBatching(bool enable)
+{
+	stored_assert(!m_router);
+
+	if(!enable)
+		sendBatch();
+
+	m_batching = enable;
+}
+
+/*!
+ * \brief Returns if batching is enabled.
+ * \see #setBatching()
+ */
+bool ZmqLayer::batching() const
+{
+	return m_batching;
+}
+
+/*!
+ * \copydoc stored::ProtocolLayer::flush()
+ * \details The messages that are held back by #batching() are sent.
+ */
+bool ZmqLayer::flush()
+{
+	bool res = !m_batchCount || !sendBatch();
+	return base::flush() && res;
+}
+
+/*!
+ * \copydoc stored::ProtocolLayer::writable()
+ * \details The socket is writable when ZeroMQ would accept another message
+ *	without blocking. Otherwise, the high-water mark has been reached, or
+ *	there is no peer. Messages held back by #batching() are not sent; call
+ *	#flush() for that.
+ */
+bool ZmqLayer::writable()
+{
+	int events = 0;
+	size_t size = sizeof(events);
+
+	if(zmq_getsockopt(m_socket, ZMQ_EVENTS, &events, &size) == -1
+	   || !(events & ZMQ_POLLOUT))
+		return false;
+
+	return base::writable();
+}
+
+/*!
+ * \brief Returns the send statistics.
+ */
+ZmqLayer::Stats const& ZmqLayer::stats() const
+{
+	return m_stats;
+}
+
+/*!
+ * \brief Reset all #stats() to zero.
+ */
+void ZmqLayer::resetStats()
+{
+	m_stats = Stats();
 }
 
 
@@ -312,6 +854,23 @@ void ZmqLayer::encode(void const* buffer, size_t len, bool last)
 // DebugZmqLayer
 //
 
+/*!
+ * \brief Bind the given socket to the given TCP port on all interfaces.
+ * \return 0 on success, otherwise an errno
+ */
+static int zmq_bind_port(void* socket, int port)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays)
+	char bind[32] = {};
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+	// flawfinder: ignore
+	if(snprintf(bind, sizeof(bind) - 1, "tcp://*:%" PRIu16, (uint16_t)port) < 0)
+		return ENOMEM;
+	if(zmq_bind(socket, bind) == -1)
+		return errno;
+	return 0;
+}
+
 /*!
  * \brief Constructor.
  *
@@ -326,14 +885,7 @@ DebugZmqLayer::DebugZmqLayer(void* context, int port, ProtocolLayer* up, Protoco
 	if(lastError())
 		return;
 
-	// NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays)
-	char bind[32] = {};
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
-	// flawfinder: ignore
-	if(snprintf(bind, sizeof(bind) - 1, "tcp://*:%" PRIu16, (uint16_t)port) < 0)
-		setLastError(ENOMEM);
-	else if(zmq_bind(socket(), bind) == -1)
-		setLastError(errno);
+	setLastError(zmq_bind_port(socket(), port));
 }
 
 int DebugZmqLayer::recv(long timeout_us)
@@ -350,6 +902,50 @@ int DebugZmqLayer::recv(long timeout_us)
 }
 
 
+//////////////////////////////
+// DebugZmqRouterLayer
+//
+
+/*!
+ * \brief Constructor.
+ *
+ * The given \p port is used for a ROUTER socket over TCP, where multiple
+ * clients like the \c libstored.gui can connect to at the same time.
+ *
+ * \see #stored::Debugger
+ */
+DebugZmqRouterLayer::DebugZmqRouterLayer(
+	void* context, int port, ProtocolLayer* up, ProtocolLayer* down)
+	: base(context, ZMQ_ROUTER, up, down)
+{
+	if(lastError())
+		return;
+
+	setLastError(zmq_bind_port(socket(), port));
+}
+
+
+//////////////////////////////
+// DebugZmqPubLayer
+//
+
+/*!
+ * \brief Constructor.
+ *
+ * The given \p port is used for a PUB socket over TCP.
+ *
+ * \see #stored::Debugger::setPublisher()
+ */
+DebugZmqPubLayer::DebugZmqPubLayer(void* context, int port, ProtocolLayer* up, ProtocolLayer* down)
+	: base(context, ZMQ_PUB, up, down)
+{
+	if(lastError())
+		return;
+
+	setLastError(zmq_bind_port(socket(), port));
+}
+
+
 //////////////////////////////
 // SyncZmqLayer
 //
@@ -379,6 +975,16 @@ SyncZmqLayer::SyncZmqLayer(
 		setLastError(errno);
 }
 
+/*!
+ * \brief Dtor.
+ *
+ * Messages that are held back by #batching() are sent, if possible.
+ */
+SyncZmqLayer::~SyncZmqLayer()
+{
+	flush();
+}
+
 } // namespace stored
 #else  // !STORED_HAVE_ZMQ
 char dummy_char_to_make_zmq_cpp_non_empty = 0; // NOLINT
@@ -4,6 +4,8 @@
 
 #include <stored>
 
+#include <cstring>
+
 class EchoLayer : public stored::ProtocolLayer {
 	STORED_CLASS_NOCOPY(EchoLayer)
 public:
@@ -49,10 +51,15 @@ private:
 	stored::ProtocolLayer* m_pipe;
 };
 
-int main()
+int main(int argc, char** argv)
 {
 	EchoLayer e;
 	stored::CompressLayer c;
+
+	// The optional argument is the dictionary to prime the window with.
+	if(argc > 1)
+		c.setDictionary(argv[1], strlen(argv[1]));
+
 	stored::PrintLayer log(stderr);
 	StdioLayer stdio(e);
 	log.setUp(&e);
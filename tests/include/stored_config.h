@@ -139,9 +139,11 @@ namespace stored {
 struct Config : public DefaultConfig {
 	template <typename T>
 	struct Allocator {
-		typedef TestAllocator<T> type;
+		typedef TrackingAllocator<T, TestAllocator<T> /**/> type;
 	};
 
+	static bool const TrackAllocations = true;
+
 	static bool const DebuggerReadMem = true;
 	static bool const DebuggerWriteMem = true;
 };
@@ -0,0 +1,673 @@
+// SPDX-FileCopyrightText: 2020-2023 Jochem Rutgers
+//
+// SPDX-License-Identifier: MPL-2.0
+
+// Compression benchmark.
+//
+// A corpus of typical traffic is generated with the test store: debugger
+// responses, the list output, trace streams (plain, and with the trace
+// codec), and synchronizer messages.  Every message of a corpus is
+// compressed separately, like the CompressLayer does, by heatshrink with a
+// range of window and lookahead settings, and by the CompressLayer itself.
+// The compression ratio, the encode and decode throughput, and the memory
+// of the encoder and decoder are printed.
+
+#include "TestStore.h"
+
+#include <stored>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef STORED_HAVE_HEATSHRINK
+extern "C" {
+#	include <heatshrink_decoder.h>
+#	include <heatshrink_encoder.h>
+}
+#endif
+
+static size_t iterations = 10;
+static size_t samples = 1000;
+static std::vector<unsigned int> windows = {6, 8, 10, 12};
+static std::vector<unsigned int> lookaheads = {3, 4, 5, 6};
+
+/*!
+ * \brief A set of messages, which are compressed one by one.
+ */
+struct Corpus {
+	std::string name;
+	std::vector<std::string> messages;
+
+	size_t size() const
+	{
+		size_t s = 0;
+		for(auto const& m : messages)
+			s += m.size();
+		return s;
+	}
+};
+
+/*!
+ * \brief Collects all encoded messages and decoded data, and passes them on.
+ */
+class Capture : public stored::ProtocolLayer {
+	STORED_CLASS_NOCOPY(Capture)
+public:
+	typedef stored::ProtocolLayer base;
+
+	Capture() = default;
+
+	virtual void decode(void* buffer, size_t len) override
+	{
+		decoded.append(static_cast<char const*>(buffer), len);
+		base::decode(buffer, len);
+	}
+
+	virtual void encode(void const* buffer, size_t len, bool last = true) override
+	{
+		m_partial.append(static_cast<char const*>(buffer), len);
+		if(last) {
+			messages.push_back(m_partial);
+			m_partial.clear();
+		}
+		base::encode(buffer, len, last);
+	}
+
+	using base::encode;
+
+	std::vector<std::string> messages;
+	std::string decoded;
+
+private:
+	std::string m_partial;
+};
+
+static void request(stored::Debugger& d, char const* req)
+{
+	std::string r(req);
+	d.decode(&r[0], r.size());
+}
+
+static std::string decompress(std::string s)
+{
+	if(!stored::Config::CompressStreams || s.empty())
+		return s;
+
+	Capture out;
+	stored::CompressLayer c;
+	c.wrap(out);
+	c.decode(&s[0], s.size());
+	return out.decoded;
+}
+
+//////////////////////////////////////////////
+// Corpus
+//
+
+/*!
+ * \brief Responses of a client that polls a few variables.
+ */
+static Corpus corpusDebugger()
+{
+	stored::Debugger d;
+	stored::TestStore store;
+	d.map(store);
+	Capture c;
+	c.wrap(d);
+
+	request(d, "?");
+	request(d, "v");
+
+	for(size_t i = 0; i < samples; i++) {
+		store.default_int32 = (int32_t)(i * 37U);
+		store.default_uint16 = (uint16_t)(i / 10U);
+		store.default_float = (float)std::sin((double)i / 10.0);
+		store.default_double = (double)i * 0.001;
+
+		request(d, "r/default int32");
+		request(d, "r/default uint16");
+		request(d, "r/default float");
+		request(d, "r/default double");
+		request(d, (i & 1U) ? "w1/default bool" : "w0/default bool");
+	}
+
+	return Corpus{"debugger", std::move(c.messages)};
+}
+
+/*!
+ * \brief The response to the list command.
+ */
+static Corpus corpusList()
+{
+	stored::Debugger d;
+	stored::TestStore store;
+	d.map(store);
+	Capture c;
+	c.wrap(d);
+
+	request(d, "l");
+	return Corpus{"list", std::move(c.messages)};
+}
+
+/*!
+ * \brief Trace samples of a few slowly changing signals, as read in chunks by the client.
+ * \param layout the trace codec layout, or empty for the plain macro output
+ */
+static Corpus corpusTrace(char const* name, char const* layout)
+{
+	stored::Debugger d;
+	stored::TestStore store;
+	d.map(store);
+	Capture c;
+	c.wrap(d);
+
+	request(d, "mt|e\n|r/default uint32|e;|r/default int16|e;|r/default float|e;|r/default "
+		   "double|e;|r/default uint8");
+	request(d, "ttT");
+	request(d, (std::string("c") + layout).c_str());
+
+	// The number of samples per poll of the client.
+	size_t const chunk = 16;
+	Corpus corpus{name, {}};
+
+	for(size_t i = 0; i < samples; i++) {
+		double x = (double)i / 50.0;
+		store.default_uint32 = (uint32_t)(i * 1000U);
+		store.default_int16 = (int16_t)(1000.0 * std::sin(x));
+		store.default_float = (float)std::sin(x);
+		store.default_double = std::cos(x) + (double)(i % 7U) * 1e-3;
+		store.default_uint8 = (uint8_t)(i / 100U);
+		d.trace();
+
+		if(i % chunk == chunk - 1 || i + 1 == samples) {
+			request(d, "fT");
+			c.messages.clear();
+			request(d, "sT");
+			corpus.messages.push_back(decompress(c.messages.at(0)));
+		}
+	}
+
+	return corpus;
+}
+
+class SyncTestStore : public STORE_T(
+			      SyncTestStore, stored::TestStoreDefaultFunctions,
+			      stored::Synchronizable, stored::TestStoreBase) {
+	STORE_CLASS(
+		SyncTestStore, stored::TestStoreDefaultFunctions, stored::Synchronizable,
+		stored::TestStoreBase)
+
+public:
+	SyncTestStore() = default;
+};
+
+/*!
+ * \brief Messages of two synchronizing stores, of which some variables change every cycle.
+ */
+static Corpus corpusSync()
+{
+	std::unique_ptr<SyncTestStore> store1(new SyncTestStore());
+	std::unique_ptr<SyncTestStore> store2(new SyncTestStore());
+	stored::Synchronizer s1;
+	stored::Synchronizer s2;
+	stored::FifoLoopback<SyncTestStore::MaxMessageSize * 2, 16> loop;
+	Capture c1;
+	Capture c2;
+
+	loop.a().wrap(c1);
+	loop.b().wrap(c2);
+	s1.map(*store1);
+	s2.map(*store2);
+	s1.connect(c1);
+	s2.connect(c2);
+	s2.syncFrom(*store2, c2);
+
+	for(size_t i = 0; i < samples; i++) {
+		store1->default_int8 = (int8_t)i;
+		store1->default_int16 = (int16_t)i;
+		store1->default_int32 = (int32_t)i;
+		store1->default_float = (float)std::sin((double)i / 10.0);
+
+		loop.b2a().recvAll();
+		s1.process();
+		loop.a2b().recvAll();
+		s2.process();
+	}
+
+	Corpus corpus{"sync", std::move(c1.messages)};
+	corpus.messages.insert(corpus.messages.end(), c2.messages.begin(), c2.messages.end());
+	return corpus;
+}
+
+/*!
+ * \brief A corpus from a file, split in messages of at most 1 KB.
+ */
+static bool corpusFile(char const* filename, std::vector<Corpus>& corpora)
+{
+	std::ifstream f(filename, std::ios::binary);
+	if(!f)
+		return false;
+
+	std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+	char const* name = strrchr(filename, '/');
+	Corpus corpus{name ? name + 1 : filename, {}};
+	for(size_t i = 0; i < data.size(); i += 1024)
+		corpus.messages.push_back(data.substr(i, 1024));
+
+	corpora.push_back(std::move(corpus));
+	return true;
+}
+
+#ifdef STORED_HAVE_HEATSHRINK
+//////////////////////////////////////////////
+// Codecs
+//
+
+class Codec {
+	STORED_CLASS_NOCOPY(Codec)
+public:
+	Codec() = default;
+	virtual ~Codec() = default;
+	virtual char const* name() const = 0;
+	/*! \brief Called at the start of every pass over a corpus. */
+	virtual void restart() {}
+	virtual void encode(std::string const& in, std::string& out) = 0;
+	virtual void decode(std::string const& in, std::string& out) = 0;
+	virtual size_t encoderMemory() const = 0;
+	virtual size_t decoderMemory() const = 0;
+};
+
+/*!
+ * \brief Approximate heap usage of a heatshrink encoder, as allocated by \c heatshrink_encoder_alloc().
+ */
+static size_t encoderMemory(unsigned int window)
+{
+	size_t buffer = 2U << window;
+	size_t size = sizeof(heatshrink_encoder) + buffer;
+#	if defined(HEATSHRINK_USE_INDEX) && HEATSHRINK_USE_INDEX
+	size += sizeof(uint16_t) * (buffer + 1U);
+#	endif
+	return size;
+}
+
+/*!
+ * \brief Approximate heap usage of a heatshrink decoder, as allocated by \c heatshrink_decoder_alloc().
+ */
+static size_t decoderMemory(unsigned int window)
+{
+	return sizeof(heatshrink_decoder) + stored::CompressLayer::DecodeInputBuffer
+	       + (1U << window);
+}
+
+/*!
+ * \brief heatshrink with the given window and lookahead.
+ */
+class HeatshrinkCodec : public Codec {
+public:
+	HeatshrinkCodec(unsigned int window, unsigned int lookahead)
+		: m_window(window)
+		, m_encoder(heatshrink_encoder_alloc((uint8_t)window, (uint8_t)lookahead))
+		, m_decoder(heatshrink_decoder_alloc(
+			  stored::CompressLayer::DecodeInputBuffer, (uint8_t)window,
+			  (uint8_t)lookahead))
+	{
+		snprintf(m_name, sizeof(m_name), "hs w%u l%u", window, lookahead);
+	}
+
+	virtual ~HeatshrinkCodec() override
+	{
+		if(m_encoder)
+			heatshrink_encoder_free(m_encoder);
+		if(m_decoder)
+			heatshrink_decoder_free(m_decoder);
+	}
+
+	bool valid() const
+	{
+		return m_encoder && m_decoder;
+	}
+
+	virtual char const* name() const override
+	{
+		return m_name;
+	}
+
+	virtual void encode(std::string const& in, std::string& out) override
+	{
+		heatshrink_encoder_reset(m_encoder);
+		out.clear();
+
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+		uint8_t* p = (uint8_t*)const_cast<char*>(in.data());
+		size_t len = in.size();
+
+		while(len > 0) {
+			size_t sunk = 0;
+			heatshrink_encoder_sink(m_encoder, p, len, &sunk);
+			p += sunk;
+			len -= sunk;
+			pollEncoder(out);
+		}
+
+		while(heatshrink_encoder_finish(m_encoder) == HSER_FINISH_MORE)
+			pollEncoder(out);
+	}
+
+	virtual void decode(std::string const& in, std::string& out) override
+	{
+		heatshrink_decoder_reset(m_decoder);
+		out.clear();
+
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+		uint8_t* p = (uint8_t*)const_cast<char*>(in.data());
+		size_t len = in.size();
+
+		while(len > 0) {
+			size_t sunk = 0;
+			heatshrink_decoder_sink(m_decoder, p, len, &sunk);
+			p += sunk;
+			len -= sunk;
+			pollDecoder(out);
+		}
+
+		while(heatshrink_decoder_finish(m_decoder) == HSDR_FINISH_MORE)
+			pollDecoder(out);
+	}
+
+	virtual size_t encoderMemory() const override
+	{
+		return ::encoderMemory(m_window);
+	}
+
+	virtual size_t decoderMemory() const override
+	{
+		return ::decoderMemory(m_window);
+	}
+
+private:
+	void pollEncoder(std::string& out)
+	{
+		HSE_poll_res res = HSER_POLL_MORE;
+		while(res == HSER_POLL_MORE) {
+			size_t len = 0;
+			res = heatshrink_encoder_poll(m_encoder, m_buffer, sizeof(m_buffer), &len);
+			out.append((char const*)m_buffer, len);
+		}
+	}
+
+	void pollDecoder(std::string& out)
+	{
+		HSD_poll_res res = HSDR_POLL_MORE;
+		while(res == HSDR_POLL_MORE) {
+			size_t len = 0;
+			res = heatshrink_decoder_poll(m_decoder, m_buffer, sizeof(m_buffer), &len);
+			out.append((char const*)m_buffer, len);
+		}
+	}
+
+private:
+	unsigned int m_window;
+	heatshrink_encoder* m_encoder;
+	heatshrink_decoder* m_decoder;
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays)
+	uint8_t m_buffer[256];
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays)
+	char m_name[32];
+};
+
+/*!
+ * \brief The CompressLayer, as configured, optionally with history priming or adaptive mode.
+ */
+class LayerCodec : public Codec {
+public:
+	LayerCodec(char const* name, bool history, bool adaptive)
+		: m_name(name)
+	{
+		m_encodeOut.wrap(m_encoder);
+		m_decoder.wrap(m_decodeOut);
+
+		m_encoder.setHistory(history);
+		m_decoder.setHistory(history);
+		m_encoder.setAdaptive(adaptive);
+		m_decoder.setAdaptive(adaptive);
+	}
+
+	virtual char const* name() const override
+	{
+		return m_name;
+	}
+
+	virtual void restart() override
+	{
+		// Both sides should start with the same history every pass.
+		m_encoder.resetHistory();
+		m_decoder.resetHistory();
+	}
+
+	virtual void encode(std::string const& in, std::string& out) override
+	{
+		m_encodeOut.messages.clear();
+		m_encoder.encode(in.data(), in.size());
+		out.clear();
+		if(!m_encodeOut.messages.empty())
+			out.swap(m_encodeOut.messages.front());
+	}
+
+	virtual void decode(std::string const& in, std::string& out) override
+	{
+		m_decodeOut.decoded.clear();
+		m_buffer.assign(in.begin(), in.end());
+		m_decoder.decode(m_buffer.empty() ? nullptr : &m_buffer[0], m_buffer.size());
+		out.swap(m_decodeOut.decoded);
+	}
+
+	virtual size_t encoderMemory() const override
+	{
+		return sizeof(stored::CompressLayer) + ::encoderMemory(stored::CompressLayer::Window);
+	}
+
+	virtual size_t decoderMemory() const override
+	{
+		return sizeof(stored::CompressLayer) + ::decoderMemory(stored::CompressLayer::Window);
+	}
+
+private:
+	char const* m_name;
+	stored::CompressLayer m_encoder;
+	Capture m_encodeOut;
+	stored::CompressLayer m_decoder;
+	Capture m_decodeOut;
+	std::vector<char> m_buffer;
+};
+
+//////////////////////////////////////////////
+// Benchmark
+//
+
+static uint64_t now() noexcept
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+static void bench(Corpus const& corpus, Codec& codec)
+{
+	std::vector<std::string> encoded(corpus.messages.size());
+	std::string decoded;
+	size_t size = corpus.size();
+	size_t compressed = 0;
+
+	uint64_t start = now();
+	for(size_t it = 0; it < iterations; it++) {
+		codec.restart();
+		for(size_t i = 0; i < corpus.messages.size(); i++)
+			codec.encode(corpus.messages[i], encoded[i]);
+	}
+	uint64_t encodeTime = now() - start;
+
+	for(auto const& e : encoded)
+		compressed += e.size();
+
+	start = now();
+	for(size_t it = 0; it < iterations; it++) {
+		codec.restart();
+		for(size_t i = 0; i < encoded.size(); i++) {
+			codec.decode(encoded[i], decoded);
+			if(decoded != corpus.messages[i]) {
+				fprintf(stderr, "%s: %s message %zu does not decode correctly\n",
+					corpus.name.c_str(), codec.name(), i);
+				exit(1);
+			}
+		}
+	}
+	uint64_t decodeTime = now() - start;
+
+	double mb = (double)(size * iterations) / 1e6;
+	printf("%-12s %-12s %8zu %8zu %6.3f %10.1f %10.1f %8zu %8zu\n", corpus.name.c_str(),
+	       codec.name(), corpus.messages.size(), size,
+	       size ? (double)compressed / (double)size : 1.0,
+	       encodeTime ? mb * 1e9 / (double)encodeTime : 0.0,
+	       decodeTime ? mb * 1e9 / (double)decodeTime : 0.0, codec.encoderMemory(),
+	       codec.decoderMemory());
+	fflush(stdout);
+}
+
+static void bench(Corpus const& corpus)
+{
+	for(unsigned int window : windows)
+		for(unsigned int lookahead : lookaheads) {
+			if(lookahead >= window)
+				continue;
+
+			HeatshrinkCodec codec(window, lookahead);
+			if(!codec.valid()) {
+				printf("%-12s %-12s (cannot allocate)\n", corpus.name.c_str(),
+				       codec.name());
+				continue;
+			}
+
+			bench(corpus, codec);
+		}
+
+	LayerCodec layer("layer", false, false);
+	bench(corpus, layer);
+	LayerCodec history("layer hist", true, false);
+	bench(corpus, history);
+	LayerCodec adaptive("layer adapt", false, true);
+	bench(corpus, adaptive);
+}
+#endif // STORED_HAVE_HEATSHRINK
+
+static void help(char const* progname)
+{
+	printf("Usage: %s [-n <iterations>] [-s <samples>] [-w <windows>] [-l <lookaheads>] "
+	       "[-f <file>]*\n",
+	       progname);
+	printf("\n");
+	printf("-w and -l take a comma-separated list, like 8,10.\n");
+	printf("-f adds the contents of the file as corpus.\n");
+}
+
+static bool arg(int argc, char** argv, int& i, size_t& value)
+{
+	if(i + 1 >= argc)
+		return false;
+
+	int n = std::atoi(argv[++i]);
+	if(n <= 0)
+		return false;
+
+	value = (size_t)n;
+	return true;
+}
+
+static bool arg(int argc, char** argv, int& i, std::vector<unsigned int>& list)
+{
+	if(i + 1 >= argc)
+		return false;
+
+	list.clear();
+	for(char const* s = argv[++i]; *s;) {
+		char* end = nullptr;
+		unsigned long v = strtoul(s, &end, 10);
+		if(end == s || v < 1 || v > 15)
+			return false;
+
+		list.push_back((unsigned int)v);
+		s = *end == ',' ? end + 1 : end;
+		if(*end && *end != ',')
+			return false;
+	}
+
+	return !list.empty();
+}
+
+int main(int argc, char** argv)
+{
+	printf("%s\n\n", stored::banner());
+	printf("Compression performance tester\n\n");
+
+	std::vector<char const*> files;
+
+	for(int i = 1; i < argc; i++) {
+		bool ok = false;
+		if(strcmp(argv[i], "-n") == 0)
+			ok = arg(argc, argv, i, iterations);
+		else if(strcmp(argv[i], "-s") == 0)
+			ok = arg(argc, argv, i, samples);
+		else if(strcmp(argv[i], "-w") == 0)
+			ok = arg(argc, argv, i, windows);
+		else if(strcmp(argv[i], "-l") == 0)
+			ok = arg(argc, argv, i, lookaheads);
+		else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			files.push_back(argv[++i]);
+			ok = true;
+		}
+
+		if(!ok) {
+			help(argv[0]);
+			return strcmp(argv[i], "-h") == 0 ? 0 : 1;
+		}
+	}
+
+	std::vector<Corpus> corpora;
+	corpora.push_back(corpusDebugger());
+	corpora.push_back(corpusList());
+	corpora.push_back(corpusTrace("trace", ""));
+	corpora.push_back(corpusTrace("trace codec", "_i_i_f_d_i"));
+	corpora.push_back(corpusSync());
+
+	for(char const* file : files)
+		if(!corpusFile(file, corpora)) {
+			perror(file);
+			return 1;
+		}
+
+#ifdef STORED_HAVE_HEATSHRINK
+	printf("Running %zu iterations per benchmark...\n\n", iterations);
+	printf("%-12s %-12s %8s %8s %6s %10s %10s %8s %8s\n", "corpus", "codec", "messages",
+	       "bytes", "ratio", "enc MB/s", "dec MB/s", "enc mem", "dec mem");
+
+	for(auto const& corpus : corpora)
+		bench(corpus);
+#else
+	printf("%-12s %8s %8s\n", "corpus", "messages", "bytes");
+	for(auto const& corpus : corpora)
+		printf("%-12s %8zu %8zu\n", corpus.name.c_str(), corpus.messages.size(),
+		       corpus.size());
+
+	printf("\nheatshrink is not available; nothing to compress.\n");
+#endif
+
+	// Done.
+}
@@ -0,0 +1,343 @@
+// SPDX-FileCopyrightText: 2020-2023 Jochem Rutgers
+//
+// SPDX-License-Identifier: MPL-2.0
+
+// FIFO throughput and latency benchmark.
+//
+// A producer thread pushes timestamped elements/messages into a FIFO, and a
+// consumer thread pops them.  The throughput is the number of elements
+// passed per second; the latency is the time between the push and pop of
+// one element, which includes the time it was queued.
+
+#include <libstored/fifo.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef STORED_OS_LINUX
+#	include <pthread.h>
+#	include <sched.h>
+#endif
+
+static size_t iterations = 100000;
+static int cpus[2] = {0, 1};
+
+static uint64_t now() noexcept
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+enum Placement { SameCore, CrossCore, Unpinned };
+
+static char const* placementName(Placement placement)
+{
+	switch(placement) {
+	case SameCore:
+		return "same";
+	case CrossCore:
+		return "cross";
+	case Unpinned:
+	default:
+		return "none";
+	}
+}
+
+static bool pin(int cpu)
+{
+#ifdef STORED_OS_LINUX
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+
+static bool pin(Placement placement, bool producer)
+{
+	switch(placement) {
+	case SameCore:
+		return pin(cpus[0]);
+	case CrossCore:
+		return pin(cpus[producer ? 0 : 1]);
+	case Unpinned:
+	default:
+		return true;
+	}
+}
+
+/*!
+ * \brief Run one benchmark and print the results.
+ *
+ * \p produce is called with the maximum number of elements to push, and
+ * returns the number actually pushed. \p consume gets a pointer to store the
+ * latencies of at most the given number of elements, and returns the number
+ * of popped elements.
+ */
+template <typename Produce, typename Consume>
+static void run(
+	char const* fifo, size_t element, size_t capacity, size_t batch, Placement placement,
+	Produce&& produce, Consume&& consume)
+{
+	std::vector<uint64_t> latency(iterations);
+	std::atomic<int> ready{0};
+	std::atomic<bool> pinned{true};
+
+	std::thread p([&]() {
+		if(!pin(placement, true))
+			pinned = false;
+		ready++;
+		while(ready.load() < 2)
+			std::this_thread::yield();
+
+		for(size_t i = 0; i < iterations;) {
+			size_t cnt = produce(std::min(batch, iterations - i));
+			if(!cnt)
+				std::this_thread::yield();
+			i += cnt;
+		}
+	});
+
+	if(!pin(placement, false))
+		pinned = false;
+
+	ready++;
+	while(ready.load() < 2)
+		std::this_thread::yield();
+
+	uint64_t start = now();
+
+	for(size_t i = 0; i < iterations;) {
+		size_t cnt = consume(&latency[i], std::min(batch, iterations - i));
+		if(!cnt)
+			std::this_thread::yield();
+		i += cnt;
+	}
+
+	uint64_t end = now();
+	p.join();
+
+	std::sort(latency.begin(), latency.end());
+
+	printf("%-13s %6zu %8zu %6zu %-6s %12.0f %10.0f %10.0f\n", fifo, element, capacity, batch,
+	       pinned ? placementName(placement) : "n/a",
+	       (double)iterations * 1e9 / (double)(end - start),
+	       (double)latency[iterations / 2], (double)latency[iterations * 99 / 100]);
+	fflush(stdout);
+}
+
+template <size_t Element, size_t Capacity>
+static void benchFifo(size_t batch, Placement placement)
+{
+	struct Item {
+		uint64_t ts;
+		std::array<char, Element - sizeof(uint64_t)> payload;
+	};
+
+	stored::Fifo<Item, Capacity> f;
+
+	run("Fifo", Element, Capacity, batch, placement,
+	    [&](size_t count) -> size_t {
+		    if(count == 1) {
+			    if(f.full())
+				    return 0;
+
+			    Item item{};
+			    item.ts = now();
+			    f.push_back(item);
+			    return 1;
+		    }
+
+		    Item* p = f.reserve(count);
+		    if(!p)
+			    return 0;
+
+		    uint64_t ts = now();
+		    for(size_t i = 0; i < count; i++)
+			    p[i].ts = ts;
+
+		    f.commit(count);
+		    return count;
+	    },
+	    [&](uint64_t* latency, size_t count) -> size_t {
+		    if(f.empty())
+			    return 0;
+
+		    count = std::min(count, f.available());
+		    uint64_t ts = now();
+		    for(size_t i = 0; i < count; i++)
+			    latency[i] = ts - f.peek(i).ts;
+
+		    f.pop_front(count);
+		    return count;
+	    });
+}
+
+template <size_t Element, size_t Capacity>
+static void benchMessageFifo(size_t batch, Placement placement)
+{
+	stored::MessageFifo<Capacity> f;
+
+	run("MessageFifo", Element, Capacity, batch, placement,
+	    [&](size_t count) -> size_t {
+		    uint64_t ts = now();
+		    size_t i = 0;
+
+		    for(; i < count && !f.full(); i++) {
+			    stored::Message m = f.reserve(Element);
+			    if(!m.data())
+				    break;
+
+			    memcpy(m.data(), &ts, sizeof(ts));
+			    if(!f.commit(Element)) {
+				    f.reset_back();
+				    break;
+			    }
+		    }
+
+		    return i;
+	    },
+	    [&](uint64_t* latency, size_t count) -> size_t {
+		    uint64_t ts = now();
+		    size_t i = 0;
+
+		    for(; i < count && !f.empty(); i++) {
+			    uint64_t pushed = 0;
+			    memcpy(&pushed, f.front().data(), sizeof(pushed));
+			    latency[i] = ts - pushed;
+			    f.pop_front();
+		    }
+
+		    return i;
+	    });
+}
+
+class LatencyLayer : public stored::ProtocolLayer {
+	STORED_CLASS_NOCOPY(LatencyLayer)
+public:
+	typedef stored::ProtocolLayer base;
+
+	LatencyLayer() = default;
+
+	virtual void decode(void* buffer, size_t len) override
+	{
+		uint64_t pushed = 0;
+		if(len >= sizeof(pushed))
+			memcpy(&pushed, buffer, sizeof(pushed));
+
+		*latency++ = now() - pushed;
+	}
+
+	uint64_t* latency = nullptr;
+};
+
+template <size_t Element, size_t Capacity>
+static void benchFifoLoopback(size_t batch, Placement placement)
+{
+	stored::FifoLoopback1<Capacity> l;
+	LatencyLayer top;
+	l.wrap(top);
+	l.setOverflowHandler([]() {
+		std::this_thread::yield();
+		return true;
+	});
+
+	run("FifoLoopback1", Element, Capacity, batch, placement,
+	    [&](size_t count) -> size_t {
+		    std::array<char, Element> buffer{};
+
+		    for(size_t i = 0; i < count; i++) {
+			    uint64_t ts = now();
+			    memcpy(buffer.data(), &ts, sizeof(ts));
+			    l.encode(buffer.data(), buffer.size());
+		    }
+
+		    return count;
+	    },
+	    [&](uint64_t* latency, size_t count) -> size_t {
+		    top.latency = latency;
+		    size_t i = 0;
+
+		    for(; i < count && l.recv() == 0; i++)
+			    ;
+
+		    return i;
+	    });
+}
+
+template <size_t Element, size_t Capacity>
+static void bench(size_t batch, std::vector<Placement> const& placements)
+{
+	for(auto placement : placements)
+		benchFifo<Element, Capacity>(batch, placement);
+	for(auto placement : placements)
+		benchMessageFifo<Element, Capacity * Element>(batch, placement);
+	for(auto placement : placements)
+		benchFifoLoopback<Element, Capacity * Element>(batch, placement);
+}
+
+static void help(char const* progname)
+{
+	printf("Usage: %s [-n <iterations>] [-c <producer cpu>,<consumer cpu>]\n", progname);
+}
+
+int main(int argc, char** argv)
+{
+	printf("%s\n\n", stored::banner());
+	printf("FIFO performance tester\n\n");
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			int n = std::atoi(argv[++i]);
+			if(n <= 0) {
+				help(argv[0]);
+				return 1;
+			}
+			iterations = (size_t)n;
+		} else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			if(sscanf(argv[++i], "%d,%d", &cpus[0], &cpus[1]) != 2) {
+				help(argv[0]);
+				return 1;
+			}
+		} else {
+			help(argv[0]);
+			return strcmp(argv[i], "-h") == 0 ? 0 : 1;
+		}
+	}
+
+	std::vector<Placement> placements;
+#ifdef STORED_OS_LINUX
+	placements.push_back(SameCore);
+	if(std::thread::hardware_concurrency() > 1)
+		placements.push_back(CrossCore);
+	else
+		printf("Only one CPU available; skipping cross-core runs.\n\n");
+#else
+	placements.push_back(Unpinned);
+#endif
+
+	printf("Running %zu iterations per benchmark...\n\n", iterations);
+	printf("%-13s %6s %8s %6s %-6s %12s %10s %10s\n", "fifo", "size", "capacity", "batch",
+	       "cores", "ops/s", "p50 (ns)", "p99 (ns)");
+
+	for(size_t batch : {1, 32}) {
+		bench<8, 16>(batch, placements);
+		bench<8, 1024>(batch, placements);
+		bench<64, 16>(batch, placements);
+		bench<64, 1024>(batch, placements);
+		bench<256, 64>(batch, placements);
+	}
+
+	// Done.
+}
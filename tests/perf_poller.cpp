@@ -0,0 +1,188 @@
+// SPDX-FileCopyrightText: 2020-2023 Jochem Rutgers
+//
+// SPDX-License-Identifier: MPL-2.0
+
+// Poller dispatch benchmark.
+//
+// Many idle pipes and a few active ones are registered to a poller.  Every
+// iteration, all active pipes get a byte written, and the poller is asked to
+// deliver the events, either via poll() and its result list, or via
+// runOnce(), which dispatches the ready set directly to a callback.
+
+#include <libstored/poller.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+static size_t iterations = 10000;
+static size_t idle = 4000;
+static size_t active = 4;
+
+static uint64_t now() noexcept
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		       std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+struct Pipe {
+	Pipe()
+	{
+		if(pipe(fd)) {
+			perror("pipe");
+			exit(1);
+		}
+	}
+
+	~Pipe()
+	{
+		close(fd[0]);
+		close(fd[1]);
+	}
+
+	void notify()
+	{
+		if(write(fd[1], "1", 1) != 1)
+			abort();
+	}
+
+	void consume()
+	{
+		char c = 0;
+		if(read(fd[0], &c, 1) != 1)
+			abort();
+	}
+
+	int fd[2] = {-1, -1};
+};
+
+static void report(char const* poller, char const* dispatch, uint64_t dt)
+{
+	printf("%-8s %-8s %8zu %6zu %12.0f %10.0f\n", poller, dispatch, idle, active,
+	       (double)(iterations * active) * 1e9 / (double)dt, (double)dt / (double)iterations);
+	fflush(stdout);
+}
+
+template <typename PollerImpl>
+static void bench(char const* name)
+{
+	std::vector<std::unique_ptr<Pipe>> pipes;
+	std::vector<std::unique_ptr<stored::PollableFd>> pollables;
+	stored::CustomPoller<PollerImpl> poller;
+
+	poller.reserve(idle + active);
+
+	for(size_t i = 0; i < idle + active; i++) {
+		pipes.emplace_back(new Pipe());
+		pollables.emplace_back(new stored::PollableFd(
+			pipes.back()->fd[0], stored::Pollable::PollIn, pipes.back().get()));
+		if(poller.add(*pollables.back())) {
+			perror("add");
+			exit(1);
+		}
+	}
+
+	// The active ones are spread over the set.
+	std::vector<Pipe*> act;
+	for(size_t i = 0; i < active; i++)
+		act.push_back(pipes[(i * (idle + active)) / active].get());
+
+	uint64_t start = now();
+
+	for(size_t i = 0; i < iterations; i++) {
+		for(auto* p : act)
+			p->notify();
+
+		auto const& res = poller.poll(-1);
+		for(auto const& r : res)
+			static_cast<Pipe*>(r->user_data)->consume();
+	}
+
+	report(name, "poll", now() - start);
+
+	auto f = [](stored::Pollable& p) { static_cast<Pipe*>(p.user_data)->consume(); };
+
+	start = now();
+
+	for(size_t i = 0; i < iterations; i++) {
+		for(auto* p : act)
+			p->notify();
+
+		poller.runOnce(f);
+	}
+
+	report(name, "runOnce", now() - start);
+
+	poller.clear();
+}
+
+static void help(char const* progname)
+{
+	printf("Usage: %s [-n <iterations>] [-i <idle fds>] [-a <active fds>]\n", progname);
+}
+
+static bool arg(int argc, char** argv, int& i, size_t& value)
+{
+	if(i + 1 >= argc)
+		return false;
+
+	int n = std::atoi(argv[++i]);
+	if(n <= 0)
+		return false;
+
+	value = (size_t)n;
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	printf("%s\n\n", stored::banner());
+	printf("Poller performance tester\n\n");
+
+	for(int i = 1; i < argc; i++) {
+		bool ok = false;
+		if(strcmp(argv[i], "-n") == 0)
+			ok = arg(argc, argv, i, iterations);
+		else if(strcmp(argv[i], "-i") == 0)
+			ok = arg(argc, argv, i, idle);
+		else if(strcmp(argv[i], "-a") == 0)
+			ok = arg(argc, argv, i, active);
+
+		if(!ok) {
+			help(argv[0]);
+			return strcmp(argv[i], "-h") == 0 ? 0 : 1;
+		}
+	}
+
+	// Every pipe takes two fds.
+	struct rlimit rl = {};
+	rlim_t needed = (rlim_t)((idle + active) * 2U + 16U);
+	if(getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < needed) {
+		rl.rlim_cur = std::min(needed, rl.rlim_max);
+		setrlimit(RLIMIT_NOFILE, &rl);
+		if(rl.rlim_cur < needed) {
+			idle = (size_t)(rl.rlim_cur - 16U) / 2U - active;
+			printf("File descriptor limit too low; reduced to %zu idle fds.\n\n", idle);
+		}
+	}
+
+	printf("Running %zu iterations per benchmark...\n\n", iterations);
+	printf("%-8s %-8s %8s %6s %12s %10s\n", "poller", "dispatch", "idle", "active",
+	       "events/s", "ns/iter");
+
+	bench<stored::PollPoller>("poll");
+#ifdef STORED_OS_LINUX
+	bench<stored::EpollPoller>("epoll");
+	bench<stored::IoUringPoller>("io_uring");
+#endif
+
+	// Done.
+}
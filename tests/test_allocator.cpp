@@ -3,9 +3,13 @@
 // SPDX-License-Identifier: MPL-2.0
 
 #include "libstored/allocator.h"
+#include "libstored/debugger.h"
+#include "libstored/protocol.h"
+#include "libstored/spm.h"
 #include "TestStore.h"
 #include "gtest/gtest.h"
 
+#include <cstring>
 #include <new>
 
 static bool verbose_new;
@@ -325,3 +329,209 @@ TEST_F(Allocator, Store)
 	// No non-allocator allocations are expected.
 	EXPECT_EQ(new_count, 0u);
 }
+
+TEST(PoolAllocator, Reuse)
+{
+	stored::MemoryPool& pool = stored::PoolAllocator<int>::pool();
+	stored::PoolAllocator<int> a;
+
+	int* p = a.allocate(3);
+	EXPECT_EQ((uintptr_t)p % stored::MemoryPool::Alignment, 0u);
+	a.deallocate(p, 3);
+
+	// Same size class, so the same object is returned.
+	stored::PoolAllocator<char> c;
+	char* q = c.allocate(10);
+	EXPECT_EQ((void*)q, (void*)p);
+	c.deallocate(q, 10);
+
+	// Large objects are allocated from the heap.
+	size_t heap = pool.stats().heap;
+	int* l = a.allocate(stored::MemoryPool::MaxClassSize);
+	EXPECT_EQ(pool.stats().heap, heap + 1);
+	a.deallocate(l, stored::MemoryPool::MaxClassSize);
+}
+
+TEST(PoolAllocator, Containers)
+{
+	stored::MemoryPool& pool = stored::PoolAllocator<int>::pool();
+
+	using M = std::map<int, int, std::less<int>, stored::PoolAllocator<std::pair<int const, int>>>;
+	using L = std::list<int, stored::PoolAllocator<int>>;
+
+	for(int run = 0; run < 3; run++) {
+		if(run == 2)
+			// The previous runs have warmed up the pool.
+			pool.setInitComplete();
+
+		size_t heap = pool.stats().heap;
+		size_t allocations = pool.stats().allocations;
+
+		M m;
+		L l;
+		for(int i = 0; i < 100; i++) {
+			m[i] = i;
+			l.push_back(i);
+		}
+
+		EXPECT_GE(pool.stats().allocations, allocations + 200);
+		if(run > 0) {
+			EXPECT_EQ(pool.stats().heap, heap);
+		}
+	}
+
+	pool.setInitComplete(false);
+}
+
+TEST(PoolAllocator, Buffer)
+{
+	stored::MemoryPool& pool = stored::PoolAllocator<int, true>::pool();
+	EXPECT_NE(&pool, &stored::PoolAllocator<int>::pool());
+
+	static char buffer[1000];
+	pool.setBuffer(buffer, sizeof(buffer));
+	size_t heap = pool.stats().heap;
+
+	stored::PoolAllocator<double, true> a;
+	pool.reserve(sizeof(double) * 4, 10);
+	EXPECT_EQ(pool.stats().heap, heap);
+
+	pool.setInitComplete(true, false);
+	double* p[10] = {};
+	for(size_t i = 0; i < 10; i++) {
+		p[i] = a.allocate(4);
+		EXPECT_GE((void*)p[i], (void*)buffer);
+		EXPECT_LT((void*)p[i], (void*)(buffer + sizeof(buffer)));
+	}
+
+	for(size_t i = 0; i < 10; i++)
+		a.deallocate(p[i], 4);
+
+	EXPECT_EQ(pool.stats().heap, heap);
+	pool.setInitComplete(false);
+}
+
+using Tracker = stored::AllocationTracker;
+using TrackedVector = std::vector<int, stored::TrackingAllocator<int>>;
+
+TEST(AllocationTracker, Categories)
+{
+	Tracker::reset();
+	size_t inUse = Tracker::inUse();
+
+	{
+		TrackedVector v(10);
+		EXPECT_EQ(Tracker::stats(Tracker::CategoryOther).allocations, 1u);
+		EXPECT_EQ(Tracker::stats(Tracker::CategoryOther).bytes, sizeof(int) * 10);
+
+		{
+			Tracker::Scope scope(Tracker::CategoryDebugger);
+			EXPECT_EQ(Tracker::category(), Tracker::CategoryDebugger);
+			TrackedVector w(5);
+
+			{
+				Tracker::Scope inner(Tracker::CategoryPoller);
+				TrackedVector x(1);
+			}
+
+			EXPECT_EQ(Tracker::category(), Tracker::CategoryDebugger);
+		}
+
+		EXPECT_EQ(Tracker::category(), Tracker::CategoryOther);
+		EXPECT_EQ(Tracker::stats(Tracker::CategoryDebugger).allocations, 1u);
+		EXPECT_EQ(Tracker::stats(Tracker::CategoryDebugger).deallocations, 1u);
+		EXPECT_EQ(Tracker::stats(Tracker::CategoryPoller).allocations, 1u);
+		EXPECT_EQ(Tracker::stats(Tracker::CategoryPoller).deallocations, 1u);
+		EXPECT_EQ(Tracker::stats(Tracker::CategoryProtocol).allocations, 0u);
+		EXPECT_EQ(Tracker::inUse(), inUse + sizeof(int) * 10);
+		EXPECT_EQ(Tracker::peak(), inUse + sizeof(int) * 16);
+	}
+
+	EXPECT_EQ(Tracker::total().allocations, 3u);
+	EXPECT_EQ(Tracker::total().deallocations, 3u);
+	EXPECT_EQ(Tracker::inUse(), inUse);
+}
+
+static size_t trapped;
+
+static void trap(Tracker::Category category, size_t size)
+{
+	EXPECT_EQ(category, Tracker::CategoryProtocol);
+	EXPECT_EQ(size, sizeof(int));
+	trapped++;
+}
+
+TEST(AllocationTracker, RealTime)
+{
+	Tracker::reset();
+	Tracker::setTrap(&trap);
+	trapped = 0;
+
+	{
+		TrackedVector v(1);
+		EXPECT_FALSE(Tracker::realTime());
+
+		Tracker::RealTime rt;
+		EXPECT_TRUE(Tracker::realTime());
+
+		Tracker::Scope scope(Tracker::CategoryProtocol);
+		TrackedVector w(1);
+	}
+
+	EXPECT_FALSE(Tracker::realTime());
+	EXPECT_EQ(trapped, 1u);
+	EXPECT_EQ(Tracker::stats(Tracker::CategoryProtocol).realTime, 1u);
+	EXPECT_EQ(Tracker::total().realTime, 1u);
+
+	Tracker::setTrap();
+}
+
+TEST(AllocationTracker, Components)
+{
+	// The test configuration sets TrackingAllocator as Config::Allocator, so
+	// the allocations of the library itself are counted.
+	Tracker::reset();
+	size_t inUse = Tracker::inUse();
+
+	{
+		stored::Debugger d;
+		stored::ProtocolLayer response;
+		char macro[] = "m1;?";
+		d.process(macro, sizeof(macro) - 1, response);
+		EXPECT_GT(Tracker::stats(Tracker::CategoryDebugger).allocations, 0u);
+		EXPECT_EQ(Tracker::stats(Tracker::CategoryProtocol).allocations, 0u);
+
+		stored::TerminalLayer l;
+		char buf[] = "\x1b_partial frame";
+		l.decode(buf, sizeof(buf) - 1);
+		EXPECT_GT(Tracker::stats(Tracker::CategoryProtocol).allocations, 0u);
+		EXPECT_EQ(Tracker::stats(Tracker::CategorySynchronizer).allocations, 0u);
+		EXPECT_EQ(Tracker::stats(Tracker::CategoryPoller).allocations, 0u);
+	}
+
+	EXPECT_EQ(Tracker::total().allocations, Tracker::total().deallocations);
+	EXPECT_EQ(Tracker::inUse(), inUse);
+}
+
+TEST(AllocationTracker, Report)
+{
+	stored::ScratchPad<> spm;
+	char* p = spm.alloc<char>(100);
+	EXPECT_NE(p, nullptr);
+	EXPECT_TRUE(Tracker::watch("test", spm));
+
+	FILE* f = tmpfile();
+	ASSERT_NE(f, nullptr);
+	Tracker::report(f);
+	Tracker::unwatch(&spm);
+
+	rewind(f);
+	char buf[1024] = {};
+	size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[len] = 0;
+
+	EXPECT_NE(strstr(buf, "debugger"), nullptr);
+	EXPECT_NE(strstr(buf, "scratchpad test"), nullptr);
+	EXPECT_NE(strstr(buf, "max 100 bytes"), nullptr);
+}
@@ -276,6 +276,38 @@ TEST(Debugger, Macro)
 	EXPECT_EQ(ll.encoded().at(12), "0?0");
 }
 
+TEST(Debugger, ScratchPadPool)
+{
+	stored::ScratchPadPool<> pool;
+	stored::Debugger d1;
+	stored::Debugger d2;
+	stored::TestStore store;
+	d1.map(store);
+	d2.map(store);
+	d1.setScratchPadPool(&pool);
+	d2.setScratchPadPool(&pool);
+	LoggingLayer ll1;
+	ll1.wrap(d1);
+	LoggingLayer ll2;
+	ll2.wrap(d2);
+
+	DECODE(d1, "m1|r/default uint8|e;|r/default uint16");
+	EXPECT_EQ(ll1.encoded().at(0), "!");
+	DECODE(d1, "1");
+	EXPECT_EQ(ll1.encoded().at(1), "0;0");
+
+	store.default_uint16 = 0x1234;
+	DECODE(d2, "r/default uint16");
+	EXPECT_EQ(ll2.encoded().at(0), "1234");
+
+	// All requests are handled sequentially, so one arena is sufficient.
+	EXPECT_EQ(pool.arenas(), 1);
+
+	d1.setScratchPadPool();
+	DECODE(d1, "1");
+	EXPECT_EQ(ll1.encoded().at(2), "0;1234");
+}
+
 TEST(Debugger, ReadMem)
 {
 	stored::Debugger d;
@@ -369,6 +401,49 @@ TEST(Debugger, Stream)
 	EXPECT_EQ(ll.encoded().at(6), "?");
 }
 
+TEST(Debugger, Prime)
+{
+	stored::Debugger d;
+	stored::TestStore store;
+	d.map(store);
+	LoggingLayer ll;
+	ll.wrap(d);
+
+	char const dict[] = "/default uint8";
+	d.setStreamDictionary(dict, sizeof(dict) - 1u);
+
+	DECODE(d, "z1");
+	if(!stored::Config::CompressStreams) {
+		EXPECT_EQ(ll.encoded().at(0), "?");
+		return;
+	}
+
+	EXPECT_EQ(ll.encoded().at(0), "!/default uint8");
+
+	DECODE(d, "z?");
+	EXPECT_EQ(ll.encoded().at(1), "?");
+
+#ifdef STORED_HAVE_HEATSHRINK
+	LoggingLayer decompressed;
+	stored::CompressLayer decompress;
+	decompress.wrap(decompressed);
+	decompress.setDictionary(dict, sizeof(dict) - 1u);
+	decompress.setHistory();
+
+	for(size_t i = 0; i < 3; i++) {
+		d.stream('1', "/default uint8=1");
+		d.stream('1')->flush();
+		DECODE(d, "s1");
+
+		std::string const& s = ll.encoded().at(2 + i);
+		EXPECT_LT(s.size(), 16u);
+		std::vector<char> buf(s.begin(), s.end());
+		decompress.decode(&buf[0], buf.size());
+		EXPECT_EQ(decompressed.decoded().at(i), "/default uint8=1");
+	}
+#endif
+}
+
 TEST(Debugger, Trace)
 {
 	stored::Debugger d;
@@ -423,6 +498,137 @@ TEST(Debugger, Trace)
 	EXPECT_EQ(ll.encoded().at(11), "");
 }
 
+TEST(Debugger, TraceCodec)
+{
+	stored::Debugger d;
+	stored::TestStore store;
+	d.map(store);
+	LoggingLayer ll;
+	ll.wrap(d);
+
+	DECODE(d, "?");
+	EXPECT_NE(ll.encoded().at(0).find('c'), std::string::npos);
+
+	DECODE(d, "mt|e\n|r/default int16|e;|r/default float|e;");
+	DECODE(d, "ttT");
+	DECODE(d, "c_i_fx");
+	EXPECT_EQ(ll.encoded().at(3), "?");
+	// The last field is not a number; it is escaped to raw.
+	DECODE(d, "c_i_fi");
+	EXPECT_EQ(ll.encoded().at(4), "!");
+
+	d.trace();
+	DECODE(d, "fT");
+	DECODE(d, "sT");
+	EXPECT_EQ(decompress(ll.encoded().at(6)), std::string("K\x01\x40\x00\x01;", 6));
+
+	store.default_int16 = 3;
+	store.default_float = 1.0F;
+	d.trace();
+	DECODE(d, "fT");
+	DECODE(d, "sT");
+	EXPECT_EQ(decompress(ll.encoded().at(8)), std::string("D\x07\x17\x7f\x00\x01;", 7));
+
+	store.default_int16 = 6;
+	d.trace();
+	DECODE(d, "fT");
+	DECODE(d, "sT");
+	EXPECT_EQ(decompress(ll.encoded().at(10)), std::string("D\x01\x40\x00\x01;", 6));
+
+	// Periodically, the state is reset by a key sample.
+	for(unsigned int i = 3; i < stored::Debugger::TraceKeyInterval; i++)
+		d.trace();
+	DECODE(d, "fT");
+	DECODE(d, "sT");
+
+	d.trace();
+	DECODE(d, "fT");
+	DECODE(d, "sT");
+	EXPECT_EQ(decompress(ll.encoded().at(14)), std::string("K\x0d\x17\x7f\x00\x01;", 7));
+
+	// Without layout, the plain macro output is traced.
+	DECODE(d, "c");
+	EXPECT_EQ(ll.encoded().at(15), "!");
+	d.trace();
+	DECODE(d, "fT");
+	DECODE(d, "sT");
+	EXPECT_EQ(decompress(ll.encoded().at(17)), "\n6;3f800000;");
+}
+
+TEST(Debugger, Publish)
+{
+	stored::Debugger d;
+	LoggingLayer ll;
+	ll.wrap(d);
+	LoggingLayer pub;
+
+	DECODE(d, "?");
+	EXPECT_EQ(ll.encoded().at(0).find('p'), std::string::npos);
+	DECODE(d, "pTa");
+	EXPECT_EQ(ll.encoded().at(1), "?");
+
+	d.setPublisher(&pub);
+	DECODE(d, "?");
+	EXPECT_NE(ll.encoded().at(2).find('p'), std::string::npos);
+
+	DECODE(d, "pT");
+	EXPECT_EQ(ll.encoded().at(3), "?");
+
+	DECODE(d, "mt|ex;");
+	DECODE(d, "ttT");
+	DECODE(d, "pTa");
+	EXPECT_EQ(ll.encoded().at(6), "!");
+
+	d.trace();
+	d.trace();
+
+	// Changing the tag flushes the stream, and marks the end of the old tag.
+	DECODE(d, "pTb");
+	EXPECT_EQ(ll.encoded().at(7), "!");
+	ASSERT_GE(pub.encoded().size(), 2);
+	EXPECT_EQ(pub.encoded().back().size(), 6);
+
+	// All data is pushed, prefixed by the stream name, tag and sequence number.
+	std::string data;
+	for(size_t i = 0; i < pub.encoded().size(); i++) {
+		char header[8] = {};
+		snprintf(header, sizeof(header), "Ta%04x", (unsigned)i);
+		EXPECT_EQ(pub.encoded()[i].substr(0, 6), header);
+		data += pub.encoded()[i].substr(6);
+	}
+	EXPECT_EQ(decompress(data), "x;x;");
+
+	// Nothing is left to poll.
+	DECODE(d, "sT");
+	EXPECT_EQ(ll.encoded().at(8), "");
+
+	// Other streams are not pushed.
+	pub.clear();
+	d.stream('z', "oh gosh");
+	DECODE(d, "fz");
+	EXPECT_TRUE(pub.encoded().empty());
+	DECODE(d, "sz");
+	EXPECT_EQ(decompress(ll.encoded().at(10)), "oh gosh");
+
+	// Disable.
+	DECODE(d, "p");
+	EXPECT_EQ(ll.encoded().at(11), "!");
+	ASSERT_FALSE(pub.encoded().empty());
+	// The sequence starts over for a new tag.
+	EXPECT_EQ(pub.encoded().back(), "Tb0000");
+
+	pub.clear();
+	d.trace();
+	DECODE(d, "fT");
+	EXPECT_TRUE(pub.encoded().empty());
+	DECODE(d, "sT");
+	EXPECT_EQ(decompress(ll.encoded().at(13)), "x;");
+
+	// A stream can only have one tag.
+	DECODE(d, "pTaTb");
+	EXPECT_EQ(ll.encoded().at(14), "?");
+}
+
 
 } // namespace
 
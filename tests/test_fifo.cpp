@@ -6,7 +6,10 @@
 
 #include "gtest/gtest.h"
 
+#include <cstring>
+#include <iterator>
 #include <thread>
+#include <vector>
 
 namespace {
 
@@ -122,6 +125,117 @@ TEST(Fifo, IterateFifo)
 	EXPECT_TRUE(f.empty());
 }
 
+TEST(Fifo, ReserveFifo)
+{
+	stored::Fifo<int, 4> f;
+
+	size_t count = 3;
+	int* p = f.reserve(count);
+	ASSERT_NE(p, nullptr);
+	EXPECT_EQ(count, 3u);
+	p[0] = 1;
+	p[1] = 2;
+	EXPECT_TRUE(f.empty());
+	f.commit(2);
+	EXPECT_EQ(f.available(), 2u);
+	EXPECT_EQ(f.front(), 1);
+	f.pop_front();
+	f.pop_front();
+
+	// Only the end of the buffer is contiguous.
+	count = 4;
+	p = f.reserve(count);
+	ASSERT_NE(p, nullptr);
+	EXPECT_EQ(count, 3u);
+	f.abort();
+	EXPECT_TRUE(f.empty());
+
+	f.push_back({3, 4, 5});
+	count = 4;
+	p = f.reserve(count);
+	ASSERT_NE(p, nullptr);
+	EXPECT_EQ(count, 1u);
+	p[0] = 6;
+	f.commit(1);
+	EXPECT_TRUE(f.full());
+
+	count = 1;
+	EXPECT_EQ(f.reserve(count), nullptr);
+	EXPECT_EQ(count, 0u);
+	f.abort();
+
+	int i = 3;
+	for(auto x : f)
+		EXPECT_EQ(x, i++);
+
+	stored::Fifo<int> u;
+	count = 100;
+	p = u.reserve(count);
+	ASSERT_NE(p, nullptr);
+	EXPECT_EQ(count, 100u);
+	for(int j = 0; j < 100; j++)
+		p[j] = j;
+	u.commit(100);
+	EXPECT_EQ(u.available(), 100u);
+	EXPECT_EQ(u.peek(99), 99);
+}
+
+TEST(Fifo, BatchFifo)
+{
+	stored::Fifo<int, 8> f;
+	int const in[] = {1, 2, 3, 4, 5, 6, 7};
+	int out[8] = {};
+
+	auto s = f.spans();
+	EXPECT_EQ(s.first.size + s.second.size, 0u);
+	EXPECT_EQ(f.pop_front(out, 8), 0u);
+
+	f.push_back(in, 6);
+	s = f.spans();
+	ASSERT_EQ(s.first.size, 6u);
+	EXPECT_EQ(s.second.size, 0u);
+	EXPECT_EQ(s.first.data[5], 6);
+
+	EXPECT_EQ(f.pop_front(out, 4), 4u);
+	EXPECT_EQ(out[0], 1);
+	EXPECT_EQ(out[3], 4);
+	EXPECT_EQ(f.available(), 2u);
+
+	// Wrap around.
+	f.push_back(in, 5);
+	EXPECT_EQ(f.available(), 7u);
+	s = f.spans();
+	EXPECT_EQ(s.first.size, 5u);
+	ASSERT_EQ(s.second.size, 2u);
+	EXPECT_EQ(s.first.data[0], 5);
+	EXPECT_EQ(s.second.data[1], 5);
+
+	std::vector<int> v;
+	EXPECT_EQ(f.pop_front(std::back_inserter(v), 100), 7u);
+	EXPECT_EQ(v, (std::vector<int>{5, 6, 1, 2, 3, 4, 5}));
+	EXPECT_TRUE(f.empty());
+}
+
+TEST(Fifo, BatchUnboundedFifo)
+{
+	stored::Fifo<int> f;
+	std::vector<int> in;
+	for(int i = 0; i < 100; i++)
+		in.push_back(i);
+
+	f.push_back(in.data(), in.size());
+
+	std::vector<int> out(100);
+	EXPECT_EQ(f.pop_front(out.begin(), 70), 70u);
+
+	// Triggers moving the remaining data to the start of the buffer.
+	f.push_back(in.data(), 10);
+	EXPECT_EQ(f.pop_front(out.begin() + 70, 30), 30u);
+	EXPECT_EQ(out, in);
+	EXPECT_EQ(f.available(), 10u);
+	EXPECT_EQ(f.front(), 0);
+}
+
 #define EXPECT_EQ_MSG(msg, str)                       \
 	do {                                          \
 		auto m_ = (msg);                      \
@@ -229,6 +343,45 @@ TEST(Fifo, BoundedMessageFifo)
 	EXPECT_EQ(f.space(), 0u);
 }
 
+TEST(Fifo, ReserveMessageFifo)
+{
+	stored::MessageFifo<16, 4> f;
+
+	auto m = f.reserve(4);
+	ASSERT_NE(m.data(), nullptr);
+	EXPECT_EQ(m.size(), 4u);
+	memcpy(m.data(), "abcd", 4);
+	EXPECT_TRUE(f.commit(3));
+	EXPECT_EQ_MSG(f.front(), "abc");
+
+	// Combine with partial data.
+	EXPECT_TRUE(f.append_back("ef", 2));
+	m = f.reserve(2);
+	ASSERT_NE(m.data(), nullptr);
+	memcpy(m.data(), "gh", 2);
+	EXPECT_TRUE(f.commit(2, false));
+	EXPECT_EQ(f.available(), 1u);
+	m = f.reserve(1);
+	ASSERT_NE(m.data(), nullptr);
+	m.data()[0] = 'i';
+	EXPECT_TRUE(f.commit(1));
+	EXPECT_EQ(f.available(), 2u);
+
+	f.pop_front();
+	EXPECT_EQ_MSG(f.front(), "efghi");
+
+	// Does not fit.
+	EXPECT_EQ(f.reserve(12).data(), nullptr);
+
+	m = f.reserve(5);
+	ASSERT_NE(m.data(), nullptr);
+	f.abort();
+	EXPECT_EQ(f.available(), 1u);
+
+	f.pop_front();
+	EXPECT_TRUE(f.empty());
+}
+
 TEST(Fifo, IterateMessageFifo)
 {
 	stored::MessageFifo<16, 4> f;
@@ -280,6 +433,47 @@ TEST(Fifo, ProducerConsumer)
 
 	EXPECT_EQ(pcs, ccs);
 }
+
+#	ifdef STORED_OS_POSIX
+TEST(Fifo, WaitingProducerConsumer)
+{
+	stored::Fifo<int, 4> f;
+	stored::FifoEvent data;
+	stored::FifoEvent space;
+	ASSERT_EQ(data.open(), 0);
+	ASSERT_EQ(space.open(), 0);
+
+	// Nothing to wait for.
+	EXPECT_EQ(data.wait([&]() { return !f.empty(); }, 0), EAGAIN);
+	EXPECT_EQ(space.wait([&]() { return !f.full(); }, 0), 0);
+
+	long pcs = 0;
+	std::thread p([&]() {
+		for(int i = 0; i < 1000; i++) {
+			ASSERT_EQ(space.wait([&]() { return !f.full(); }), 0);
+			f.push_back(i);
+			pcs += i;
+			data.notify();
+		}
+	});
+
+	long ccs = 0;
+	std::thread c([&]() {
+		for(int i = 0; i < 1000; i++) {
+			ASSERT_EQ(data.wait([&]() { return !f.empty(); }), 0);
+			ccs += f.front();
+			f.pop_front();
+			space.notify();
+		}
+	});
+
+	c.join();
+	p.join();
+
+	EXPECT_EQ(pcs, ccs);
+	EXPECT_EQ(data.wait([&]() { return !f.empty(); }, 1000), EAGAIN);
+}
+#	endif // STORED_OS_POSIX
 #endif // STORED_COMPILER_MINGW
 
 } // namespace
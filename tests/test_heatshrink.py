@@ -16,8 +16,11 @@ class HeatshrinkDecoderTest(unittest.TestCase):
     logger = logging.getLogger(__name__)
     _decoder = None
 
-    def encode(self, x):
-        p = subprocess.run(self.encoder, input=x, capture_output=True, text=False, check=True)
+    def encode(self, x, dictionary=None):
+        cmd = [self.encoder]
+        if dictionary is not None:
+            cmd.append(dictionary)
+        p = subprocess.run(cmd, input=x, capture_output=True, text=False, check=True)
 #        self.logger.debug('\n' + p.stderr.decode())
         return p.stdout
 
@@ -46,6 +49,40 @@ class HeatshrinkDecoderTest(unittest.TestCase):
             # Random pattern with this length
             self.do_endec(bytearray(os.urandom(l)))
 
+    def test_dictionary(self):
+        dictionary = '/some/object/names/that/are/used/often'
+        decoder = libstored.heatshrink.HeatshrinkDecoder(dictionary=dictionary.encode())
+
+        for x in [b'', b'/some/object', b'/are/used/often/names', b'not in dictionary']:
+            c = self.encode(x, dictionary)
+            self.assertEqual(decoder.finish(c), x)
+
+        # Short messages that are in the dictionary compress well.
+        x = b'/some/object/names'
+        self.assertLess(len(self.encode(x, dictionary)), len(self.encode(x)))
+
+    @staticmethod
+    def bits(*fields):
+        # Pack (value, bit count) fields, MSb first, and pad with zeros.
+        s = ''.join(format(v, f'0{n}b') for v, n in fields)
+        s += '0' * (-len(s) % 8)
+        return bytes(int(s[i:i + 8], 2) for i in range(0, len(s), 8))
+
+    def test_history(self):
+        decoder = libstored.heatshrink.HeatshrinkDecoder(dictionary=b'hello world', history=True)
+
+        # Back-reference (tag bit 0) to offset 11, length 5.
+        self.assertEqual(decoder.finish(self.bits((0, 1), (10, 8), (4, 4))), b'hello')
+        # The previous message follows the dictionary: offset 10, length 10.
+        self.assertEqual(decoder.finish(self.bits((0, 1), (9, 8), (9, 4))), b'worldhello')
+        # Literal (tag bit 1), followed by a back-reference to offset 20, length 3.
+        self.assertEqual(decoder.finish(self.bits((1, 1), (0x21, 8), (0, 1), (20, 8), (2, 4))), b'!wor')
+
+        # Without history, only the dictionary is used.
+        decoder = libstored.heatshrink.HeatshrinkDecoder(dictionary=b'hello world')
+        self.assertEqual(decoder.finish(self.bits((0, 1), (10, 8), (4, 4))), b'hello')
+        self.assertEqual(decoder.finish(self.bits((0, 1), (4, 8), (4, 4))), b'world')
+
 if __name__ == '__main__':
     HeatshrinkDecoderTest.encoder = sys.argv[-1]
     del sys.argv[-1]
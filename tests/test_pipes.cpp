@@ -3,8 +3,10 @@
 // SPDX-License-Identifier: MPL-2.0
 
 #include "libstored/pipes.h"
+#include "libstored/poller.h"
 #include "TestStore.h"
 
+#include <array>
 #include <thread>
 
 #include "gtest/gtest.h"
@@ -590,6 +592,258 @@ TEST(Pipes, Convert)
 	EXPECT_EQ(p.entry_cast(4e-3), 4.0);
 }
 
+TEST(Pipes, Batch)
+{
+	using namespace stored::pipes;
+
+	auto p = Entry<double>{} >> Convert{Scale<double, std::milli>{}}
+		 >> Constrained{Bounded{-1.0, 1.0}} >> Buffer<double>{} >> Cap{};
+
+	std::array<double, 200> in{};
+	std::array<double, 200> out{};
+	for(size_t i = 0; i < in.size(); i++)
+		in[i] = (double)i * 20.0 - 2000.0;
+
+	p.inject(in.data(), out.data(), in.size());
+	EXPECT_EQ(p.extract().get(), 1.0);
+
+	for(size_t i = 0; i < in.size(); i++) {
+		EXPECT_EQ(out[i], p.inject(in[i]).get());
+	}
+
+	EXPECT_EQ(out[0], -1.0);
+	EXPECT_EQ(out[100], 0.0);
+	EXPECT_DOUBLE_EQ(out[125], 0.5);
+	EXPECT_EQ(out[199], 1.0);
+
+	// In-place.
+	p.inject(in.data(), in.data(), in.size());
+	EXPECT_EQ(in, out);
+}
+
+TEST(Pipes, BatchCast)
+{
+	using namespace stored::pipes;
+
+	// The type changes within the pipe, which is processed in chunks.
+	auto p = Entry<double>{} >> Cast<double, int8_t>{} >> Cast<int8_t, double>{} >> Cap{};
+
+	std::array<double, 200> in{};
+	std::array<double, 200> out{};
+	for(size_t i = 0; i < in.size(); i++)
+		in[i] = (double)i * 1.5 - 150.0;
+
+	p.inject(in.data(), out.data(), in.size());
+
+	for(size_t i = 0; i < in.size(); i++) {
+		EXPECT_EQ(out[i], p.inject(in[i]).get());
+	}
+
+	EXPECT_EQ(out[0], -128.0);
+	EXPECT_EQ(out[100], 0.0);
+	EXPECT_EQ(out[199], 127.0);
+}
+
+TEST(Pipes, BatchFallback)
+{
+	using namespace stored::pipes;
+
+	int cnt = 0;
+	int sum = 0;
+	auto p0 = Entry<int>{} >> Call{[&](int x) {
+			  cnt++;
+			  sum += x;
+		  }} >> Exit{};
+	auto p1 = Entry<int>{} >> Buffer<int>{} >> Cap{};
+	p0 >> p1;
+
+	std::array<int, 100> in{};
+	std::array<int, 100> out{};
+	for(size_t i = 0; i < in.size(); i++)
+		in[i] = (int)i;
+
+	// Call does not support batches, so every value is passed separately.
+	p0.inject(in.data(), out.data(), in.size());
+	EXPECT_EQ(cnt, 100);
+	EXPECT_EQ(sum, 4950);
+	EXPECT_EQ(out, in);
+
+	// The batch is forwarded to the connected pipe.
+	EXPECT_EQ(p1.extract(), 99);
+
+	// A batch without output.
+	PipeEntry<int>& e = p0;
+	e.inject(in.data(), 50);
+	EXPECT_EQ(cnt, 150);
+	EXPECT_EQ(p1.extract(), 49);
+}
+
+TEST(Pipes, Async)
+{
+	using namespace stored::pipes;
+
+	int cnt = 0;
+	int sum = 0;
+	auto consumer = Entry<int>{} >> Call{[&](int x) {
+				cnt++;
+				sum += x;
+			}} >> Cap{};
+
+	AsyncQueue<int, 4> q{consumer};
+	auto p = Entry<int>{} >> Async{q} >> Buffer<int>{} >> Cap{};
+
+	for(int i = 1; i <= 6; i++)
+		i >> p;
+
+	// The producer side is processed immediately.
+	EXPECT_EQ(p.extract().get(), 6);
+
+	// The consumer side only when received. Two values did not fit.
+	EXPECT_EQ(cnt, 0);
+	EXPECT_EQ(q.available(), 4U);
+	EXPECT_EQ(q.dropped(), 2U);
+
+	EXPECT_EQ(q.recv(), 0);
+	EXPECT_EQ(cnt, 4);
+	EXPECT_EQ(sum, 1 + 2 + 3 + 4);
+	EXPECT_EQ(q.recv(), EAGAIN);
+
+	// Batches are queued too.
+	std::array<int, 6> in{{10, 20, 30, 40, 50, 60}};
+	std::array<int, 6> out{};
+	p.inject(in.data(), out.data(), in.size());
+	EXPECT_EQ(out, in);
+	EXPECT_EQ(q.dropped(), 4U);
+
+	EXPECT_EQ(q.recvAll(), 4U);
+	EXPECT_EQ(cnt, 8);
+	EXPECT_EQ(sum, 10 + 100);
+}
+
+#if defined(STORED_OS_POSIX) && !defined(STORED_COMPILER_MINGW)
+TEST(Pipes, AsyncThread)
+{
+	using namespace stored::pipes;
+
+	long sum = 0;
+	auto consumer = Entry<int>{} >> Call{[&](int x) { sum += x; }} >> Cap{};
+
+	AsyncQueue<int, 16> q{consumer, AsyncQueue<int, 16>::OverflowBlock};
+	ASSERT_EQ(q.enableWait(), 0);
+	auto p = Entry<int>{} >> Async{q} >> Cap{};
+
+	std::thread c([&]() {
+		while(sum < 1000L * 999L / 2L)
+			ASSERT_EQ(q.recv(-1), 0);
+	});
+
+	for(int i = 0; i < 1000; i++)
+		i >> p;
+
+	c.join();
+
+	EXPECT_EQ(sum, 1000L * 999L / 2L);
+	EXPECT_EQ(q.dropped(), 0U);
+}
+
+TEST(Pipes, AsyncPoller)
+{
+	using namespace stored::pipes;
+
+	int sum = 0;
+	auto consumer = Entry<int>{} >> Call{[&](int x) { sum += x; }} >> Cap{};
+
+	AsyncQueue<int, 16> q{consumer};
+	ASSERT_EQ(q.enableWait(), 0);
+	auto p = Entry<int>{} >> Async{q} >> Cap{};
+
+	stored::Poller poller;
+	stored::PollableFd pfd{q.fd(), stored::Pollable::PollIn};
+	ASSERT_EQ(poller.add(pfd), 0);
+
+	auto f = [&](stored::Pollable& /*pollable*/) { q.recvAll(); };
+
+	EXPECT_EQ(poller.runOnce(f, 0), EAGAIN);
+
+	1 >> p;
+	2 >> p;
+	EXPECT_EQ(poller.runOnce(f, 0), 0);
+	EXPECT_EQ(sum, 3);
+
+	EXPECT_EQ(poller.runOnce(f, 0), EAGAIN);
+
+	3 >> p;
+	EXPECT_EQ(poller.runOnce(f, 0), 0);
+	EXPECT_EQ(sum, 6);
+}
+#endif // STORED_OS_POSIX && !STORED_COMPILER_MINGW
+
+TEST(Pipes, Fused)
+{
+	using namespace stored::pipes;
+
+	auto f0 = Entry<int>{} >> Identity<int>{} >> Identity<int>{} >> Fused{};
+	static_assert(!std::is_polymorphic<decltype(f0)>::value, "");
+	static_assert(std::is_empty<decltype(f0)>::value, "");
+	EXPECT_LT(sizeof(f0), sizeof(Entry<int>{} >> Identity<int>{} >> Cap{}));
+	EXPECT_EQ(f0.inject(1), 1);
+
+	auto f = Entry<double>{} >> Convert{Scale<double, std::milli>{}} >> Buffer<double>{}
+		 >> Fused{};
+	static_assert(!std::is_polymorphic<decltype(f)>::value, "");
+
+	EXPECT_EQ(f.inject(1), 1e-3);
+	EXPECT_EQ(f.extract(), 1e-3);
+	EXPECT_EQ(2 >> f, 2e-3);
+	EXPECT_EQ(f(3), 3e-3);
+	EXPECT_EQ(f.entry_cast(4e-3), 4.0);
+	EXPECT_EQ(f.exit_cast(5), 5e-3);
+
+	double x = 0;
+	f >> x;
+	EXPECT_EQ(x, 3e-3);
+
+	std::array<double, 3> in{{1, 2, 3}};
+	std::array<double, 3> out{};
+	f.inject(in.data(), out.data(), in.size());
+	EXPECT_EQ(out[2], 3e-3);
+	EXPECT_EQ(f.extract(), 3e-3);
+
+	// Fused pipes are copyable.
+	auto f2 = f;
+	4 >> f;
+	EXPECT_EQ(f2.extract(), 3e-3);
+	EXPECT_EQ(f.extract(), 4e-3);
+}
+
+TEST(Pipes, FusedVirtual)
+{
+	using namespace stored::pipes;
+
+	auto f = Entry<int>{} >> Buffer<int>{} >> Fused{};
+	VirtualPipe<decltype(f)> v{f};
+	Pipe<int, int>& vp = v;
+
+	1 >> vp;
+	EXPECT_EQ(f.extract(), 1);
+	EXPECT_EQ(vp.extract(), 1);
+
+	// Connect it to an open pipe.
+	auto p = Entry<int>{} >> Exit{};
+	p >> v;
+	2 >> p;
+	EXPECT_EQ(f.extract(), 2);
+
+	std::array<int, 3> in{{3, 4, 5}};
+	std::array<int, 3> out{};
+	p.inject(in.data(), out.data(), in.size());
+	EXPECT_EQ(f.extract(), 5);
+
+	// The fused pipe is still called directly.
+	6 >> f;
+	EXPECT_EQ(vp.extract(), 6);
+}
+
 TEST(Pipes, IndexMap)
 
 {
@@ -10,8 +10,13 @@
 
 #include "LoggingLayer.h"
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <poll.h>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 
 #ifdef STORED_HAVE_ZMQ
 #	include <zmq.h>
@@ -153,6 +158,487 @@ TEST(Poller, PollableCallback)
 	EXPECT_EQ(res.size(), 1U);
 }
 
+TEST(Poller, PollableTimer)
+{
+	stored::PollableTimer t;
+	EXPECT_FALSE(t.running());
+	EXPECT_EQ(t.expirations(), 0U);
+	EXPECT_EQ(t.start(0), EINVAL);
+
+	// One-shot
+	auto start = std::chrono::steady_clock::now();
+	ASSERT_EQ(t.start(10000, false), 0);
+	EXPECT_TRUE(t.running());
+	EXPECT_FALSE(t.expired());
+	EXPECT_EQ(t.expirations(), 0U);
+
+	stored::CustomPoller<stored::LoopPoller> loopPoller = {t};
+	EXPECT_EQ(loopPoller.poll(-1).size(), 1U);
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(10));
+	EXPECT_TRUE(t.expired());
+	EXPECT_EQ(t.expirations(), 1U);
+	EXPECT_FALSE(t.running());
+	EXPECT_TRUE(loopPoller.poll(0).empty());
+	loopPoller.clear();
+
+	// Periodic, with coalesced expirations
+	ASSERT_EQ(t.start(10000), 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(35));
+	EXPECT_GE(t.expirations(), 3U);
+	EXPECT_TRUE(t.running());
+	EXPECT_EQ(t.expirations(), 0U);
+
+	t.stop();
+	EXPECT_FALSE(t.running());
+}
+
+#ifdef STORED_OS_LINUX
+TEST(Poller, PollableTimerFd)
+{
+	stored::PollableTimer t;
+	ASSERT_GE(t.fd(), 0);
+
+	stored::Poller poller = {t};
+	EXPECT_TRUE(poller.poll(0).empty());
+
+	// Aligned, periodic
+	ASSERT_EQ(t.start(5000, true, true), 0);
+
+	for(int i = 0; i < 3; i++) {
+		auto const* res = &poller.poll(-1);
+		ASSERT_EQ(res->size(), 1U);
+		EXPECT_GE(t.expirations(), 1U);
+	}
+
+	// Acknowledged, so not ready anymore.
+	EXPECT_TRUE(poller.poll(0).empty());
+
+	t.stop();
+	EXPECT_TRUE(poller.poll(10).empty());
+}
+#endif // STORED_OS_LINUX
+
+#ifndef STORED_HAVE_ZTH
+TEST(Poller, RunOnce)
+{
+	int fd[2];
+	ASSERT_EQ(pipe(fd), 0);
+
+	stored::PollableFd pin(fd[0], stored::Pollable::PollIn, (void*)1);
+	stored::PollableFd pout(fd[1], stored::Pollable::PollOut, (void*)2);
+	stored::Poller poller = {pin};
+
+	std::vector<void*> dispatched;
+	auto f = [&](stored::Pollable& p) {
+		dispatched.push_back(p.user_data);
+		// Not allowed while dispatching.
+		EXPECT_EQ(poller.remove(p), EBUSY);
+	};
+
+	EXPECT_EQ(poller.runOnce(f, 0), EAGAIN);
+	EXPECT_TRUE(dispatched.empty());
+
+	EXPECT_EQ(write(fd[1], "1", 1), 1);
+	EXPECT_EQ(poller.runOnce(f, 0), 0);
+	ASSERT_EQ(dispatched.size(), 1U);
+	EXPECT_EQ(dispatched[0], (void*)1);
+	EXPECT_EQ(pin.revents, stored::Pollable::PollIn + 0);
+
+	EXPECT_EQ(poller.add(pout), 0);
+	dispatched.clear();
+	EXPECT_EQ(poller.runOnce(f, 0), 0);
+	EXPECT_EQ(dispatched.size(), 2U);
+
+	// poll() still works afterwards.
+	auto const* res = &poller.poll(0);
+	EXPECT_EQ(res->size(), 2U);
+
+	poller.clear();
+	close(fd[0]);
+	close(fd[1]);
+}
+
+TEST(Poller, Run)
+{
+	int fd[2];
+	ASSERT_EQ(pipe(fd), 0);
+
+	stored::PollableFd pin(fd[0], stored::Pollable::PollIn);
+	stored::Poller poller = {pin};
+
+	std::thread t([&]() {
+		for(int i = 0; i < 3; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			EXPECT_EQ(write(fd[1], "1", 1), 1);
+		}
+	});
+
+	int count = 0;
+	EXPECT_EQ(
+		poller.run([&](stored::Pollable&) {
+			char c = 0;
+			EXPECT_EQ(read(fd[0], &c, 1), 1);
+			if(++count == 3)
+				poller.stop();
+		}),
+		0);
+	EXPECT_EQ(count, 3);
+
+	t.join();
+	poller.clear();
+	close(fd[0]);
+	close(fd[1]);
+}
+
+TEST(Poller, RunStop)
+{
+	int fd[2];
+	ASSERT_EQ(pipe(fd), 0);
+
+	stored::PollableFd pin(fd[0], stored::Pollable::PollIn);
+	stored::Poller poller = {pin};
+
+	// A stop() before run() is not lost.
+	poller.stop();
+	EXPECT_EQ(poller.run([&](stored::Pollable&) { ADD_FAILURE(); }), 0);
+
+	// A stop() from another thread wakes up run(), while nothing else happens.
+	std::thread t([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		poller.stop();
+	});
+
+	EXPECT_EQ(poller.run([&](stored::Pollable&) { ADD_FAILURE(); }), 0);
+	t.join();
+
+	// The internal wakeup is not registered anymore.
+	EXPECT_EQ(poller.remove(pin), 0);
+	EXPECT_TRUE(poller.empty());
+	close(fd[0]);
+	close(fd[1]);
+}
+
+TEST(Poller, Threaded)
+{
+	struct Conn {
+		int fd[2] = {-1, -1};
+		std::unique_ptr<stored::PollableFd> p;
+		std::thread::id thread;
+		std::atomic<bool> busy{false};
+		std::atomic<int> count{0};
+		std::atomic<bool> closeOnNext{false};
+	};
+
+	stored::ThreadedPoller<> poller(2);
+	EXPECT_EQ(poller.threads(), 2U);
+
+	std::vector<std::unique_ptr<Conn>> conns;
+	for(int i = 0; i < 8; i++) {
+		conns.emplace_back(new Conn());
+		Conn& c = *conns.back();
+		ASSERT_EQ(pipe(c.fd), 0);
+		c.p.reset(new stored::PollableFd(
+			c.fd[0], stored::Pollable::Events(stored::Pollable::PollIn), &c));
+	}
+
+	// Half of them before, half of them after starting the threads.
+	for(int i = 0; i < 4; i++)
+		EXPECT_EQ(poller.add(*conns[(size_t)i]->p), 0);
+
+	// Spread evenly.
+	EXPECT_NE(poller.thread(*conns[0]->p), poller.thread(*conns[1]->p));
+	EXPECT_EQ(poller.add(*conns[4]->p, 2), EINVAL);
+
+	std::atomic<int> total{0};
+	EXPECT_EQ(
+		poller.start([&](stored::Pollable& p) {
+			Conn& c = *static_cast<Conn*>(p.user_data);
+
+			// Never called concurrently for the same pollable.
+			EXPECT_FALSE(c.busy.exchange(true));
+
+			if(c.thread == std::thread::id()) {
+				c.thread = std::this_thread::get_id();
+			} else {
+				EXPECT_EQ(c.thread, std::this_thread::get_id());
+			}
+
+			char buf = 0;
+			EXPECT_EQ(read(c.fd[0], &buf, 1), 1);
+
+			if(c.closeOnNext) {
+				EXPECT_EQ(poller.remove(p), 0);
+			}
+
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			c.count++;
+			c.busy = false;
+			total++;
+		}),
+		0);
+	EXPECT_TRUE(poller.running());
+	EXPECT_EQ(poller.start([](stored::Pollable&) {}), EALREADY);
+
+	for(int i = 4; i < 8; i++)
+		EXPECT_EQ(poller.add(*conns[(size_t)i]->p), 0);
+
+	auto waitFor = [&](int expected) {
+		for(int i = 0; i < 5000 && total.load() < expected; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		EXPECT_EQ(total.load(), expected);
+	};
+
+	for(int round = 0; round < 10; round++) {
+		for(auto& c : conns)
+			EXPECT_EQ(write(c->fd[1], "1", 1), 1);
+		waitFor((round + 1) * 8);
+	}
+
+	for(auto& c : conns)
+		EXPECT_EQ(c->count.load(), 10);
+
+	// Remove from the callback itself.
+	conns[3]->closeOnNext = true;
+	EXPECT_EQ(write(conns[3]->fd[1], "1", 1), 1);
+	waitFor(81);
+
+	// Remove from here.
+	EXPECT_EQ(poller.remove(*conns[2]->p), 0);
+	EXPECT_EQ(poller.remove(*conns[2]->p), ESRCH);
+	EXPECT_EQ(poller.thread(*conns[2]->p), poller.threads());
+
+	for(auto& c : conns)
+		EXPECT_EQ(write(c->fd[1], "1", 1), 1);
+	waitFor(87);
+	EXPECT_EQ(conns[2]->count.load(), 10);
+	EXPECT_EQ(conns[3]->count.load(), 11);
+
+	poller.stop();
+	EXPECT_FALSE(poller.running());
+
+	for(auto& c : conns) {
+		poller.remove(*c->p);
+		close(c->fd[0]);
+		close(c->fd[1]);
+	}
+}
+#endif // !STORED_HAVE_ZTH
+
+#if defined(STORED_OS_LINUX) && !defined(STORED_HAVE_ZTH)
+TEST(Poller, Epoll)
+{
+	int fd[2];
+	ASSERT_EQ(pipe(fd), 0);
+
+	stored::PollableFd pin(fd[0], stored::Pollable::PollIn, (void*)1);
+	stored::PollableFd pout(fd[1], stored::Pollable::PollOut, (void*)2);
+
+	stored::CustomPoller<stored::EpollPoller> poller = {pin};
+
+	auto const* res = &poller.poll(0);
+	EXPECT_TRUE(res->empty());
+	EXPECT_EQ(errno, EAGAIN);
+
+	EXPECT_EQ(write(fd[1], "1", 1), 1);
+	res = &poller.poll(0);
+	ASSERT_EQ(res->size(), 1U);
+	EXPECT_EQ(res->at(0)->user_data, (void*)1);
+	EXPECT_EQ(pin.revents, stored::Pollable::PollIn + 0);
+
+	// Level-triggered, so it is returned again.
+	res = &poller.poll(0);
+	EXPECT_EQ(res->size(), 1U);
+
+	EXPECT_EQ(poller.add(pout), 0);
+	res = &poller.poll(0);
+	EXPECT_EQ(res->size(), 2U);
+
+	// A file descriptor can only be added once.
+	stored::PollableFd pin2(fd[0], stored::Pollable::PollIn);
+	EXPECT_EQ(poller.add(pin2), EEXIST);
+
+	// Removing pin moves pout to the first index.
+	EXPECT_EQ(poller.remove(pin), 0);
+	res = &poller.poll(0);
+	ASSERT_EQ(res->size(), 1U);
+	EXPECT_EQ(res->at(0)->user_data, (void*)2);
+	EXPECT_EQ(pout.revents, stored::Pollable::PollOut + 0);
+
+	poller.clear();
+	close(fd[0]);
+	close(fd[1]);
+}
+
+TEST(Poller, EpollEdgeTriggered)
+{
+	int fd[2];
+	ASSERT_EQ(pipe(fd), 0);
+
+	stored::PollableFd pin(fd[0], stored::Pollable::PollIn);
+	stored::CustomPoller<stored::EpollPoller> poller;
+	poller.setEdgeTriggered();
+	EXPECT_TRUE(poller.edgeTriggered());
+	ASSERT_EQ(poller.add(pin), 0);
+
+	EXPECT_EQ(write(fd[1], "12", 2), 2);
+	EXPECT_EQ(poller.poll(0).size(), 1U);
+
+	// Not drained, but there was no new edge.
+	EXPECT_TRUE(poller.poll(0).empty());
+
+	EXPECT_EQ(write(fd[1], "3", 1), 1);
+	EXPECT_EQ(poller.poll(0).size(), 1U);
+
+	poller.clear();
+	close(fd[0]);
+	close(fd[1]);
+}
+
+TEST(Poller, IoUring)
+{
+	int fd[2];
+	ASSERT_EQ(pipe(fd), 0);
+
+	stored::PollableFd pin(fd[0], stored::Pollable::PollIn, (void*)1);
+	stored::PollableFd pout(fd[1], stored::Pollable::PollOut, (void*)2);
+
+	stored::CustomPoller<stored::IoUringPoller> poller = {pin};
+	if(poller.fallback())
+		printf("io_uring not available; testing poll() fallback\n");
+
+	auto const* res = &poller.poll(0);
+	EXPECT_TRUE(res->empty());
+	EXPECT_EQ(errno, EAGAIN);
+
+	auto start = std::chrono::steady_clock::now();
+	res = &poller.poll(10);
+	EXPECT_TRUE(res->empty());
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(10));
+
+	EXPECT_EQ(write(fd[1], "1", 1), 1);
+	res = &poller.poll(0);
+	ASSERT_EQ(res->size(), 1U);
+	EXPECT_EQ(res->at(0)->user_data, (void*)1);
+	EXPECT_EQ(pin.revents, stored::Pollable::PollIn + 0);
+
+	// Level-triggered, so it is returned again.
+	res = &poller.poll(0);
+	EXPECT_EQ(res->size(), 1U);
+
+	EXPECT_EQ(poller.add(pout), 0);
+	res = &poller.poll(-1);
+	EXPECT_EQ(res->size(), 2U);
+
+	// Removing pin moves pout to the first index.
+	EXPECT_EQ(poller.remove(pin), 0);
+	res = &poller.poll(0);
+	ASSERT_EQ(res->size(), 1U);
+	EXPECT_EQ(res->at(0)->user_data, (void*)2);
+	EXPECT_EQ(pout.revents, stored::Pollable::PollOut + 0);
+
+	// Wake up by another thread.
+	EXPECT_EQ(poller.remove(pout), 0);
+	EXPECT_EQ(poller.add(pin), 0);
+	char buf = 0;
+	EXPECT_EQ(read(fd[0], &buf, 1), 1);
+	EXPECT_TRUE(poller.poll(0).empty());
+
+	std::thread t([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		EXPECT_EQ(write(fd[1], "2", 1), 1);
+	});
+	res = &poller.poll(-1);
+	EXPECT_EQ(res->size(), 1U);
+	t.join();
+
+	poller.clear();
+	close(fd[0]);
+	close(fd[1]);
+}
+
+TEST(Poller, IoUringMultishot)
+{
+	int fd[2];
+	ASSERT_EQ(pipe(fd), 0);
+
+	stored::PollableFd pin(fd[0], stored::Pollable::PollIn);
+	stored::CustomPoller<stored::IoUringPoller> poller;
+	poller.setMultishot();
+	EXPECT_TRUE(poller.multishot());
+	ASSERT_EQ(poller.add(pin), 0);
+
+	if(poller.fallback()) {
+		poller.clear();
+		close(fd[0]);
+		close(fd[1]);
+		GTEST_SKIP() << "io_uring not available";
+	}
+
+	EXPECT_EQ(write(fd[1], "12", 2), 2);
+	EXPECT_EQ(poller.poll(0).size(), 1U);
+
+	// Not drained, but there was no new event.
+	EXPECT_TRUE(poller.poll(0).empty());
+
+	EXPECT_EQ(write(fd[1], "3", 1), 1);
+	EXPECT_EQ(poller.poll(0).size(), 1U);
+
+	poller.clear();
+	close(fd[0]);
+	close(fd[1]);
+}
+
+template <typename PollerImpl>
+class PollerMany : public ::testing::Test {};
+
+using ManyPollers = ::testing::Types<stored::EpollPoller, stored::IoUringPoller>;
+TYPED_TEST_SUITE(PollerMany, ManyPollers, );
+
+TYPED_TEST(PollerMany, Shuffle)
+{
+	std::vector<int> fds;
+	std::vector<stored::PollableFd> pollables;
+	size_t const count = 100;
+
+	for(size_t i = 0; i < count; i++) {
+		int fd[2];
+		ASSERT_EQ(pipe(fd), 0);
+		fds.push_back(fd[0]);
+		fds.push_back(fd[1]);
+		pollables.push_back(stored::pollable(fd[0], stored::Pollable::PollIn, (void*)i));
+	}
+
+	stored::CustomPoller<TypeParam> poller;
+	for(auto& p : pollables)
+		ASSERT_EQ(poller.add(p), 0);
+
+	EXPECT_TRUE(poller.poll(0).empty());
+
+	EXPECT_EQ(write(fds[2 * 43 + 1], "x", 1), 1);
+	auto const* res = &poller.poll(0);
+	ASSERT_EQ(res->size(), 1U);
+	EXPECT_EQ(res->at(0)->user_data, (void*)43);
+
+	// Shuffle the indices a bit.
+	for(size_t i = 0; i < count; i += 3)
+		ASSERT_EQ(poller.remove(pollables[i]), 0);
+
+	res = &poller.poll(0);
+	ASSERT_EQ(res->size(), 1U);
+	EXPECT_EQ(res->at(0)->user_data, (void*)43);
+
+	// Removed ones do not report events anymore.
+	EXPECT_EQ(write(fds[2 * 42 + 1], "x", 1), 1);
+	res = &poller.poll(0);
+	ASSERT_EQ(res->size(), 1U);
+	EXPECT_EQ(res->at(0)->user_data, (void*)43);
+
+	poller.clear();
+	for(int fd : fds)
+		close(fd);
+}
+#endif // STORED_OS_LINUX && !STORED_HAVE_ZTH
+
 #if defined(STORED_HAVE_ZMQ)
 TEST(Poller, PollableZmqSocket)
 {
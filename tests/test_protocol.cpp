@@ -4,11 +4,14 @@
 
 #include "libstored/compress.h"
 #include "libstored/fifo.h"
+#include "libstored/poller.h"
 #include "libstored/protocol.h"
+#include "libstored/zmq.h"
 #include "LoggingLayer.h"
 #include "gtest/gtest.h"
 
 #include <chrono>
+#include <cstring>
 #include <fcntl.h>
 #include <thread>
 
@@ -1099,6 +1102,182 @@ TEST(CompressLayer, Compress)
 	EXPECT_EQ(top.decoded().at(0), "Hello World! Nice World!");
 }
 
+#ifdef STORED_HAVE_HEATSHRINK
+TEST(CompressLayer, Dictionary)
+{
+	char const dict[] = "/some/object/names";
+
+	LoggingLayer top;
+	stored::CompressLayer l;
+	l.wrap(top);
+	LoggingLayer bottom;
+	bottom.wrap(l);
+
+	top.encode("/object/names", 13u);
+	l.setDictionary(dict, sizeof(dict) - 1u);
+	EXPECT_TRUE(l.primed());
+	top.encode("/object/names", 13u);
+	top.encode("/object/names", 13u);
+
+	ASSERT_EQ(bottom.encoded().size(), 3u);
+	EXPECT_LT(bottom.encoded().at(1).size(), bottom.encoded().at(0).size());
+	// Every message is primed the same way.
+	EXPECT_EQ(bottom.encoded().at(1), bottom.encoded().at(2));
+
+	std::vector<char> buf(bottom.encoded().at(1).begin(), bottom.encoded().at(1).end());
+	bottom.decode(&buf[0], buf.size());
+	buf.assign(bottom.encoded().at(2).begin(), bottom.encoded().at(2).end());
+	bottom.decode(&buf[0], buf.size());
+	EXPECT_EQ(top.decoded().at(0), "/object/names");
+	EXPECT_EQ(top.decoded().at(1), "/object/names");
+}
+
+TEST(CompressLayer, History)
+{
+	LoggingLayer top;
+	stored::CompressLayer l;
+	l.wrap(top);
+	LoggingLayer bottom;
+	bottom.wrap(l);
+
+	l.setHistory();
+	EXPECT_TRUE(l.history());
+
+	for(int i = 0; i < 3; i++)
+		top.encode("Hello World!", 12u);
+
+	ASSERT_EQ(bottom.encoded().size(), 3u);
+	EXPECT_LT(bottom.encoded().at(1).size(), bottom.encoded().at(0).size());
+
+	for(size_t i = 0; i < 3; i++) {
+		std::vector<char> buf(bottom.encoded().at(i).begin(), bottom.encoded().at(i).end());
+		bottom.decode(&buf[0], buf.size());
+		EXPECT_EQ(top.decoded().at(i), "Hello World!");
+	}
+
+	// Start over.
+	l.resetHistory();
+	top.encode("Hello World!", 12u);
+	EXPECT_EQ(bottom.encoded().at(3), bottom.encoded().at(0));
+}
+
+TEST(CompressLayer, PrimedRoundTrip)
+{
+	char const dict[] = "/some/object/names/and/some/more/object/names";
+
+	LoggingLayer encTop;
+	stored::CompressLayer enc;
+	enc.wrap(encTop);
+	LoggingLayer encBottom;
+	encBottom.wrap(enc);
+
+	LoggingLayer decTop;
+	stored::CompressLayer dec;
+	dec.wrap(decTop);
+	LoggingLayer decBottom;
+	decBottom.wrap(dec);
+
+	enc.setDictionary(dict, sizeof(dict) - 1u);
+	enc.setHistory();
+	dec.setDictionary(dict, sizeof(dict) - 1u);
+	dec.setHistory();
+
+	char const* const msgs[] = {
+		"r/some/object", "r/more/object/names", "w1/some/object", "r/some/object",
+		"r/and/some/more/object/names/and/some/more"};
+	size_t const count = sizeof(msgs) / sizeof(msgs[0]);
+
+	// Every message is decoded by another layer, as the other side would do.
+	for(int pass = 0; pass < 2; pass++) {
+		for(size_t i = 0; i < count; i++) {
+			encTop.encode(msgs[i], strlen(msgs[i]));
+			std::string const& msg = encBottom.encoded().back();
+			std::vector<char> buf(msg.begin(), msg.end());
+			decBottom.decode(&buf[0], buf.size());
+			ASSERT_EQ(decTop.decoded().back(), msgs[i]);
+		}
+
+		// Start over at both sides, like after a reconnect.
+		enc.resetHistory();
+		dec.resetHistory();
+	}
+
+	ASSERT_EQ(encBottom.encoded().size(), count * 2u);
+	// The history is reset, so the same messages are encoded in the same way.
+	for(size_t i = 0; i < count; i++)
+		EXPECT_EQ(encBottom.encoded().at(i), encBottom.encoded().at(i + count));
+
+	// A repeated message is a back-reference into the history.
+	EXPECT_LT(encBottom.encoded().at(3).size(), encBottom.encoded().at(0).size());
+
+	EXPECT_TRUE(enc.idle());
+	EXPECT_TRUE(dec.idle());
+}
+
+TEST(CompressLayer, Adaptive)
+{
+	LoggingLayer top;
+	stored::CompressLayer l;
+	l.wrap(top);
+	LoggingLayer bottom;
+	bottom.wrap(l);
+
+	l.setAdaptive();
+	EXPECT_TRUE(l.adaptive());
+
+	// Compressible.
+	std::string zeros(100, '\0');
+	top.encode(zeros.data(), zeros.size());
+	ASSERT_EQ(bottom.encoded().size(), 1u);
+	EXPECT_EQ(bottom.encoded().at(0).at(0), (char)stored::CompressLayer::HeaderCompressed);
+	EXPECT_LT(bottom.encoded().at(0).size(), zeros.size());
+
+	// Incompressible; the output does not grow more than the header.
+	top.encode("abcdefgh", 8u);
+	ASSERT_EQ(bottom.encoded().size(), 2u);
+	EXPECT_EQ(bottom.encoded().at(1), std::string(1, '\0') + "abcdefgh");
+	EXPECT_EQ(l.stats().stored, 1u);
+
+	for(size_t i = 0; i < bottom.encoded().size(); i++) {
+		std::vector<char> buf(bottom.encoded().at(i).begin(), bottom.encoded().at(i).end());
+		bottom.decode(&buf[0], buf.size());
+	}
+
+	ASSERT_EQ(top.decoded().size(), 2u);
+	EXPECT_EQ(top.decoded().at(0), zeros);
+	EXPECT_EQ(top.decoded().at(1), "abcdefgh");
+
+	// Keep sending incompressible data, until compression is not tried anymore.
+	for(int i = 0; i < 100 && l.stats().skipped == 0; i++)
+		top.encode("abcdefgh", 8u);
+
+	EXPECT_GE(l.ratio(), (unsigned int)stored::CompressLayer::RatioScale);
+	EXPECT_GT(l.stats().skipped, 0u);
+	EXPECT_EQ(bottom.encoded().back(), std::string(1, '\0') + "abcdefgh");
+
+	// Compression is retried once in a while, and resumes when it helps.
+	for(int i = 0; i < 100 && l.ratio() >= (unsigned int)stored::CompressLayer::RatioScale;
+	    i++)
+		top.encode(zeros.data(), zeros.size());
+
+	EXPECT_LT(l.ratio(), (unsigned int)stored::CompressLayer::RatioScale);
+	top.encode(zeros.data(), zeros.size());
+	EXPECT_EQ(bottom.encoded().back().at(0), (char)stored::CompressLayer::HeaderCompressed);
+
+	stored::CompressLayer::Stats const& stats = l.stats();
+	EXPECT_EQ(stats.messages, bottom.encoded().size());
+	EXPECT_LT(stats.encodeOut, stats.encodeIn);
+	EXPECT_EQ(stats.decodeOut, zeros.size() + 8u);
+	// The clock is not read, unless requested.
+	EXPECT_FALSE(l.timing());
+	EXPECT_EQ(stats.encodeTime_ns, 0u);
+	EXPECT_EQ(stats.decodeTime_ns, 0u);
+
+	l.resetStats();
+	EXPECT_EQ(l.stats().messages, 0u);
+}
+#endif // STORED_HAVE_HEATSHRINK
+
 template <typename L>
 static int recvAll(L& l)
 {
@@ -1252,6 +1431,95 @@ TEST(FifoLoopback1, FifoLoopback1)
 	EXPECT_EQ(top.decoded().size(), 3);
 }
 
+TEST(FifoLoopback1, Reserve)
+{
+	LoggingLayer top;
+	stored::FifoLoopback1<16, 4> l;
+	l.wrap(top);
+
+	char* p = l.reserve(5);
+	ASSERT_NE(p, nullptr);
+	memcpy(p, "hello", 5);
+	l.commit(5);
+	EXPECT_EQ(l.available(), 1u);
+	EXPECT_EQ(l.recv(), 0);
+	EXPECT_EQ(top.decoded().size(), 1);
+	EXPECT_EQ(top.decoded().at(0), "hello");
+
+	p = l.reserve(8);
+	ASSERT_NE(p, nullptr);
+	l.abort();
+	EXPECT_TRUE(l.empty());
+
+	// Does not fit.
+	EXPECT_EQ(l.reserve(16), nullptr);
+	EXPECT_EQ(l.lastError(), ENOMEM);
+}
+
+#if defined(STORED_OS_POSIX) && !defined(STORED_COMPILER_MINGW)
+TEST(FifoLoopback1, Wait)
+{
+	LoggingLayer top;
+	stored::FifoLoopback1<16, 2> l;
+	l.wrap(top);
+	ASSERT_EQ(l.enableWait(), 0);
+	ASSERT_GE(l.fd(), 0);
+
+	EXPECT_EQ(l.recv(), EAGAIN);
+	EXPECT_EQ(l.recv(1000), EAGAIN);
+
+	// The overflow handler waits for the receiver to catch up.
+	l.setOverflowHandler([&]() { return l.waitSpace() == 0; });
+
+	std::thread t([&]() {
+		for(int i = 0; i < 100; i++)
+			l.encode("msg", 3);
+	});
+
+	for(int i = 0; i < 100; i++)
+		ASSERT_EQ(l.recv(-1), 0);
+
+	t.join();
+	EXPECT_EQ(top.decoded().size(), 100u);
+	EXPECT_EQ(l.recv(), EAGAIN);
+}
+
+TEST(FifoLoopback1, Poll)
+{
+	LoggingLayer top;
+	stored::FifoLoopback1<16, 2> l;
+	l.wrap(top);
+	ASSERT_EQ(l.enableWait(), 0);
+
+	stored::Poller poller;
+	stored::PollableFd p(l.fd(), stored::Pollable::PollIn);
+	ASSERT_EQ(poller.add(p), 0);
+
+	auto const* res = &poller.poll(0);
+	EXPECT_TRUE(res->empty());
+	EXPECT_EQ(errno, EAGAIN);
+
+	l.encode("Hello", 5);
+	res = &poller.poll(0);
+	ASSERT_EQ(res->size(), 1u);
+	l.recvAll();
+	EXPECT_EQ(top.decoded().size(), 1u);
+
+	// recvAll() rearmed the event.
+	res = &poller.poll(0);
+	EXPECT_TRUE(res->empty());
+
+	std::thread t([&]() { l.encode("World", 5); });
+	res = &poller.poll(-1);
+	EXPECT_EQ(res->size(), 1u);
+	t.join();
+
+	EXPECT_EQ(l.recv(), 0);
+	EXPECT_EQ(l.recv(), EAGAIN);
+	EXPECT_EQ(top.decoded().size(), 2u);
+}
+#endif // STORED_OS_POSIX
+
 TEST(FifoLoopback, FifoLoopback)
 {
 	LoggingLayer a;
@@ -1360,4 +1628,262 @@ TEST(TerminalLayer, Decode)
 	EXPECT_EQ(ll.decoded().at(0), "flowers");
 }
 
+#ifdef STORED_HAVE_ZMQ
+TEST(ZmqLayer, Parts)
+{
+	void* context = zmq_ctx_new();
+	ASSERT_NE(context, nullptr);
+
+	{
+		LoggingLayer top;
+		stored::SyncZmqLayer l(context, "inproc://zmqlayer-parts", true);
+		ASSERT_EQ(l.lastError(), 0);
+		l.wrap(top);
+
+		void* peer = zmq_socket(context, ZMQ_DEALER);
+		ASSERT_EQ(zmq_connect(peer, "inproc://zmqlayer-parts"), 0);
+
+		// Every part of an encoded message is sent as a separate frame.
+		l.encode("Hello ", 6, false);
+		l.encode("World", 5);
+
+		zmq_msg_t msg;
+		zmq_msg_init(&msg);
+		EXPECT_EQ(zmq_msg_recv(&msg, peer, 0), 6);
+		EXPECT_TRUE(zmq_msg_more(&msg));
+		EXPECT_EQ(std::string(static_cast<char*>(zmq_msg_data(&msg)), 6), "Hello ");
+		EXPECT_EQ(zmq_msg_recv(&msg, peer, 0), 5);
+		EXPECT_FALSE(zmq_msg_more(&msg));
+		EXPECT_EQ(std::string(static_cast<char*>(zmq_msg_data(&msg)), 5), "World");
+		EXPECT_EQ(l.stats().messages, 1);
+
+		// Large messages too.
+		std::string large(100000, 'x');
+		large.back() = 'y';
+		l.encode(large.data(), 50000, false);
+		l.encode(large.data() + 50000, 50000);
+		EXPECT_EQ(zmq_msg_recv(&msg, peer, 0), 50000);
+		EXPECT_TRUE(zmq_msg_more(&msg));
+		EXPECT_EQ(zmq_msg_recv(&msg, peer, 0), 50000);
+		EXPECT_FALSE(zmq_msg_more(&msg));
+		EXPECT_EQ(std::string(static_cast<char*>(zmq_msg_data(&msg)), 50000),
+			  large.substr(50000));
+		zmq_msg_close(&msg);
+
+		// Received parts are decoded at once.
+		EXPECT_EQ(zmq_send(peer, "", 0, ZMQ_SNDMORE), 0);
+		EXPECT_EQ(zmq_send(peer, "envelope", 8, 0), 8);
+		EXPECT_EQ(l.recv(-1), 0);
+		EXPECT_EQ(top.decoded().size(), 1);
+		EXPECT_EQ(top.decoded().at(0), "envelope");
+
+		EXPECT_EQ(zmq_send(peer, "Sing ", 5, ZMQ_SNDMORE), 5);
+		EXPECT_EQ(zmq_send(peer, "", 0, ZMQ_SNDMORE), 0);
+		EXPECT_EQ(zmq_send(peer, "a ", 2, ZMQ_SNDMORE), 2);
+		EXPECT_EQ(zmq_send(peer, "song", 4, 0), 4);
+		EXPECT_EQ(zmq_send(peer, "again", 5, 0), 5);
+		EXPECT_EQ(l.recv(-1), 0);
+		EXPECT_EQ(top.decoded().size(), 3);
+		EXPECT_EQ(top.decoded().at(1), "Sing a song");
+		EXPECT_EQ(top.decoded().at(2), "again");
+
+		zmq_close(peer);
+	}
+
+	zmq_ctx_term(context);
+}
+
+class EchoLayer : public stored::ProtocolLayer {
+	STORED_CLASS_NOCOPY(EchoLayer)
+public:
+	EchoLayer() = default;
+
+	virtual void decode(void* buffer, size_t len) override
+	{
+		decoded++;
+		encode(buffer, len);
+	}
+
+	size_t decoded = 0;
+};
+
+static std::string zmqRecv(void* socket)
+{
+	zmq_msg_t msg;
+	zmq_msg_init(&msg);
+	std::string s;
+	if(zmq_msg_recv(&msg, socket, 0) >= 0)
+		s.assign(static_cast<char*>(zmq_msg_data(&msg)), zmq_msg_size(&msg));
+	EXPECT_FALSE(zmq_msg_more(&msg));
+	zmq_msg_close(&msg);
+	return s;
+}
+
+TEST(ZmqLayer, Router)
+{
+	void* context = zmq_ctx_new();
+	ASSERT_NE(context, nullptr);
+
+	{
+		EchoLayer top;
+		stored::DebugZmqRouterLayer l(context, 19126);
+		ASSERT_EQ(l.lastError(), 0);
+		l.wrap(top);
+
+		// Nobody to respond to yet.
+		l.encode("?", 1);
+		EXPECT_EQ(l.lastError(), EHOSTUNREACH);
+
+		void* req1 = zmq_socket(context, ZMQ_REQ);
+		void* req2 = zmq_socket(context, ZMQ_REQ);
+		void* dealer = zmq_socket(context, ZMQ_DEALER);
+		ASSERT_EQ(zmq_connect(req1, "tcp://127.0.0.1:19126"), 0);
+		ASSERT_EQ(zmq_connect(req2, "tcp://127.0.0.1:19126"), 0);
+		ASSERT_EQ(zmq_connect(dealer, "tcp://127.0.0.1:19126"), 0);
+
+		// Requests of multiple clients are handled at once, and every
+		// response is routed back to the client that sent the request.
+		EXPECT_EQ(zmq_send(req1, "one", 3, 0), 3);
+		EXPECT_EQ(zmq_send(req2, "two", 3, 0), 3);
+		EXPECT_EQ(zmq_send(dealer, "three", 5, 0), 5);
+
+		while(top.decoded < 3)
+			ASSERT_EQ(l.recv(-1), 0);
+
+		EXPECT_EQ(zmqRecv(req1), "one");
+		EXPECT_EQ(zmqRecv(req2), "two");
+		EXPECT_EQ(zmqRecv(dealer), "three");
+
+		// Large responses are routed too.
+		std::string large(100000, 'x');
+		EXPECT_EQ(zmq_send(req2, large.data(), large.size(), 0), (int)large.size());
+		while(top.decoded < 4)
+			ASSERT_EQ(l.recv(-1), 0);
+		EXPECT_EQ(zmqRecv(req2), large);
+
+		zmq_close(req1);
+		zmq_close(req2);
+		zmq_close(dealer);
+	}
+
+	zmq_ctx_term(context);
+}
+
+TEST(ZmqLayer, Batch)
+{
+	void* context = zmq_ctx_new();
+	ASSERT_NE(context, nullptr);
+
+	{
+		LoggingLayer top1;
+		EchoLayer top2;
+		LoggingLayer log2;
+		stored::SyncZmqLayer l1(context, "inproc://zmqlayer-batch", true);
+		stored::SyncZmqLayer l2(context, "inproc://zmqlayer-batch", false);
+		ASSERT_EQ(l1.lastError(), 0);
+		ASSERT_EQ(l2.lastError(), 0);
+		l1.wrap(top1);
+		l2.wrap(log2);
+		log2.wrap(top2);
+		l1.setBatching(true);
+		l2.setBatching(true);
+
+		// Messages are held back until flushed.
+		std::string large(1000, 'x');
+		l1.encode("one", 3);
+		l1.encode(large.data(), 500, false);
+		l1.encode(large.data() + 500, 500);
+		l1.encode("three", 5);
+		EXPECT_EQ(l2.recv(), EAGAIN);
+		EXPECT_EQ(l1.stats().messages, 0);
+
+		EXPECT_TRUE(l1.flush());
+		EXPECT_EQ(l1.stats().messages, 3);
+		EXPECT_EQ(l1.stats().batches, 1);
+
+		// Every part is decoded separately, and the responses are sent
+		// as one batch after receiving.
+		EXPECT_EQ(l2.recv(-1), 0);
+		ASSERT_EQ(log2.decoded().size(), 3);
+		EXPECT_EQ(log2.decoded().at(0), "one");
+		EXPECT_EQ(log2.decoded().at(1), large);
+		EXPECT_EQ(log2.decoded().at(2), "three");
+		EXPECT_EQ(l2.stats().messages, 3);
+		EXPECT_EQ(l2.stats().batches, 1);
+
+		EXPECT_EQ(l1.recv(-1), 0);
+		ASSERT_EQ(top1.decoded().size(), 3);
+		EXPECT_EQ(top1.decoded().at(1), large);
+	}
+
+	zmq_ctx_term(context);
+}
+
+TEST(ZmqLayer, Backpressure)
+{
+	void* context = zmq_ctx_new();
+	ASSERT_NE(context, nullptr);
+
+	{
+		stored::SyncZmqLayer l(context, "inproc://zmqlayer-hwm", true);
+		ASSERT_EQ(l.lastError(), 0);
+
+		// Nobody to send to.
+		EXPECT_FALSE(l.writable());
+		EXPECT_EQ(l.stats().deferred, 0);
+
+		void* peer = zmq_socket(context, ZMQ_DEALER);
+		int hwm = 1;
+		ASSERT_EQ(zmq_setsockopt(peer, ZMQ_RCVHWM, &hwm, sizeof(hwm)), 0);
+		ASSERT_EQ(zmq_connect(peer, "inproc://zmqlayer-hwm"), 0);
+
+		// Fill the queue, until the high-water mark is reached.
+		size_t i = 0;
+		for(; i < 100000 && l.writable(); i++)
+			l.encode("x", 1);
+
+		EXPECT_GT(i, 0);
+		EXPECT_LT(i, 100000);
+		EXPECT_EQ(l.stats().messages, i);
+		EXPECT_EQ(l.stats().dropped, 0);
+		// Polling does not hold back messages.
+		EXPECT_EQ(l.stats().deferred, 0);
+
+		// A batch is held back while not writable, and every message
+		// of it is counted once.
+		l.setBatching(true);
+		l.encode("y", 1);
+		l.encode("z", 1);
+		EXPECT_FALSE(l.writable());
+		EXPECT_FALSE(l.flush());
+		EXPECT_EQ(l.stats().deferred, 2);
+		EXPECT_FALSE(l.flush());
+		EXPECT_EQ(l.stats().deferred, 2);
+
+		// Reading makes room again.
+		char buf[1];
+		for(size_t j = 0; j < i; j++)
+			EXPECT_EQ(zmq_recv(peer, buf, sizeof(buf), 0), 1);
+
+		EXPECT_TRUE(l.writable());
+		EXPECT_EQ(l.stats().messages, i);
+		EXPECT_TRUE(l.flush());
+		EXPECT_EQ(l.stats().messages, i + 2);
+		EXPECT_EQ(l.stats().batches, 1);
+		EXPECT_EQ(zmq_recv(peer, buf, sizeof(buf), 0), 1);
+		EXPECT_EQ(buf[0], 'y');
+		EXPECT_EQ(zmq_recv(peer, buf, sizeof(buf), 0), 1);
+		EXPECT_EQ(buf[0], 'z');
+
+		l.resetStats();
+		EXPECT_EQ(l.stats().messages, 0);
+		EXPECT_EQ(l.stats().deferred, 0);
+
+		zmq_close(peer);
+	}
+
+	zmq_ctx_term(context);
+}
+#endif // STORED_HAVE_ZMQ
+
 } // namespace
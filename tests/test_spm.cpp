@@ -5,6 +5,9 @@
 #include "libstored/spm.h"
 #include "gtest/gtest.h"
 
+#include <thread>
+#include <vector>
+
 namespace {
 
 TEST(ScrachPad, Alloc)
@@ -191,4 +194,187 @@ TEST(ScratchPad, Stress)
 	spmInfo(spm);
 }
 
+TEST(ScratchPad, Pool)
+{
+	stored::ScratchPadPool<> pool;
+	EXPECT_EQ(pool.arenas(), 0);
+
+	{
+		auto l1 = pool.acquire();
+		auto l2 = pool.acquire();
+		EXPECT_NE(&l1.spm(), &l2.spm());
+		EXPECT_EQ(pool.arenas(), 2);
+
+		int* i = l1->alloc<int>();
+		*i = 1;
+		EXPECT_EQ(l1->size(), sizeof(int));
+		EXPECT_TRUE(l2->empty());
+
+		auto l3 = std::move(l2);
+		EXPECT_FALSE(l2.valid());
+		EXPECT_TRUE(l3.valid());
+	}
+
+	{
+		// Released arenas are reused, and reset.
+		auto l = pool.acquire();
+		EXPECT_TRUE(l->empty());
+		EXPECT_EQ(pool.arenas(), 2);
+
+		// Exceed the first block of arenas.
+		std::vector<stored::ScratchPadPool<>::Lease> ls;
+		for(int i = 0; i < (int)stored::ScratchPadPool<>::BlockSize * 2; i++)
+			ls.push_back(pool.acquire());
+
+		EXPECT_EQ(pool.arenas(), (size_t)stored::ScratchPadPool<>::BlockSize * 2 + 1);
+	}
+}
+
+TEST(ScratchPad, Stats)
+{
+	stored::ScratchPad<> spm;
+
+	auto st = spm.stats();
+	EXPECT_EQ(st.chunks, 0);
+	EXPECT_EQ(st.spills, 0);
+	EXPECT_EQ(st.allocations, 0);
+	EXPECT_EQ(st.peak, 0);
+
+	char* a = spm.alloc<char>(10);
+	EXPECT_NE(a, nullptr);
+	st = spm.stats();
+	EXPECT_EQ(st.chunks, 1);
+	EXPECT_EQ(st.spills, 0);
+	EXPECT_EQ(st.allocations, 1);
+
+	// Does not fit in the first chunk.
+	char* b = spm.alloc<char>(1000);
+	EXPECT_NE(b, nullptr);
+	st = spm.stats();
+	EXPECT_EQ(st.chunks, 2);
+	EXPECT_EQ(st.spills, 1);
+	EXPECT_EQ(st.allocations, 2);
+	EXPECT_EQ(st.peak, 1010);
+
+	// Coalesce.
+	spm.reset();
+	st = spm.stats();
+	EXPECT_EQ(st.chunks, 1);
+	EXPECT_EQ(st.allocations, 2);
+	EXPECT_GE(st.capacity, 1010);
+
+	// Same usage fits now.
+	a = spm.alloc<char>(10);
+	b = spm.alloc<char>(1000);
+	EXPECT_NE(a, nullptr);
+	EXPECT_NE(b, nullptr);
+	st = spm.stats();
+	EXPECT_EQ(st.spills, 1);
+	EXPECT_EQ(st.allocations, 2);
+
+	spm.resetStats();
+	st = spm.stats();
+	EXPECT_EQ(st.spills, 0);
+	EXPECT_EQ(st.allocations, 0);
+	EXPECT_EQ(st.peak, 1010);
+}
+
+TEST(ScratchPad, AutoReserve)
+{
+	stored::ScratchPad<> spm;
+	spm.setAutoReserve();
+	EXPECT_TRUE(spm.autoReserve());
+
+	// Nothing is reserved before anything was used.
+	spm.reset();
+	EXPECT_EQ(spm.capacity(), 0);
+
+	// Slowly increase the peak usage. Without auto-reserve, every new peak
+	// would spill into another chunk.
+	for(size_t i = 1; i < 100; i++) {
+		char* p = spm.alloc<char>(i * 10);
+		EXPECT_NE(p, nullptr);
+		spm.reset();
+	}
+
+	auto st = spm.stats();
+	EXPECT_EQ(st.spills, 0);
+	EXPECT_LT(st.allocations, 30);
+	EXPECT_EQ(st.chunks, 1);
+	EXPECT_GT(st.capacity, st.peak);
+}
+
+TEST(ScratchPad, PoolAutoReserve)
+{
+	stored::ScratchPadPool<> pool;
+	pool.setAutoReserve();
+
+	{
+		auto l = pool.acquire();
+		char* p = l->alloc<char>(1000);
+		EXPECT_NE(p, nullptr);
+	}
+
+	EXPECT_EQ(pool.peak(), 1000);
+
+	{
+		auto l1 = pool.acquire();
+		auto l2 = pool.acquire();
+		EXPECT_EQ(pool.arenas(), 2);
+
+		// The new arena is already large enough.
+		EXPECT_GE(l2->capacity(), 1000);
+		char* p = l2->alloc<char>(1000);
+		EXPECT_NE(p, nullptr);
+		EXPECT_EQ(l2->stats().spills, 0);
+		EXPECT_EQ(l2->stats().allocations, 1);
+	}
+}
+
+#ifndef STORED_COMPILER_MINGW
+// MinGW does not implement std::thread.
+
+TEST(ScratchPad, PoolThreads)
+{
+	stored::ScratchPadPool<> pool;
+	std::vector<std::thread> threads;
+	int const n = 4;
+	bool ok[n] = {};
+
+	for(int t = 0; t < n; t++)
+		threads.emplace_back([&pool, &ok, t]() {
+			bool res = true;
+
+			for(int j = 0; j < 1000; j++) {
+				auto l = pool.acquire();
+				int* a = l->alloc<int>();
+				*a = t;
+
+				{
+					auto s = l->snapshot();
+					int* b = l->alloc<int>((size_t)(j % 17 + 1));
+					for(int k = 0; k < j % 17 + 1; k++)
+						b[k] = t;
+					std::this_thread::yield();
+					for(int k = 0; k < j % 17 + 1; k++)
+						res = res && b[k] == t;
+				}
+
+				res = res && *a == t && l->size() == sizeof(int);
+			}
+
+			ok[t] = res;
+		});
+
+	for(auto& t : threads)
+		t.join();
+
+	for(int t = 0; t < n; t++)
+		EXPECT_TRUE(ok[t]);
+
+	EXPECT_GE(pool.arenas(), 1);
+	EXPECT_LE(pool.arenas(), (size_t)n);
+}
+#endif // !STORED_COMPILER_MINGW
+
 } // namespace
@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+
+# SPDX-FileCopyrightText: 2020-2023 Jochem Rutgers
+#
+# SPDX-License-Identifier: MPL-2.0
+
+import libstored.trace_codec
+import logging
+import unittest
+
+class TraceDecoderTest(unittest.TestCase):
+    # Equivalent to the Debugger.TraceCodec test: an echo, an int16, an echo,
+    # a float, and an echo that is escaped to raw.
+    layout = '_i_fi'
+    samples = [
+        (b'K\x01\x40\x00\x01;', [None, b'0', None, b'00000000', b';']),
+        (b'D\x07\x17\x7f\x00\x01;', [None, b'3', None, b'3f800000', b';']),
+        (b'D\x01\x40\x00\x01;', [None, b'6', None, b'3f800000', b';']),
+    ]
+
+    def test_decode(self):
+        decoder = libstored.trace_codec.TraceDecoder(self.layout)
+        for data, fields in self.samples:
+            self.assertEqual(decoder.decode(data), [fields])
+
+    def test_partial(self):
+        decoder = libstored.trace_codec.TraceDecoder(self.layout)
+        data = b''.join(x[0] for x in self.samples)
+        res = []
+        for i in range(0, len(data)):
+            res += decoder.decode(data[i:i + 1])
+        self.assertEqual(res, [x[1] for x in self.samples])
+
+    def test_sync(self):
+        decoder = libstored.trace_codec.TraceDecoder(self.layout)
+        # Delta samples are dropped until a key sample arrives.
+        self.assertEqual(decoder.decode(self.samples[1][0]), [])
+        self.assertFalse(decoder.synced)
+        self.assertEqual(decoder.decode(b'K\x0d\x17\x7f\x00\x01;'), [[None, b'6', None, b'3f800000', b';']])
+        self.assertTrue(decoder.synced)
+
+        # Garbage loses synchronization.
+        self.assertEqual(decoder.decode(b'x'), [])
+        self.assertFalse(decoder.synced)
+
+    def test_wrap(self):
+        # Counting down from 0 wraps around; zigzag -1 is 1, plus 1 is 2.
+        decoder = libstored.trace_codec.TraceDecoder('i')
+        self.assertEqual(decoder.decode(b'K\x02D\x01'), [[b'ffffffffffffffff'], [b'fffffffffffffffe']])
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.INFO)
+    suite = unittest.TestLoader().loadTestsFromTestCase(TraceDecoderTest)
+    unittest.TextTestRunner(verbosity=2).run(suite)